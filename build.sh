@@ -1,5 +1,5 @@
 #!/bin/bash
-# Unified build: frontend + SPIFFS image + firmware
+# Unified build: frontend + web asset bundle + firmware
 # Usage: ./build.sh [flash] [port]
 #   ./build.sh            # Build only
 #   ./build.sh flash      # Build and flash
@@ -35,18 +35,12 @@ if [ ! -d frontend/node_modules ]; then
 fi
 (cd frontend && npm run build)
 
-# Pre-compress assets with gzip for faster serving
-echo "Compressing assets with gzip..."
-for f in build/www/assets/*.js build/www/assets/*.css; do
-    [ -f "$f" ] && gzip -9 -k -f "$f"
-done
-gzip -9 -k -f build/www/index.html
-
 echo -e "${GREEN}Frontend built -> build/www/${NC}"
-ls -lh build/www/index.html* build/www/assets/* 2>/dev/null
+ls -lh build/www/index.html build/www/assets/* 2>/dev/null
 
-# Step 2: Build firmware (includes SPIFFS image generation via CMake)
-echo -e "\n${GREEN}[2/3] Building firmware + SPIFFS image...${NC}"
+# Step 2: Build firmware (packs build/www into build/www.bin via CMake;
+# gzip, ETags and the path index are done by scripts/pack_www.py)
+echo -e "\n${GREEN}[2/3] Building firmware + web asset bundle...${NC}"
 idf.py build
 
 # Step 3: Flash if requested
@@ -64,14 +64,23 @@ export function ledsAllOff() {
   return request('POST', '/api/leds/all-off');
 }
 
-export function ledsTest() {
-  return request('POST', '/api/leds/test');
+// Queue an LED animation: 'test' (sweep), 'chase', 'flash', 'pulse' or 'stop'
+export function ledsTest(anim = 'test') {
+  return request('POST', `/api/leds/test?anim=${anim}`);
 }
 
 export function sendCat(cmd) {
   return request('POST', '/api/cat/send', { cmd });
 }
 
+export function getLatency() {
+  return request('GET', '/api/latency');
+}
+
+export function resetLatency() {
+  return request('POST', '/api/latency/reset');
+}
+
 export async function uploadMappings(jsonText) {
   const res = await fetch('/api/mappings/upload', {
     method: 'POST',
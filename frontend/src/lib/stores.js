@@ -23,17 +23,61 @@ export const catTicker = writable([]);
 // LED states: Map of note -> "on"|"off"|"blink"
 export const ledStates = writable({});
 
+// LED states the console confirmed (WS "leds"), same shape as ledStates
+export const ledHardware = writable({});
+
+// Latency histograms (from GET /api/latency and WS "latency" messages)
+export const latency = writable(null);
+
 const MAX_LOG = 100;
 const MAX_TICKER = 20;
 
-function pushTicker(entry) {
-  catTicker.update(log => {
-    const next = [entry, ...log];
-    return next.length > MAX_TICKER ? next.slice(0, MAX_TICKER) : next;
+// Prepend entries (newest first) to a ring-buffer store in one update
+function pushLog(store, entries, max) {
+  if (entries.length === 0) return;
+  store.update(log => {
+    const next = [...entries, ...log];
+    return next.length > max ? next.slice(0, max) : next;
   });
 }
 
+function pushTicker(entry) {
+  pushLog(catTicker, [entry], MAX_TICKER);
+}
+
+// Control/CAT events arrive as a JSON array per server tick (oldest first).
+// Collect them so each store updates once per batch, not once per event.
+function handleBatch(batch) {
+  const ts = Date.now();
+  const controls = [];
+  const cats = [];
+  const ticker = [];
+  for (const msg of batch) {
+    switch (msg.type) {
+      case 'control':
+        controls.unshift({ ...msg, ts });
+        break;
+      case 'cat':
+        cats.unshift({ ...msg, ts });
+        ticker.unshift({ dir: 'TX', cat: msg.cat, ts });
+        break;
+      case 'cat_rx':
+        ticker.unshift({ dir: 'RX', cat: `${msg.cmd}${msg.value}`, ts });
+        break;
+      default:
+        handleWsMessage(msg);
+    }
+  }
+  pushLog(controlLog, controls, MAX_LOG);
+  pushLog(catLog, cats, MAX_LOG);
+  pushLog(catTicker, ticker, MAX_TICKER);
+}
+
 function handleWsMessage(msg) {
+  if (Array.isArray(msg)) {
+    handleBatch(msg);
+    return;
+  }
   switch (msg.type) {
     case 'ws':
       wsConnected.set(msg.connected);
@@ -42,18 +86,10 @@ function handleWsMessage(msg) {
       status.update(s => ({ ...s, ...msg }));
       break;
     case 'control':
-      controlLog.update(log => {
-        const entry = { ...msg, ts: Date.now() };
-        const next = [entry, ...log];
-        return next.length > MAX_LOG ? next.slice(0, MAX_LOG) : next;
-      });
+      pushLog(controlLog, [{ ...msg, ts: Date.now() }], MAX_LOG);
       break;
     case 'cat':
-      catLog.update(log => {
-        const entry = { ...msg, ts: Date.now() };
-        const next = [entry, ...log];
-        return next.length > MAX_LOG ? next.slice(0, MAX_LOG) : next;
-      });
+      pushLog(catLog, [{ ...msg, ts: Date.now() }], MAX_LOG);
       // Also push to ticker as TX
       pushTicker({ dir: 'TX', cat: msg.cat, ts: Date.now() });
       break;
@@ -67,6 +103,24 @@ function handleWsMessage(msg) {
     case 'led_all_off':
       ledStates.set({});
       break;
+    case 'leds': {
+      const leds = {};
+      for (const note of msg.on) leds[note] = 'on';
+      for (const note of msg.blink) leds[note] = 'blink';
+      ledHardware.set(leds);
+      break;
+    }
+    case 'resync': {
+      // Sent after the device dropped telemetry for this (slow) client
+      status.update(s => ({ ...s, ...msg.status }));
+      const leds = {};
+      for (const [note, st] of msg.leds) leds[note] = st === 2 ? 'blink' : 'on';
+      ledStates.set(leds);
+      break;
+    }
+    case 'latency':
+      latency.set(msg);
+      break;
   }
 }
 
@@ -1,23 +1,121 @@
 let socket = null;
 let listeners = [];
 let reconnectTimer = null;
+let registrations = new Map();   // id -> { topics, opts } from subscribeTopics()
+let nextRegistration = 1;
+let subscribeQueued = false;
+
+// Live telemetry uses the binary encoding (main/ws_proto.h); open the page
+// with ?json, or set localStorage.wsJson = '1', to get readable JSON frames.
+const useBinary = !new URLSearchParams(location.search).has('json') &&
+  localStorage.getItem('wsJson') !== '1';
 
 function getWsUrl() {
   const proto = location.protocol === 'https:' ? 'wss:' : 'ws:';
-  return `${proto}//${location.host}/ws`;
+  return `${proto}//${location.host}/ws${useBinary ? '?bin=1' : ''}`;
+}
+
+// ----- Binary decoder (records as in main/ws_proto.h) -----
+
+const REC_HELLO = 0x00, REC_CONTROL = 0x01, REC_CAT_TX = 0x02, REC_CAT_RX = 0x03,
+      REC_RAW = 0x04, REC_CAT_TX_STR = 0x05, REC_CAT_RX_STR = 0x06, REC_DEF = 0x10;
+const EXEC_NAMES = ['BTN', 'TOG', 'SET', 'FRQ', 'WHL', 'FLW'];
+const textDecoder = new TextDecoder();
+let strings = [];   // Interned strings; ids 0..58 are the control names
+
+function str(id) { return strings[id] ?? '?'; }
+
+// One binary frame -> array of messages shaped like the JSON ones
+function decodeBinary(buf) {
+  const b = new Uint8Array(buf);
+  const dv = new DataView(buf);
+  const out = [];
+  let p = 0;
+  while (p < b.length) {
+    switch (b[p]) {
+      case REC_HELLO:
+        p += 2;
+        break;
+      case REC_DEF:
+        strings[b[p + 1]] = textDecoder.decode(b.subarray(p + 3, p + 3 + b[p + 2]));
+        p += 3 + b[p + 2];
+        break;
+      case REC_CONTROL: {
+        const msg = { type: 'control', name: str(b[p + 1]), id: b[p + 1], ctrl: b[p + 2],
+                      old: b[p + 3], new: b[p + 4], t: dv.getUint32(p + 6, true) };
+        if (b[p + 5] > 1) msg.n = b[p + 5];
+        out.push(msg);
+        p += 10;
+        break;
+      }
+      case REC_CAT_TX: {
+        const len = b[p + 9];
+        const value = textDecoder.decode(b.subarray(p + 10, p + 10 + len));
+        out.push({ type: 'cat', control: str(b[p + 1]), cmd: str(b[p + 3]),
+                   exec: EXEC_NAMES[b[p + 2]] ?? '?', cat: `${str(b[p + 4])}${value};`,
+                   t: dv.getUint32(p + 5, true) });
+        p += 10 + len;
+        break;
+      }
+      case REC_CAT_RX: {
+        const len = b[p + 6];
+        out.push({ type: 'cat_rx', cmd: str(b[p + 1]),
+                   value: textDecoder.decode(b.subarray(p + 7, p + 7 + len)),
+                   t: dv.getUint32(p + 2, true) });
+        p += 7 + len;
+        break;
+      }
+      case REC_CAT_TX_STR: {   // String table full: names inline
+        const nlen = b[p + 7], len = b[p + 8 + nlen];
+        out.push({ type: 'cat', control: str(b[p + 1]),
+                   cmd: textDecoder.decode(b.subarray(p + 8, p + 8 + nlen)),
+                   exec: EXEC_NAMES[b[p + 2]] ?? '?',
+                   cat: `${textDecoder.decode(b.subarray(p + 9 + nlen, p + 9 + nlen + len))};`,
+                   t: dv.getUint32(p + 3, true) });
+        p += 9 + nlen + len;
+        break;
+      }
+      case REC_CAT_RX_STR: {
+        const plen = b[p + 5], len = b[p + 6 + plen];
+        out.push({ type: 'cat_rx', cmd: textDecoder.decode(b.subarray(p + 6, p + 6 + plen)),
+                   value: textDecoder.decode(b.subarray(p + 7 + plen, p + 7 + plen + len)),
+                   t: dv.getUint32(p + 1, true) });
+        p += 7 + plen + len;
+        break;
+      }
+      case REC_RAW: {
+        const len = b[p + 5];
+        const hex = Array.from(b.subarray(p + 6, p + 6 + len), x => x.toString(16).padStart(2, '0'));
+        out.push({ type: 'raw', t: dv.getUint32(p + 1, true), hex: hex.join('') });
+        p += 6 + len;
+        break;
+      }
+      default:
+        return out;   // Unknown record: the rest of the frame can't be parsed
+    }
+  }
+  return out;
 }
 
 export function connect() {
   if (socket && socket.readyState <= 1) return;
 
   socket = new WebSocket(getWsUrl());
+  socket.binaryType = 'arraybuffer';
+  strings = [];
 
   socket.onopen = () => {
     if (reconnectTimer) { clearTimeout(reconnectTimer); reconnectTimer = null; }
+    sendSubscription();
     notify({ type: 'ws', connected: true });
   };
 
   socket.onmessage = (ev) => {
+    if (ev.data instanceof ArrayBuffer) {
+      const batch = decodeBinary(ev.data);
+      if (batch.length) notify(batch);
+      return;
+    }
     try {
       const msg = JSON.parse(ev.data);
       notify(msg);
@@ -49,6 +147,66 @@ export function subscribe(fn) {
   return () => { listeners = listeners.filter(l => l !== fn); };
 }
 
+// ----- Topic subscriptions -----
+//
+// Components register the topics they render; the device is sent the union
+// so it skips formatting what nobody shows. cat_rx prefix filters and rate
+// caps only narrow the union when every registration asks for them.
+
+function subscriptionMessage() {
+  const topics = new Set();
+  const wanting = {};   // topic -> registrations that want it
+  for (const reg of registrations.values()) {
+    for (const t of reg.topics) {
+      topics.add(t);
+      (wanting[t] ??= []).push(reg.opts);
+    }
+  }
+  const msg = { type: 'subscribe', topics: [...topics] };
+
+  const rx = wanting.cat_rx ?? [];
+  if (rx.length && rx.every(o => o.catRxPrefixes?.length)) {
+    msg.cat_rx_prefixes = [...new Set(rx.flatMap(o => o.catRxPrefixes))];
+  }
+  if (rx.length) {
+    const excl = rx.map(o => o.catRxExclude ?? []);
+    const common = excl[0].filter(p => excl.every(e => e.includes(p)));
+    if (common.length) msg.cat_rx_exclude = common;
+  }
+
+  const rates = {};
+  for (const [t, opts] of Object.entries(wanting)) {
+    if (opts.every(o => o.rates?.[t])) rates[t] = Math.max(...opts.map(o => o.rates[t]));
+  }
+  if (Object.keys(rates).length) msg.rates = rates;
+  return msg;
+}
+
+// Coalesce the registration changes of one page switch into one message
+function sendSubscription() {
+  if (subscribeQueued) return;
+  subscribeQueued = true;
+  queueMicrotask(() => {
+    subscribeQueued = false;
+    send(subscriptionMessage());
+  });
+}
+
+/**
+ * Ask for live topics ('control', 'cat_tx', 'cat_rx', 'status', 'led', 'raw').
+ * opts: { catRxPrefixes: ['ZZFA'], catRxExclude: ['ZZSM'], rates: { cat_rx: 5 } }
+ * (rates in events per second). Returns a function that drops the request.
+ */
+export function subscribeTopics(topics, opts = {}) {
+  const id = nextRegistration++;
+  registrations.set(id, { topics, opts });
+  sendSubscription();
+  return () => {
+    registrations.delete(id);
+    sendSubscription();
+  };
+}
+
 export function send(obj) {
   if (socket && socket.readyState === WebSocket.OPEN) {
     socket.send(JSON.stringify(obj));
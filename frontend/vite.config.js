@@ -6,7 +6,7 @@ export default defineConfig({
   build: {
     outDir: '../build/www',
     emptyOutDir: true,
-    // Keep bundle small for ESP32 SPIFFS (1MB partition)
+    // Keep bundle small for the ESP32 www partition (1MB, see scripts/pack_www.py)
     minify: 'esbuild',
     rollupOptions: {
       output: {
@@ -0,0 +1,93 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "host_clock.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// ---------------------------------------------------------------------------
+// esp_timer
+// ---------------------------------------------------------------------------
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t s_boot_us = 0;
+static bool    s_manual = false;
+static int64_t s_manual_us = 0;
+
+void host_clock_set_manual(bool manual)
+{
+    s_manual = manual;
+}
+
+void host_clock_set_us(int64_t now_us)
+{
+    s_manual_us = now_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    if (s_manual) return s_manual_us;
+    // Start counting at first use, like the device clock starts at boot
+    if (s_boot_us == 0) s_boot_us = monotonic_us();
+    return monotonic_us() - s_boot_us;
+}
+
+// ---------------------------------------------------------------------------
+// esp_err
+// ---------------------------------------------------------------------------
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                        return "ESP_OK";
+    case ESP_FAIL:                      return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_VERSION:       return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_TYPE_MISMATCH:     return "ESP_ERR_NVS_TYPE_MISMATCH";
+    case ESP_ERR_NVS_READ_ONLY:         return "ESP_ERR_NVS_READ_ONLY";
+    case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+    default:                            return "UNKNOWN ERROR";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// esp_log
+// ---------------------------------------------------------------------------
+
+esp_log_level_t host_log_level = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (tag && strcmp(tag, "*") == 0) {
+        host_log_level = level;
+    }
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    fprintf(stderr, "%c (%lld) %s: %s\n", letters[level],
+            (long long)(esp_timer_get_time() / 1000), tag, line);
+}
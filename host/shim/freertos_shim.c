@@ -0,0 +1,292 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ---------------------------------------------------------------------------
+// Semaphores (counting semaphore on a pthread mutex + condvar)
+// ---------------------------------------------------------------------------
+
+struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    UBaseType_t     count;
+    UBaseType_t     max;
+};
+
+static void deadline_after(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    uint64_t ns = (uint64_t)ts->tv_nsec + (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ULL;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct host_sem *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->count = initial_count;
+    s->max = max_count;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    if (ticks_to_wait != portMAX_DELAY) deadline_after(&deadline, ticks_to_wait);
+
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0) {
+        if (ticks_to_wait == 0) break;
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&sem->cond, &sem->lock);
+        } else if (pthread_cond_timedwait(&sem->cond, &sem->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    BaseType_t ok = pdFALSE;
+    if (sem->count > 0) {
+        sem->count--;
+        ok = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    BaseType_t ok = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max) {
+        sem->count++;
+        ok = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    if (!sem) return;
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+}
+
+// ---------------------------------------------------------------------------
+// Queues (ring of fixed-size items on a pthread mutex + condvar)
+// ---------------------------------------------------------------------------
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;   // Broadcast on every send/receive
+    UBaseType_t     length;
+    UBaseType_t     item_size;
+    UBaseType_t     head;
+    UBaseType_t     count;
+    uint8_t        *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->items = calloc(length, item_size);
+    if (!q->items) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    free(q);
+}
+
+// Wait (lock held) until ready(q) or timeout; returns false on timeout
+static bool queue_wait(QueueHandle_t q, bool (*ready)(QueueHandle_t), TickType_t ticks)
+{
+    struct timespec deadline;
+    if (ticks != portMAX_DELAY) deadline_after(&deadline, ticks);
+    while (!ready(q)) {
+        if (ticks == 0) return false;
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&q->changed, &q->lock);
+        } else if (pthread_cond_timedwait(&q->changed, &q->lock, &deadline) == ETIMEDOUT) {
+            return ready(q);
+        }
+    }
+    return true;
+}
+
+static bool queue_has_room(QueueHandle_t q) { return q->count < q->length; }
+static bool queue_has_item(QueueHandle_t q) { return q->count > 0; }
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = queue_wait(q, queue_has_room, ticks_to_wait);
+    if (ok) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->items + (size_t)tail * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = queue_wait(q, queue_has_item, ticks_to_wait);
+    if (ok) {
+        memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->head = 0;
+    q->count = 0;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+// ---------------------------------------------------------------------------
+// Tasks (detached pthreads; priority and core affinity are ignored)
+// ---------------------------------------------------------------------------
+
+struct host_task {
+    pthread_t         thread;
+    TaskFunction_t    fn;
+    void             *arg;
+    SemaphoreHandle_t notify;
+};
+
+static __thread struct host_task *s_self = NULL;
+
+static void *task_trampoline(void *p)
+{
+    struct host_task *t = p;
+    s_self = t;
+    t->fn(t->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *out_handle,
+                                   BaseType_t core_id)
+{
+    (void)name; (void)stack_depth; (void)priority; (void)core_id;
+
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (!t) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    t->notify = xSemaphoreCreateCounting(0xffffffffU, 0);
+
+    if (out_handle) *out_handle = t;
+    if (pthread_create(&t->thread, NULL, task_trampoline, t) != 0) {
+        if (out_handle) *out_handle = NULL;
+        vSemaphoreDelete(t->notify);
+        free(t);
+        return pdFAIL;
+    }
+    pthread_detach(t->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == s_self) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = (ticks * portTICK_PERIOD_MS) / 1000,
+        .tv_nsec = ((ticks * portTICK_PERIOD_MS) % 1000) * 1000000L,
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t increment)
+{
+    // Like FreeRTOS: a wake time already in the past returns at once
+    TickType_t next = *prev_wake + increment;
+    TickType_t left = next - xTaskGetTickCount();
+    if (left != 0 && left <= increment) vTaskDelay(left);
+    *prev_wake = next;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) / portTICK_PERIOD_MS);
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    if (task) xSemaphoreGive(task->notify);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    if (!s_self) return 0;
+    uint32_t taken = 0;
+    if (xSemaphoreTake(s_self->notify, ticks_to_wait) == pdTRUE) {
+        taken = 1;
+        if (clear_on_exit) {
+            while (xSemaphoreTake(s_self->notify, 0) == pdTRUE) taken++;
+        }
+    }
+    return taken;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Host shim for ESP-IDF esp_timer.h.
+
+#include <stdint.h>
+
+/** Microseconds since the shim was first used (CLOCK_MONOTONIC). */
+int64_t esp_timer_get_time(void);
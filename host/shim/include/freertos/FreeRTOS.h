@@ -0,0 +1,25 @@
+#pragma once
+
+// Host shim for FreeRTOS.h — tasks map to pthreads, 1 tick = 1 ms
+// (matches CONFIG_FREERTOS_HZ=1000 in sdkconfig.defaults).
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef int          BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t     TickType_t;
+
+#define pdFALSE             ((BaseType_t)0)
+#define pdTRUE              ((BaseType_t)1)
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+// Threads are not pinned on the host: everything runs on "core 0"
+#define portNUM_PROCESSORS  2
+static inline BaseType_t xPortGetCoreID(void) { return 0; }
@@ -0,0 +1,14 @@
+#pragma once
+
+// Host-only: virtual clock for deterministic replays.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * When manual, esp_timer_get_time() returns the value last passed to
+ * host_clock_set_us() instead of the monotonic clock. FreeRTOS ticks and
+ * delays are not affected.
+ */
+void host_clock_set_manual(bool manual);
+void host_clock_set_us(int64_t now_us);
@@ -0,0 +1,20 @@
+#pragma once
+
+// Host-only hooks for the usb_dj_host stub (not part of the firmware API).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Feed one bulk IN packet as if it arrived from the console: calls the raw
+ * callback, then runs it through dj_state_process(). Marks the stub
+ * "connected" on first use.
+ */
+void host_usb_feed(const uint8_t *packet, int length);
+
+/** Simulate connect/disconnect (resets decoder state on connect). */
+void host_usb_set_connected(bool connected);
+
+/** Number of bulk OUT transfers issued for LED messages (packed or single). */
+uint32_t host_usb_out_count(void);
@@ -0,0 +1,184 @@
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// In-memory NVS: a flat list of (namespace, key, type, bytes). Handles are
+// indices into the namespace table. Commit is a no-op.
+
+typedef enum { ENTRY_U8, ENTRY_U16, ENTRY_STR, ENTRY_BLOB } entry_type_t;
+
+typedef struct nvs_entry {
+    struct nvs_entry *next;
+    char              ns[16];
+    char              key[16];
+    entry_type_t      type;
+    size_t            len;
+    uint8_t          *data;
+} nvs_entry_t;
+
+#define MAX_NAMESPACES 8
+
+static char            s_namespaces[MAX_NAMESPACES][16];
+static int             s_namespace_count = 0;
+static nvs_entry_t    *s_entries = NULL;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static nvs_entry_t *find_entry(nvs_handle_t handle, const char *key)
+{
+    for (nvs_entry_t *e = s_entries; e; e = e->next) {
+        if (strcmp(e->ns, s_namespaces[handle]) == 0 && strcmp(e->key, key) == 0) return e;
+    }
+    return NULL;
+}
+
+static esp_err_t set_entry(nvs_handle_t handle, const char *key, entry_type_t type,
+                           const void *data, size_t len)
+{
+    if (handle >= (nvs_handle_t)s_namespace_count) return ESP_ERR_INVALID_ARG;
+    if (strlen(key) >= sizeof(s_entries->key)) return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&s_lock);
+    nvs_entry_t *e = find_entry(handle, key);
+    if (!e) {
+        e = calloc(1, sizeof(*e));
+        if (!e) {
+            pthread_mutex_unlock(&s_lock);
+            return ESP_ERR_NO_MEM;
+        }
+        strcpy(e->ns, s_namespaces[handle]);
+        strcpy(e->key, key);
+        e->next = s_entries;
+        s_entries = e;
+    }
+    uint8_t *copy = malloc(len ? len : 1);
+    if (!copy) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, data, len);
+    free(e->data);
+    e->data = copy;
+    e->len = len;
+    e->type = type;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+static esp_err_t get_entry(nvs_handle_t handle, const char *key, entry_type_t type,
+                           void *out, size_t *len)
+{
+    if (handle >= (nvs_handle_t)s_namespace_count) return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = ESP_OK;
+    nvs_entry_t *e = find_entry(handle, key);
+    if (!e) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (e->type != type) {
+        err = ESP_ERR_NVS_TYPE_MISMATCH;
+    } else if (out == NULL) {
+        *len = e->len;  // size query
+    } else if (*len < e->len) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out, e->data, e->len);
+        *len = e->len;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_lock);
+    while (s_entries) {
+        nvs_entry_t *next = s_entries->next;
+        free(s_entries->data);
+        free(s_entries);
+        s_entries = next;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)open_mode;
+    if (strlen(namespace_name) >= sizeof(s_namespaces[0])) return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&s_lock);
+    int idx = -1;
+    for (int i = 0; i < s_namespace_count; i++) {
+        if (strcmp(s_namespaces[i], namespace_name) == 0) idx = i;
+    }
+    if (idx < 0 && s_namespace_count < MAX_NAMESPACES) {
+        idx = s_namespace_count++;
+        strcpy(s_namespaces[idx], namespace_name);
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    if (idx < 0) return ESP_ERR_NO_MEM;
+    *out_handle = (nvs_handle_t)idx;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return get_entry(handle, key, ENTRY_STR, out_value, length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return set_entry(handle, key, ENTRY_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return get_entry(handle, key, ENTRY_BLOB, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return set_entry(handle, key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    size_t len = sizeof(*out_value);
+    return get_entry(handle, key, ENTRY_U8, out_value, &len);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return set_entry(handle, key, ENTRY_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value)
+{
+    size_t len = sizeof(*out_value);
+    return get_entry(handle, key, ENTRY_U16, out_value, &len);
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value)
+{
+    return set_entry(handle, key, ENTRY_U16, &value, sizeof(value));
+}
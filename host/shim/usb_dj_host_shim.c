@@ -0,0 +1,84 @@
+#include "usb_dj_host.h"
+#include "host_usb.h"
+#include "latency.h"
+#include "metrics.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// Host stand-in for the USB host driver: no device, packets are injected
+// with host_usb_feed() and bulk OUT transfers are only counted.
+
+static const char *TAG = "usb_dj_host";
+
+static bool                    s_device_connected = false;
+static dj_raw_state_callback_t s_raw_callback = NULL;
+static uint32_t                s_out_count = 0;
+
+esp_err_t usb_dj_host_init(dj_control_callback_t callback)
+{
+    dj_state_set_callback(callback);
+    ESP_LOGI(TAG, "Host USB stub ready (%d controls)", dj_state_control_count());
+    return ESP_OK;
+}
+
+bool usb_dj_host_is_connected(void)
+{
+    return s_device_connected;
+}
+
+const uint8_t *usb_dj_host_get_state(void)
+{
+    return s_device_connected ? dj_state_get() : NULL;
+}
+
+void usb_dj_host_set_raw_callback(dj_raw_state_callback_t cb)
+{
+    s_raw_callback = cb;
+}
+
+esp_err_t usb_dj_host_send(const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    if (!s_device_connected) return ESP_ERR_INVALID_STATE;
+    s_out_count++;
+    metrics_inc(METRIC_LED_OUT_TRANSFERS);
+    return ESP_OK;
+}
+
+esp_err_t usb_dj_host_send_msgs(const uint8_t *msgs, size_t count)
+{
+    // Packed like the firmware with a 64-byte OUT endpoint that accepts it
+    const size_t per = 64 / 3;
+    for (size_t i = 0; i < count; i += per) {
+        size_t n = count - i < per ? count - i : per;
+        esp_err_t err = usb_dj_host_send(msgs + 3 * i, 3 * n);
+        if (err != ESP_OK) return err;
+    }
+    return ESP_OK;
+}
+
+void host_usb_set_connected(bool connected)
+{
+    if (connected && !s_device_connected) dj_state_reset();
+    s_device_connected = connected;
+}
+
+void host_usb_feed(const uint8_t *packet, int length)
+{
+    if (!s_device_connected) host_usb_set_connected(true);
+    if (length < DJ_STATE_SIZE) {
+        metrics_inc(METRIC_USB_SHORT_TRANSFERS);
+        return;
+    }
+    metrics_inc(METRIC_USB_PACKETS);
+    if (s_raw_callback) s_raw_callback(packet, length);
+    latency_mark_usb_rx(esp_timer_get_time());
+    dj_state_process(packet);
+}
+
+uint32_t host_usb_out_count(void)
+{
+    return s_out_count;
+}
@@ -0,0 +1,116 @@
+// Host benchmark: sparse XOR decoder (dj_state_process) vs. the full table
+// scan (dj_state_process_full) on synthetic packet streams. Also checks
+// that both produce the same control events in the same order.
+//
+//   decoder_bench [--packets N]
+
+#include "dj_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+
+typedef enum { LOAD_IDLE, LOAD_JOG, LOAD_MIXED, LOAD_RANDOM, LOAD_COUNT } load_t;
+
+static const char *s_load_names[LOAD_COUNT] = {
+    "idle (identical)", "jog only", "jog+dial+button", "random (all bytes)",
+};
+
+static uint64_t s_hash;
+static uint32_t s_events;
+
+static void hash_cb(uint8_t control_id, dj_control_type_t control_type,
+                    uint8_t old_value, uint8_t new_value)
+{
+    // FNV-1a over (id, old, new) keeps event order significant
+    uint8_t ev[3] = { control_id, old_value, new_value };
+    for (int i = 0; i < 3; i++) {
+        s_hash ^= ev[i];
+        s_hash *= 0x100000001b3ULL;
+    }
+    s_events++;
+}
+
+static uint8_t *make_stream(load_t load, int packets)
+{
+    uint8_t *buf = calloc(packets, DJ_STATE_SIZE);
+    uint8_t pkt[DJ_STATE_SIZE] = {0};
+    srand(1234);
+
+    for (int i = 0; i < packets; i++) {
+        switch (load) {
+        case LOAD_IDLE:
+            break;
+        case LOAD_JOG:
+            pkt[15]++;                          // Jog_A
+            break;
+        case LOAD_MIXED:
+            pkt[15]++;                          // Jog_A every packet
+            if (i % 4 == 0) pkt[6] += 3;        // Vol_A
+            if (i % 16 == 0) pkt[1] ^= 0x04;    // Play_A
+            break;
+        case LOAD_RANDOM:
+            for (int b = 0; b < DJ_STATE_SIZE; b++) pkt[b] = (uint8_t)rand();
+            break;
+        default:
+            break;
+        }
+        memcpy(buf + (size_t)i * DJ_STATE_SIZE, pkt, DJ_STATE_SIZE);
+    }
+    return buf;
+}
+
+static double run(void (*process)(const uint8_t *), const uint8_t *stream, int packets)
+{
+    dj_state_reset();
+    s_hash = 0xcbf29ce484222325ULL;
+    s_events = 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < packets; i++) {
+        process(stream + (size_t)i * DJ_STATE_SIZE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    return ns / packets;
+}
+
+int main(int argc, char **argv)
+{
+    int packets = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--packets") == 0 && i + 1 < argc) {
+            packets = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--packets N]\n", argv[0]);
+            return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+    dj_state_set_callback(hash_cb);
+
+    printf("%d controls, %d packets per run\n\n", dj_state_control_count(), packets);
+    printf("%-20s %12s %12s %8s %10s\n", "workload", "full ns/pkt", "sparse ns/pkt", "speedup", "events");
+
+    int rc = 0;
+    for (int l = 0; l < LOAD_COUNT; l++) {
+        uint8_t *stream = make_stream(l, packets);
+
+        double full_ns = run(dj_state_process_full, stream, packets);
+        uint64_t full_hash = s_hash;
+        uint32_t full_events = s_events;
+
+        double sparse_ns = run(dj_state_process, stream, packets);
+        bool same = (s_hash == full_hash && s_events == full_events);
+
+        printf("%-20s %12.1f %12.1f %7.1fx %10u%s\n", s_load_names[l], full_ns, sparse_ns,
+               full_ns / sparse_ns, (unsigned)s_events, same ? "" : "  MISMATCH");
+        if (!same) rc = 1;
+        free(stream);
+    }
+    return rc;
+}
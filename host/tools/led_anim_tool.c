@@ -0,0 +1,97 @@
+// Plays the LED animations (main/led_anim.c) against a virtual clock and
+// prints every keyframe as a strip of the 34 LEDs ('#' on, '.' off). Checks
+// that each animation ends after exactly its duration, that queued ones
+// play back to back and that stop ends one early.
+//
+//   led_anim_tool            # all animations
+//   led_anim_tool chase      # one
+
+#include "led_anim.h"
+#include "host_clock.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+
+#define STEP_US     5000    // Virtual time per render call (finer than any keyframe)
+
+static void print_frame(uint32_t t_ms, const dj_led_frame_t *frame)
+{
+    char strip[LED_NOTE_MAX + 2];
+    int n = 0;
+    for (uint64_t m = LED_VALID_MASK; m; m &= m - 1) {
+        strip[n++] = (frame->solid >> __builtin_ctzll(m)) & 1 ? '#' : '.';
+    }
+    strip[n] = '\0';
+    printf("  %6lu ms  %s\n", (unsigned long)t_ms, strip);
+}
+
+// Render from now until nothing plays; returns the virtual time that took
+static int64_t play(int64_t *now_us, bool verbose, int *keyframes)
+{
+    int64_t start = *now_us;
+    dj_led_frame_t frame, last = {~0ULL, ~0ULL};
+    *keyframes = 0;
+    for (;;) {
+        host_clock_set_us(*now_us);
+        if (!led_anim_render(esp_timer_get_time(), &frame)) break;
+        if (frame.solid != last.solid || frame.blink != last.blink) {
+            if (verbose) print_frame((uint32_t)((*now_us - start) / 1000), &frame);
+            (*keyframes)++;
+            last = frame;
+        }
+        *now_us += STEP_US;
+    }
+    return *now_us - start;
+}
+
+int main(int argc, char **argv)
+{
+    host_clock_set_manual(true);
+    led_anim_init();
+    int64_t now_us = 0;
+    int rc = 0;
+
+    for (int id = 0; id < LED_ANIM_COUNT; id++) {
+        if (argc > 1 && strcmp(argv[1], led_anim_name(id)) != 0) continue;
+        uint32_t want_ms = led_anim_duration_ms(id);
+        led_anim_start(id);
+        printf("%s (%lu ms)\n", led_anim_name(id), (unsigned long)want_ms);
+
+        int keyframes;
+        int64_t took_us = play(&now_us, true, &keyframes);
+        printf("  %d keyframes, %lld ms\n", keyframes, (long long)(took_us / 1000));
+        if (took_us / 1000 != want_ms) {
+            fprintf(stderr, "%s: ran %lld ms, expected %lu\n", led_anim_name(id),
+                    (long long)(took_us / 1000), (unsigned long)want_ms);
+            rc = 1;
+        }
+    }
+    if (argc > 1) return rc;
+
+    // Queued back to back: total time is the sum
+    led_anim_start(LED_ANIM_FLASH);
+    led_anim_start(LED_ANIM_PULSE);
+    int keyframes;
+    int64_t took_ms = play(&now_us, false, &keyframes) / 1000;
+    uint32_t sum_ms = led_anim_duration_ms(LED_ANIM_FLASH) + led_anim_duration_ms(LED_ANIM_PULSE);
+    printf("flash + pulse queued: %lld ms (expected %lu)\n", (long long)took_ms, (unsigned long)sum_ms);
+    if (took_ms != sum_ms) rc = 1;
+
+    // Stop after 100 ms, with another one still queued
+    dj_led_frame_t frame;
+    led_anim_start(LED_ANIM_TEST);
+    led_anim_start(LED_ANIM_CHASE);
+    host_clock_set_us(now_us);
+    led_anim_render(esp_timer_get_time(), &frame);
+    now_us += 100000;
+    led_anim_stop();
+    host_clock_set_us(now_us);
+    bool playing = led_anim_render(esp_timer_get_time(), &frame);
+    printf("stop: %s\n", playing ? "still playing" : "ended, queue dropped");
+    if (playing) rc = 1;
+
+    if (led_anim_find("nope") != -1 || led_anim_start(LED_ANIM_COUNT) != ESP_ERR_INVALID_ARG) rc = 1;
+    printf("%s\n", rc ? "FAILED" : "OK");
+    return rc;
+}
@@ -0,0 +1,115 @@
+// Drives the LED meters (main/led_meter.c) with synthetic telemetry on a
+// virtual clock and prints each deck's bar as the LEDs would get it. Checks
+// the value-to-segment scaling, the fall hysteresis, the per-deck rate limit,
+// the hold of a held meter over the base one and the poll schedule.
+//
+//   led_meter_tool
+
+#include "led_meter.h"
+#include "dj_led.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TICK_US     (LED_METER_TICK_MS * 1000LL)
+
+static int s_rc = 0;
+
+// Segments lit on the 8 LEDs from n1 in the desired frame
+static int bar_of(uint8_t n1)
+{
+    dj_led_frame_t want;
+    dj_led_get_frames(&want, NULL);
+    return __builtin_popcountll(want.solid & (0xFFULL << n1));
+}
+
+static void expect(const char *what, int got, int want)
+{
+    printf("  %-40s %d%s\n", what, got, got == want ? "" : "  <-- WRONG");
+    if (got != want) s_rc = 1;
+}
+
+// Run ticks up to until_us; returns the number of polls sent
+static int run(int64_t *now_us, int64_t until_us)
+{
+    const char *queries[LED_METER_MAX];
+    int polls = 0;
+    for (; *now_us < until_us; *now_us += TICK_US) {
+        polls += led_meter_tick(*now_us, queries, LED_METER_MAX);
+    }
+    return polls;
+}
+
+int main(void)
+{
+    dj_led_init();
+
+    led_meter_def_t defs[3];
+    led_meter_default("ZZSM", 0, &defs[0]);
+    led_meter_default("ZZAG", 0, &defs[1]);
+    led_meter_default("ZZPC", 1, &defs[2]);
+    led_meter_set_defs(defs, 3);
+    int64_t now_us = 0;
+
+    // ZZSM 26..214 over 8 segments: 23.5 per segment
+    printf("S-meter on deck A\n");
+    led_meter_on_value(0, "0026", now_us);
+    run(&now_us, now_us + TICK_US);
+    expect("S0", bar_of(LED_N1_A), 0);
+    led_meter_on_value(0, "0120", now_us);
+    run(&now_us, now_us + 200000);
+    expect("value 120", bar_of(LED_N1_A), 4);
+    led_meter_on_value(0, "0119", now_us);
+    run(&now_us, now_us + 200000);
+    expect("just under the boundary (hysteresis)", bar_of(LED_N1_A), 4);
+    led_meter_on_value(0, "0110", now_us);
+    run(&now_us, now_us + 200000);
+    expect("a quarter segment under", bar_of(LED_N1_A), 3);
+    led_meter_on_value(0, "0250", now_us);
+    run(&now_us, now_us + 200000);
+    expect("over range", bar_of(LED_N1_A), 8);
+
+    // Rate limit: a burst of replies within one LED_METER_MIN_MS window
+    printf("Rate limit (%d ms)\n", LED_METER_MIN_MS);
+    int changes = 0, last = bar_of(LED_N1_A);
+    for (int i = 0; i < 20; i++) {
+        led_meter_on_value(0, i % 2 ? "0026" : "0214", now_us);
+        run(&now_us, now_us + TICK_US);
+        int bar = bar_of(LED_N1_A);
+        if (bar != last) changes++;
+        last = bar;
+    }
+    expect("bar changes in 1 s of flapping", changes <= 1000 / LED_METER_MIN_MS, 1);
+
+    // Hold: AF gain takes deck A over for 2 s after it changes
+    printf("Hold\n");
+    led_meter_on_value(0, "0120", now_us);
+    led_meter_on_value(1, "50", now_us);   // First reply: no change yet
+    run(&now_us, now_us + 200000);
+    expect("AF gain first reply: S-meter stays", bar_of(LED_N1_A), 4);
+    led_meter_on_value(1, "100", now_us);
+    run(&now_us, now_us + 200000);
+    expect("AF gain changed: shown", bar_of(LED_N1_A), 8);
+    run(&now_us, now_us + 2000000);
+    expect("after the hold: S-meter back", bar_of(LED_N1_A), 4);
+
+    // Polls: S-meter every 200 ms, the others every 1000 ms
+    printf("Polls\n");
+    expect("polls in 2 s", run(&now_us, now_us + 2000000), 10 + 2 + 2);
+
+    // Deck B has only a held meter: dark until drive changes
+    led_meter_on_value(2, "40", now_us);
+    run(&now_us, now_us + 200000);
+    expect("deck B, first drive reply", bar_of(LED_N1_B), 0);
+    led_meter_on_value(2, "50", now_us);
+    run(&now_us, now_us + 200000);
+    expect("deck B, drive changed to 50", bar_of(LED_N1_B), 4);
+
+    // Removing the meters gives the LEDs back without waiting for a tick
+    led_meter_set_defs(NULL, 0);
+    expect("meters removed: deck A", bar_of(LED_N1_A), 0);
+    expect("meters removed: deck B", bar_of(LED_N1_B), 0);
+
+    printf("%s\n", s_rc ? "FAILED" : "OK");
+    return s_rc;
+}
@@ -0,0 +1,388 @@
+// Mock Thetis CAT server (TCP, ZZ protocol) for host testing.
+//
+// Answers queries from a simulated radio state, echoes sets, and returns
+// "?;" for commands not in the command database. Each client gets its own
+// thread; radio state is shared like in Thetis.
+//
+// Fault/latency injection:
+//   --delay-ms N        processing delay applied to every command
+//   --delay ZZXX=N      per-command delay override (repeatable)
+//   --rx-buf N          bounded per-client input buffer (bytes). The server
+//                       only reads from the socket when there is room, so a
+//                       slow server backs up into the client's send().
+//   --drop-after N      close the connection after N commands
+//   --drop-every-ms N   close each connection N ms after it was accepted
+//
+//   mock_thetis [--port 31001] [options] [-v]
+
+#include "mapping_engine.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define MAX_STATE        128
+#define MAX_DELAYS       32
+#define MAX_CMD_LEN      64
+#define DEFAULT_RX_BUF   4096
+
+// ---------------------------------------------------------------------------
+// Options
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char prefix[5];
+    int  delay_ms;
+} cmd_delay_t;
+
+static int         s_port = 31001;
+static int         s_delay_ms = 0;
+static cmd_delay_t s_delays[MAX_DELAYS];
+static int         s_delay_count = 0;
+static int         s_rx_buf_size = DEFAULT_RX_BUF;
+static int         s_drop_after = 0;
+static int         s_drop_every_ms = 0;
+static bool        s_verbose = false;
+
+// ---------------------------------------------------------------------------
+// Simulated radio state
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char prefix[5];
+    char value[16];
+} state_entry_t;
+
+static state_entry_t   s_state[MAX_STATE];
+static int             s_state_count = 0;
+static pthread_mutex_t s_state_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t         s_total_cmds = 0;
+static int64_t         s_total_errors = 0;
+static int             s_max_fill = 0;
+static int64_t         s_total_reads = 0;       // recv() calls with data, ~ TCP segments
+static int64_t         s_first_read_ms = 0;
+static int64_t         s_last_read_ms = 0;
+
+static state_entry_t *state_find(const char *prefix)
+{
+    for (int i = 0; i < s_state_count; i++) {
+        if (strcmp(s_state[i].prefix, prefix) == 0) return &s_state[i];
+    }
+    return NULL;
+}
+
+static void state_put(const char *prefix, const char *value)
+{
+    state_entry_t *e = state_find(prefix);
+    if (!e) {
+        if (s_state_count >= MAX_STATE) return;
+        e = &s_state[s_state_count++];
+        snprintf(e->prefix, sizeof(e->prefix), "%s", prefix);
+    }
+    snprintf(e->value, sizeof(e->value), "%s", value);
+}
+
+static void state_init(void)
+{
+    state_put("ZZFA", "00014074000");
+    state_put("ZZFB", "00007074000");
+    state_put("ZZAC", "02");
+    state_put("ZZFH", "02800");
+    state_put("ZZFL", "00100");
+    state_put("ZZMD", "01");
+    state_put("ZZAG", "050");
+    state_put("ZZPC", "050");
+}
+
+static const thetis_cmd_t *db_find_prefix(const char *prefix)
+{
+    int count = 0;
+    const thetis_cmd_t *db = cmd_db_get_all(&count);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(db[i].cat_cmd, prefix) == 0) return &db[i];
+        if (db[i].cat_cmd2 && strcmp(db[i].cat_cmd2, prefix) == 0) return &db[i];
+    }
+    return NULL;
+}
+
+/**
+ * Handle one command (without ';'). Writes the reply (with ';') into out,
+ * or leaves it empty when Thetis would stay silent.
+ */
+static void handle_command(const char *msg, char *out, size_t out_size)
+{
+    out[0] = '\0';
+    int len = (int)strlen(msg);
+    int plen = (len >= 4 && msg[0] == 'Z' && msg[1] == 'Z') ? 4 : 2;
+    if (len < plen) {
+        snprintf(out, out_size, "?;");
+        return;
+    }
+
+    char prefix[5] = {0};
+    memcpy(prefix, msg, plen);
+    const char *value = msg + plen;
+
+    // Kenwood FA/FB are aliases of ZZFA/ZZFB
+    char zz[5];
+    if (plen == 2 && (strcmp(prefix, "FA") == 0 || strcmp(prefix, "FB") == 0)) {
+        snprintf(zz, sizeof(zz), "ZZ%s", prefix);
+    } else {
+        snprintf(zz, sizeof(zz), "%s", prefix);
+    }
+
+    pthread_mutex_lock(&s_state_lock);
+    state_entry_t *e = state_find(zz);
+    const thetis_cmd_t *cmd = e ? NULL : db_find_prefix(zz);
+
+    if (!e && !cmd) {
+        s_total_errors++;
+        snprintf(out, out_size, "?;");
+    } else if (strcmp(zz, "ZZSM") == 0) {
+        // S-meter: "ZZSM0;" -> "ZZSM0nnn;" with a slowly wandering reading
+        int rx = value[0] ? value[0] - '0' : 0;
+        snprintf(out, out_size, "ZZSM%d%03d;", rx, 60 + (int)(time(NULL) % 40));
+    } else if (value[0] == '\0') {
+        if (e) {
+            snprintf(out, out_size, "%s%s;", prefix, e->value);
+        } else if (cmd->exec_type == CMD_CAT_TOGGLE) {
+            // Toggle defaults to off until set
+            snprintf(out, out_size, "%s%0*d;", prefix, cmd->value_digits, 0);
+        }
+        // Action commands (ZZBU;, ZZHU; ...) have no reply
+    } else {
+        state_put(zz, value);
+        snprintf(out, out_size, "%s%s;", prefix, value);
+    }
+    pthread_mutex_unlock(&s_state_lock);
+}
+
+static int command_delay_ms(const char *msg)
+{
+    for (int i = 0; i < s_delay_count; i++) {
+        if (strncmp(msg, s_delays[i].prefix, strlen(s_delays[i].prefix)) == 0) {
+            return s_delays[i].delay_ms;
+        }
+    }
+    return s_delay_ms;
+}
+
+// ---------------------------------------------------------------------------
+// Client handling
+// ---------------------------------------------------------------------------
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+static void *client_thread(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    char *buf = malloc(s_rx_buf_size);
+    int fill = 0;
+    int handled = 0;
+    int64_t accepted_ms = now_ms();
+
+    // Bound the kernel receive buffer too, so backpressure reaches the client
+    int rcvbuf = s_rx_buf_size;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (s_drop_every_ms > 0) {
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    while (buf) {
+        if (s_drop_every_ms > 0 && now_ms() - accepted_ms >= s_drop_every_ms) {
+            fprintf(stderr, "mock: dropping client after %d ms\n", s_drop_every_ms);
+            break;
+        }
+
+        ssize_t n = recv(fd, buf + fill, s_rx_buf_size - fill, 0);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            break;
+        }
+        fill += (int)n;
+        pthread_mutex_lock(&s_state_lock);
+        if (fill > s_max_fill) s_max_fill = fill;
+        s_last_read_ms = now_ms();
+        if (s_total_reads++ == 0) s_first_read_ms = s_last_read_ms;
+        pthread_mutex_unlock(&s_state_lock);
+
+        // Process every complete command in the buffer
+        int start = 0;
+        bool drop = false;
+        for (int i = 0; i < fill && !drop; i++) {
+            if (buf[i] != ';') continue;
+
+            char msg[MAX_CMD_LEN];
+            int mlen = i - start;
+            if (mlen >= MAX_CMD_LEN) mlen = MAX_CMD_LEN - 1;
+            memcpy(msg, buf + start, mlen);
+            msg[mlen] = '\0';
+            start = i + 1;
+
+            int delay = command_delay_ms(msg);
+            if (delay > 0) sleep_ms(delay);
+
+            char reply[MAX_CMD_LEN + 8];
+            handle_command(msg, reply, sizeof(reply));
+            if (s_verbose) {
+                fprintf(stderr, "mock: %s; -> %s\n", msg, reply[0] ? reply : "(none)");
+            }
+            if (reply[0] && send(fd, reply, strlen(reply), MSG_NOSIGNAL) < 0) {
+                drop = true;
+            }
+
+            pthread_mutex_lock(&s_state_lock);
+            s_total_cmds++;
+            pthread_mutex_unlock(&s_state_lock);
+
+            if (s_drop_after > 0 && ++handled >= s_drop_after) {
+                fprintf(stderr, "mock: dropping client after %d commands\n", handled);
+                drop = true;
+            }
+        }
+        if (drop) break;
+
+        memmove(buf, buf + start, fill - start);
+        fill -= start;
+
+        // A full buffer with no terminator can never complete: reject it
+        if (fill == s_rx_buf_size) {
+            fprintf(stderr, "mock: input buffer overflow (%d bytes), discarding\n", fill);
+            send(fd, "?;", 2, MSG_NOSIGNAL);
+            fill = 0;
+        }
+    }
+
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    s_stop = 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--port P] [--delay-ms N] [--delay ZZXX=N]... [--rx-buf BYTES]\n"
+            "          [--drop-after N] [--drop-every-ms N] [-v]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            s_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--delay-ms") == 0 && i + 1 < argc) {
+            s_delay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) {
+            const char *spec = argv[++i];
+            const char *eq = strchr(spec, '=');
+            if (!eq || eq - spec > 4 || s_delay_count >= MAX_DELAYS) {
+                usage(argv[0]);
+                return 2;
+            }
+            cmd_delay_t *d = &s_delays[s_delay_count++];
+            memset(d->prefix, 0, sizeof(d->prefix));
+            memcpy(d->prefix, spec, eq - spec);
+            d->delay_ms = atoi(eq + 1);
+        } else if (strcmp(argv[i], "--rx-buf") == 0 && i + 1 < argc) {
+            s_rx_buf_size = atoi(argv[++i]);
+            if (s_rx_buf_size < MAX_CMD_LEN) s_rx_buf_size = MAX_CMD_LEN;
+        } else if (strcmp(argv[i], "--drop-after") == 0 && i + 1 < argc) {
+            s_drop_after = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--drop-every-ms") == 0 && i + 1 < argc) {
+            s_drop_every_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            s_verbose = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    state_init();
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);   // No SA_RESTART: accept() returns EINTR
+    sigaction(SIGTERM, &sa, NULL);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = htons(s_port),
+    };
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 4) != 0) {
+        perror("mock: bind/listen");
+        return 1;
+    }
+    fprintf(stderr, "mock: Thetis CAT server on port %d (delay %d ms, rx-buf %d)\n",
+            s_port, s_delay_ms, s_rx_buf_size);
+
+    while (!s_stop) {
+        struct sockaddr_in peer;
+        socklen_t plen = sizeof(peer);
+        int fd = accept(listen_fd, (struct sockaddr *)&peer, &plen);
+        if (fd < 0) continue;
+        fprintf(stderr, "mock: client %s:%d connected\n",
+                inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+
+        pthread_t t;
+        if (pthread_create(&t, NULL, client_thread, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(t);
+    }
+
+    pthread_mutex_lock(&s_state_lock);
+    fprintf(stderr, "mock: %lld commands, %lld errors, max buffer fill %d bytes\n",
+            (long long)s_total_cmds, (long long)s_total_errors, s_max_fill);
+    int64_t span_ms = s_last_read_ms - s_first_read_ms;
+    fprintf(stderr, "mock: %lld reads (%.1f commands/read, %.0f reads/s)\n",
+            (long long)s_total_reads,
+            s_total_reads ? (double)s_total_cmds / s_total_reads : 0.0,
+            span_ms > 0 ? s_total_reads * 1000.0 / span_ms : 0.0);
+    pthread_mutex_unlock(&s_state_lock);
+    close(listen_fd);
+    return 0;
+}
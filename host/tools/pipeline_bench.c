@@ -0,0 +1,343 @@
+// Host benchmark for the control pipeline:
+//   bulk IN packet -> dj_state diff -> mapping engine -> CAT send over TCP.
+//
+// By default an in-process TCP sink plays Thetis (answers ZZFA/ZZFB/ZZAC
+// queries, swallows everything else). Use --host/--port to point at a real
+// Thetis or the mock server instead.
+//
+// A last stage interleaves a button (ZZBS) between two VFO A sets, over and
+// over, and checks that no set reaches the sink ahead of the button queued
+// before it.
+//
+// --wheel maps Jog_A to a relative WHEEL command (Filter High Wheel,
+// ZZHU/ZZHD) and turns it 5 steps per packet; --rate paces the packets
+// (packets/s, default as fast as possible).
+//
+//   pipeline_bench [--packets N] [--host H] [--port P] [--wheel] [--rate HZ] [-v]
+
+#include "dj_state.h"
+#include "usb_dj_host.h"
+#include "usb_debug.h"
+#include "mapping_engine.h"
+#include "cat_client.h"
+#include "latency.h"
+#include "metrics.h"
+#include "host_usb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#define JOG_A_OFFSET 15
+
+// ---------------------------------------------------------------------------
+// In-process Thetis sink
+// ---------------------------------------------------------------------------
+
+static int               s_listen_fd = -1;
+static volatile uint32_t s_sink_cmds = 0;
+static volatile uint32_t s_sink_order_errors = 0;   // ZZFA sets that went backwards
+static volatile uint32_t s_sink_buttons = 0;        // ZZBS received
+static volatile uint32_t s_sink_overtaken = 0;      // ZZFA sets ahead of an earlier ZZBS
+
+// Interleave stage: round r queues ZZFA(base + 2r), ZZBS, ZZFA(base + 2r + 1)
+#define INTERLEAVE_BASE   50000000L
+#define INTERLEAVE_ROUNDS 20000
+
+static void sink_reply(int fd, const char *cmd)
+{
+    char reply[32];
+    if (strcmp(cmd, "ZZFA") == 0 || strcmp(cmd, "ZZFB") == 0) {
+        snprintf(reply, sizeof(reply), "%.4s%011d;", cmd, 14074000);
+    } else if (strcmp(cmd, "ZZAC") == 0) {
+        snprintf(reply, sizeof(reply), "ZZAC02;");
+    } else {
+        return;
+    }
+    send(fd, reply, strlen(reply), 0);
+}
+
+static void *sink_thread(void *arg)
+{
+    (void)arg;
+    int fd = accept(s_listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+
+    char buf[4096];
+    char cmd[64];
+    int cmd_len = 0;
+    long last_freq = 0;
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] != ';') {
+                if (cmd_len < (int)sizeof(cmd) - 1) cmd[cmd_len++] = buf[i];
+                continue;
+            }
+            cmd[cmd_len] = '\0';
+            s_sink_cmds++;
+            // The jog only turns forward, so VFO A sets must arrive in
+            // ascending order if the TX queue preserves ordering
+            if (cmd_len == 15 && strncmp(cmd, "ZZFA", 4) == 0) {
+                long f = atol(cmd + 4);
+                if (f < last_freq) s_sink_order_errors++;
+                last_freq = f;
+                // Round r's sets: the first needs r buttons before it, the
+                // second r + 1
+                if (f >= INTERLEAVE_BASE) {
+                    long r = (f - INTERLEAVE_BASE) / 2;
+                    if (s_sink_buttons < r + (f - INTERLEAVE_BASE) % 2) s_sink_overtaken++;
+                }
+            } else if (strncmp(cmd, "ZZBS", 4) == 0) {
+                s_sink_buttons++;
+            }
+            sink_reply(fd, cmd);  // Only bare 4-char queries match
+            cmd_len = 0;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static int sink_start(void)
+{
+    s_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0,
+    };
+    if (bind(s_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(s_listen_fd, 1) != 0) {
+        perror("sink");
+        return -1;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(s_listen_fd, (struct sockaddr *)&addr, &len);
+
+    pthread_t t;
+    pthread_create(&t, NULL, sink_thread, NULL);
+    pthread_detach(t);
+    return ntohs(addr.sin_port);
+}
+
+// ---------------------------------------------------------------------------
+// Pipeline wiring (mirrors main.c)
+// ---------------------------------------------------------------------------
+
+static volatile uint32_t s_control_events = 0;
+
+static void usb_control_cb(
+    uint8_t control_id, dj_control_type_t control_type,
+    uint8_t old_value, uint8_t new_value)
+{
+    s_control_events++;
+    usb_debug_control_cb(control_id, control_type, old_value, new_value);
+    mapping_engine_on_control(control_id, control_type, old_value, new_value);
+}
+
+static void cat_state_cb(cat_state_t new_state)
+{
+    if (new_state == CAT_STATE_CONNECTED) {
+        mapping_engine_request_sync();
+    }
+}
+
+static void cat_response_cb(const char *cmd, const char *value)
+{
+    mapping_engine_on_cat_response(cmd, value);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int s_jog_step = 1;
+
+// One jog step per packet (s_jog_step ticks); the remaining bytes stay idle
+static void make_jog_packet(uint8_t *pkt, uint8_t jog)
+{
+    jog = (uint8_t)(jog * s_jog_step);
+    memset(pkt, 0, DJ_STATE_SIZE);
+    pkt[JOG_A_OFFSET] = jog;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    int packets = 100000;
+    const char *host = NULL;
+    int port = 0;
+    esp_log_level_t level = ESP_LOG_WARN;
+    bool wheel = false;
+    int rate = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--packets") == 0 && i + 1 < argc) {
+            packets = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            host = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--wheel") == 0) {
+            wheel = true;
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            level = ESP_LOG_INFO;
+        } else {
+            fprintf(stderr, "usage: %s [--packets N] [--host H] [--port P] "
+                    "[--wheel] [--rate HZ] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    esp_log_level_set("*", level);
+
+    if (!host) {
+        host = "127.0.0.1";
+        port = sink_start();
+        if (port < 0) return 1;
+    } else if (port == 0) {
+        port = 31001;
+    }
+
+    mapping_engine_init();
+    if (wheel) {
+        // Filter High Wheel: one ZZHU per tick, 5 ticks per packet
+        mapping_entry_t e = { .control_id = dj_control_find("Jog_A"), .command_id = 604 };
+        mapping_engine_set(&e);
+        s_jog_step = 5;
+    }
+    usb_dj_host_init(usb_control_cb);
+
+    cat_client_config_t cfg = {
+        .port = (uint16_t)port,
+        .state_cb = cat_state_cb,
+        .response_cb = cat_response_cb,
+    };
+    snprintf(cfg.host, sizeof(cfg.host), "%s", host);
+    cat_client_init(&cfg);
+
+    for (int i = 0; i < 50 && cat_client_get_state() != CAT_STATE_CONNECTED; i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (cat_client_get_state() != CAT_STATE_CONNECTED) {
+        fprintf(stderr, "CAT connect to %s:%d failed\n", host, port);
+        return 1;
+    }
+
+    uint8_t pkt[DJ_STATE_SIZE];
+
+    // Stage 1: decoder only (no callback)
+    dj_state_set_callback(NULL);
+    dj_state_reset();
+    int64_t t0 = now_ns();
+    for (int i = 0; i < packets; i++) {
+        make_jog_packet(pkt, (uint8_t)i);
+        dj_state_process(pkt);
+    }
+    int64_t decode_ns = now_ns() - t0;
+
+    // Stage 2: full pipeline. The first jog tick after idle triggers a VFO
+    // re-sync, so tick once and give the response time to land.
+    dj_state_set_callback(usb_control_cb);
+    host_usb_set_connected(true);
+    make_jog_packet(pkt, 1);
+    host_usb_feed(pkt, DJ_STATE_SIZE);
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    uint32_t events_before = s_control_events;
+    t0 = now_ns();
+    int64_t period_ns = rate > 0 ? 1000000000LL / rate : 0;
+    for (int i = 0; i < packets; i++) {
+        make_jog_packet(pkt, (uint8_t)(i + 2));
+        host_usb_feed(pkt, DJ_STATE_SIZE);
+        if (period_ns) {
+            int64_t wait = t0 + (i + 1) * period_ns - now_ns();
+            if (wait > 0) {
+                struct timespec ts = { wait / 1000000000LL, wait % 1000000000LL };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    int64_t pipeline_ns = now_ns() - t0;
+    uint32_t events = s_control_events - events_before;
+
+    vTaskDelay(pdMS_TO_TICKS(200));  // Let the sink drain
+
+    // Stage 3: a button between two sets of the same prefix
+    int interleave_rounds = 0;
+    if (s_listen_fd >= 0) {
+        char cmd[32];
+        for (long r = 0; r < INTERLEAVE_ROUNDS; r++) {
+            snprintf(cmd, sizeof(cmd), "ZZFA%011ld;", INTERLEAVE_BASE + 2 * r);
+            cat_client_send_latest(cmd);
+            cat_client_send("ZZBS020;");
+            snprintf(cmd, sizeof(cmd), "ZZFA%011ld;", INTERLEAVE_BASE + 2 * r + 1);
+            cat_client_send_latest(cmd);
+            interleave_rounds++;
+            if (r % 32 == 31) vTaskDelay(1);   // Stay under the queue depth
+        }
+        vTaskDelay(pdMS_TO_TICKS(200));
+    }
+
+    printf("packets:          %d\n", packets);
+    printf("decode only:      %8.1f ns/packet\n", (double)decode_ns / packets);
+    printf("full pipeline:    %8.1f ns/packet (%u control events)\n",
+           (double)pipeline_ns / packets, (unsigned)events);
+    if (s_listen_fd >= 0) {
+        printf("sink received:    %u CAT commands (%u out of order)\n",
+               (unsigned)s_sink_cmds, (unsigned)s_sink_order_errors);
+        printf("interleaved:      %d x set/button/set, %u buttons received, "
+               "%u sets ahead of an earlier button\n",
+               interleave_rounds, (unsigned)s_sink_buttons, (unsigned)s_sink_overtaken);
+    }
+
+    cat_tx_stats_t tx;
+    cat_client_get_tx_stats(&tx);
+    printf("CAT TX queue:     %u queued, %u coalesced, %u dropped, high water %u, "
+           "%u send() calls (%.1f cmds each)\n",
+           (unsigned)tx.enqueued, (unsigned)tx.coalesced, (unsigned)tx.dropped,
+           (unsigned)tx.high_water, (unsigned)tx.batches,
+           tx.batches ? (double)tx.enqueued / tx.batches : 0.0);
+
+    mapping_queue_stats_t eq;
+    mapping_engine_get_queue_stats(&eq);
+    printf("engine queue:     %u events, %u coalesced, %u dropped, high water %u, "
+           "latency avg %u us, max %u us\n",
+           (unsigned)eq.handled, (unsigned)eq.coalesced, (unsigned)eq.dropped, (unsigned)eq.high_water,
+           (unsigned)eq.latency_avg_us, (unsigned)eq.latency_max_us);
+
+    for (int st = 0; st < LATENCY_STAGE_COUNT; st++) {
+        latency_hist_t h;
+        latency_get(st, &h);
+        printf("latency %-16s %6u samples, p50 <= %u us, p99 <= %u us, max %u us\n",
+               latency_stage_name(st), (unsigned)h.count, (unsigned)latency_percentile_us(&h, 50),
+               (unsigned)latency_percentile_us(&h, 99), (unsigned)h.max_us);
+    }
+
+    printf("metrics:          %u USB packets, %u encoder events, %u CAT cmds / %u bytes sent, "
+           "%u responses\n",
+           (unsigned)metrics_get(METRIC_USB_PACKETS), (unsigned)metrics_get(METRIC_CONTROL_ENCODER),
+           (unsigned)metrics_get(METRIC_CAT_CMDS_SENT), (unsigned)metrics_get(METRIC_CAT_BYTES_SENT),
+           (unsigned)metrics_get(METRIC_CAT_RESPONSES));
+
+    cat_client_stop();
+    return s_sink_overtaken ? 1 : 0;
+}
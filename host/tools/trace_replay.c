@@ -0,0 +1,324 @@
+// Replay a USB packet trace (recorded on the device via /api/trace) through
+// the host build of the control pipeline, and compare the CAT output with a
+// golden file.
+//
+// Offline (default): the mapping engine runs on a virtual clock driven by the
+// trace timestamps, so output is deterministic and the replay runs at max
+// speed. Thetis is simulated by feeding each VFO set back as a response,
+// i.e. a radio that answers before the next packet.
+//
+// Live (--host/--port): CAT commands go to a real or mock Thetis over TCP,
+// paced at --speed (0 = max, 1 = real time, N = N times faster).
+//
+//   trace_replay TRACE [--write-golden OUT | --golden FILE] [-v]
+//   trace_replay TRACE --host 127.0.0.1 --port 31001 [--speed N]
+//   trace_replay --synth OUT [--packets N]
+
+#include "dj_state.h"
+#include "usb_trace.h"
+#include "usb_dj_host.h"
+#include "mapping_engine.h"
+#include "cat_client.h"
+#include "dj_led.h"
+#include "metrics.h"
+#include "host_clock.h"
+#include "host_usb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+// Virtual clock starts a little after "boot", like a real session
+#define VIRTUAL_BASE_US 10000000LL
+
+// ---------------------------------------------------------------------------
+// CAT output capture
+// ---------------------------------------------------------------------------
+
+static bool     s_offline = true;
+static uint32_t s_cur_t_us = 0;
+static uint32_t s_control_events = 0;
+static char    *s_out = NULL;
+static size_t   s_out_len = 0;
+static size_t   s_out_cap = 0;
+static uint32_t s_out_lines = 0;
+
+// Simulated radio for offline mode
+static char s_vfo_a[16] = "00014074000";
+static char s_vfo_b[16] = "00007074000";
+
+static void out_append(const char *line)
+{
+    size_t n = strlen(line);
+    if (s_out_len + n + 1 > s_out_cap) {
+        s_out_cap = (s_out_cap ? s_out_cap * 2 : 65536) + n;
+        s_out = realloc(s_out, s_out_cap);
+    }
+    memcpy(s_out + s_out_len, line, n + 1);
+    s_out_len += n;
+    s_out_lines++;
+}
+
+static void on_cat_dispatch(uint8_t control_id, const char *command_name,
+                            cmd_exec_type_t exec_type, const char *cat_string)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "%u %s %s\n", (unsigned)s_cur_t_us,
+             dj_control_name(control_id), cat_string);
+    out_append(line);
+
+    if (s_offline && strlen(cat_string) >= 15) {
+        if (strncmp(cat_string, "ZZFA", 4) == 0) snprintf(s_vfo_a, sizeof(s_vfo_a), "%.11s", cat_string + 4);
+        if (strncmp(cat_string, "ZZFB", 4) == 0) snprintf(s_vfo_b, sizeof(s_vfo_b), "%.11s", cat_string + 4);
+    }
+}
+
+static void usb_control_cb(
+    uint8_t control_id, dj_control_type_t control_type,
+    uint8_t old_value, uint8_t new_value)
+{
+    s_control_events++;
+    mapping_engine_on_control(control_id, control_type, old_value, new_value);
+}
+
+static void packet_hook(uint32_t t_us, const uint8_t *data, void *ctx)
+{
+    // The engine runs on its own task: let it finish the previous packet
+    // before the clock moves, so the output stays deterministic
+    if (s_offline) mapping_engine_flush();
+    s_cur_t_us = t_us;
+    if (s_offline) {
+        host_clock_set_us(VIRTUAL_BASE_US + t_us);
+        // Thetis answers VFO queries/sets before the next packet
+        mapping_engine_on_cat_response("ZZFA", s_vfo_a);
+        mapping_engine_on_cat_response("ZZFB", s_vfo_b);
+    }
+}
+
+static void seed_sync(void)
+{
+    mapping_engine_on_cat_response("ZZFA", s_vfo_a);
+    mapping_engine_on_cat_response("ZZFB", s_vfo_b);
+    mapping_engine_on_cat_response("ZZAC", "02");
+    mapping_engine_on_cat_response("ZZFH", "02800");
+    mapping_engine_on_cat_response("ZZFL", "00100");
+}
+
+static void cat_state_cb(cat_state_t new_state)
+{
+    if (new_state == CAT_STATE_CONNECTED) mapping_engine_request_sync();
+}
+
+// ---------------------------------------------------------------------------
+// Files
+// ---------------------------------------------------------------------------
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(size + 1);
+    if (buf && fread(buf, 1, size, f) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (buf) {
+        buf[size] = '\0';
+        *len = size;
+    }
+    return buf;
+}
+
+static int compare_golden(const char *path)
+{
+    size_t len = 0;
+    char *golden = (char *)read_file(path, &len);
+    if (!golden) {
+        fprintf(stderr, "cannot read golden file %s\n", path);
+        return 1;
+    }
+
+    // Walk both outputs line by line and report the first difference
+    const char *a = golden, *b = s_out ? s_out : "";
+    int line = 1;
+    while (*a || *b) {
+        const char *ea = strchr(a, '\n'), *eb = strchr(b, '\n');
+        size_t la = ea ? (size_t)(ea - a) : strlen(a);
+        size_t lb = eb ? (size_t)(eb - b) : strlen(b);
+        if (la != lb || memcmp(a, b, la) != 0) {
+            printf("MISMATCH at line %d\n  golden: %.*s\n  actual: %.*s\n",
+                   line, (int)la, a, (int)lb, b);
+            free(golden);
+            return 1;
+        }
+        a += la + (ea ? 1 : 0);
+        b += lb + (eb ? 1 : 0);
+        line++;
+    }
+    printf("golden match: %d lines\n", line - 1);
+    free(golden);
+    return 0;
+}
+
+// Synthetic trace: jog bursts with idle gaps, a volume sweep and button taps
+static int write_synth(const char *path, int packets)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) return 1;
+
+    usb_trace_header_t hdr = { .version = USB_TRACE_VERSION, .record_size = sizeof(usb_trace_record_t) };
+    memcpy(hdr.magic, USB_TRACE_MAGIC, 4);
+    fwrite(&hdr, sizeof(hdr), 1, f);
+
+    usb_trace_record_t rec = {0};
+    uint32_t t = 0;
+    uint8_t jog = 0;
+    for (int i = 0; i < packets; i++) {
+        int phase = i % 400;
+        if (phase == 0 && i > 0) {
+            t += 1500000;                   // Idle gap: forces VFO re-sync
+        } else {
+            t += 4000 + (phase % 7) * 2000; // 4-16 ms between packets
+        }
+        if (phase < 300) {
+            jog += (phase < 150) ? 1 : 255; // Turn right, then left
+            rec.data[15] = jog;
+        } else if (phase < 380) {
+            rec.data[6] = (uint8_t)((phase - 300) * 3);   // Vol_A sweep
+        } else {
+            rec.data[1] = (phase % 4 < 2) ? 0x04 : 0x00;  // Play_A taps
+        }
+        rec.t_us = t;
+        fwrite(&rec, sizeof(rec), 1, f);
+    }
+    fclose(f);
+    printf("wrote %d packets (%.1f s) to %s\n", packets, t / 1e6, path);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+static int64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s TRACE [--golden FILE | --write-golden FILE] [-v]\n"
+            "       %s TRACE --host H [--port P] [--speed N]\n"
+            "       %s --synth OUT [--packets N]\n", argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL, *golden = NULL, *write_golden = NULL;
+    const char *synth = NULL, *host = NULL;
+    int port = 31001, speed = USB_TRACE_SPEED_MAX, packets = 4000;
+    esp_log_level_t level = ESP_LOG_WARN;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) golden = argv[++i];
+        else if (strcmp(argv[i], "--write-golden") == 0 && i + 1 < argc) write_golden = argv[++i];
+        else if (strcmp(argv[i], "--synth") == 0 && i + 1 < argc) synth = argv[++i];
+        else if (strcmp(argv[i], "--packets") == 0 && i + 1 < argc) packets = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) host = argv[++i];
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speed = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0) level = ESP_LOG_INFO;
+        else if (argv[i][0] != '-' && !trace_path) trace_path = argv[i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    esp_log_level_set("*", level);
+
+    if (synth) return write_synth(synth, packets);
+    if (!trace_path) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t len = 0;
+    uint8_t *image = read_file(trace_path, &len);
+    if (!image || usb_trace_count_records(image, len) < 0) {
+        fprintf(stderr, "%s: not a trace file\n", trace_path);
+        return 1;
+    }
+
+    s_offline = (host == NULL);
+    if (s_offline) {
+        host_clock_set_manual(true);
+        host_clock_set_us(VIRTUAL_BASE_US);
+        speed = USB_TRACE_SPEED_MAX;
+    }
+
+    mapping_engine_init();
+    mapping_engine_set_cat_callback(on_cat_dispatch);
+    usb_dj_host_init(usb_control_cb);
+    dj_led_init();
+    host_usb_set_connected(true);  // LED writes succeed (counted by the stub)
+
+    if (s_offline) {
+        seed_sync();
+    } else {
+        cat_client_config_t cfg = { .port = (uint16_t)port, .state_cb = cat_state_cb,
+                                    .response_cb = mapping_engine_on_cat_response };
+        snprintf(cfg.host, sizeof(cfg.host), "%s", host);
+        cat_client_init(&cfg);
+        for (int i = 0; i < 50 && cat_client_get_state() != CAT_STATE_CONNECTED; i++) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        if (cat_client_get_state() != CAT_STATE_CONNECTED) {
+            fprintf(stderr, "CAT connect to %s:%d failed\n", host, port);
+            return 1;
+        }
+        vTaskDelay(pdMS_TO_TICKS(200));  // Let the sync responses land
+    }
+
+    usb_trace_replay_stats_t stats;
+    int64_t t0 = wall_ns();
+    usb_trace_replay(image, len, speed, packet_hook, NULL, &stats);
+    mapping_engine_flush();
+    int64_t elapsed_ns = wall_ns() - t0;
+    dj_led_flush(2000);
+
+    printf("packets:        %u (%.1f s of trace)\n", (unsigned)stats.packets, stats.trace_us / 1e6);
+    printf("control events: %u\n", (unsigned)s_control_events);
+    printf("CAT commands:   %u\n", (unsigned)s_out_lines);
+    printf("LED transfers:  %u (connect reset + %u requested changes, coalesced, packed)\n",
+           (unsigned)host_usb_out_count(), (unsigned)metrics_get(METRIC_LED_REQUESTS));
+    printf("replay time:    %.1f ms (%.1f ns/packet)\n", elapsed_ns / 1e6,
+           stats.packets ? (double)elapsed_ns / stats.packets : 0.0);
+
+    int rc = 0;
+    if (write_golden) {
+        FILE *f = fopen(write_golden, "w");
+        if (!f) return 1;
+        if (s_out) fputs(s_out, f);
+        fclose(f);
+        printf("wrote golden output to %s\n", write_golden);
+    } else if (golden) {
+        rc = compare_golden(golden);
+    }
+
+    if (!s_offline) cat_client_stop();
+    free(image);
+    free(s_out);
+    return rc;
+}
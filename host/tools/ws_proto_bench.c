@@ -0,0 +1,261 @@
+// Host benchmark: JSON vs. binary encoding of WebSocket live events
+// (ws_proto.c). Reports bytes and ns per event for each event kind, and
+// decodes every binary frame back to JSON to check that both encodings
+// carry the same data, also once the string table is full.
+//
+//   ws_proto_bench [--events N]
+
+#include "ws_proto.h"
+#include "dj_state.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+
+#define KINDS 4
+
+static const char *s_kind_names[KINDS] = {
+    "control (jog)", "cat (VFO set)", "cat_rx (S-meter)", "raw (USB packet)",
+};
+
+static uint8_t s_packet[DJ_STATE_SIZE];
+
+static ws_event_t make_event(int kind, int i)
+{
+    ws_event_t ev = { .kind = kind, .t_ms = 100000 + i };
+    switch (kind) {
+    case WS_EV_CONTROL:
+        ev.control_id = dj_control_find("Jog_A");
+        ev.control_type = DJ_CTRL_ENCODER;
+        ev.old_value = (uint8_t)(i * 3);
+        ev.new_value = (uint8_t)(i * 3 + 3);
+        ev.merged = 3;
+        break;
+    case WS_EV_CAT:
+        ev.control_id = dj_control_find("Jog_A");
+        ev.exec_type = CMD_CAT_FREQ;
+        ev.command_name = "VFO A Tune";
+        snprintf(ev.text, sizeof(ev.text), "ZZFA%011d;", 14074000 + 10 * (i % 100000));
+        break;
+    case WS_EV_CAT_RX:
+        snprintf(ev.cmd, sizeof(ev.cmd), "ZZSM");
+        snprintf(ev.text, sizeof(ev.text), "0%03d", i % 256);
+        break;
+    case WS_EV_RAW:
+        s_packet[0] = (uint8_t)i;
+        ev.raw = s_packet;
+        ev.raw_len = sizeof(s_packet);
+        break;
+    }
+    return ev;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ---------------------------------------------------------------------------
+// Reference decoder (same logic as decodeBinary() in frontend/src/lib/ws.js)
+// ---------------------------------------------------------------------------
+
+static char s_strings[256][64];
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Decode one frame into JSON objects, one per line. Returns records decoded.
+static int decode(const uint8_t *buf, int len, char *out, size_t out_size)
+{
+    int pos = 0, n = 0;
+    size_t o = 0;
+    out[0] = '\0';
+    while (pos < len) {
+        ws_event_t ev = {0};
+        const uint8_t *r = buf + pos;
+        switch (r[0]) {
+        case WS_REC_HELLO:
+            pos += 2;
+            continue;
+        case WS_REC_DEF:
+            memcpy(s_strings[r[1]], r + 3, r[2]);
+            s_strings[r[1]][r[2]] = '\0';
+            pos += 3 + r[2];
+            continue;
+        case WS_REC_CONTROL:
+            ev.kind = WS_EV_CONTROL;
+            ev.control_id = r[1];
+            ev.control_type = r[2];
+            ev.old_value = r[3];
+            ev.new_value = r[4];
+            ev.merged = r[5];
+            ev.t_ms = get_u32(r + 6);
+            pos += 10;
+            break;
+        case WS_REC_CAT_TX:
+            ev.kind = WS_EV_CAT;
+            ev.control_id = r[1];
+            ev.exec_type = r[2];
+            ev.command_name = s_strings[r[3]];
+            ev.t_ms = get_u32(r + 5);
+            snprintf(ev.text, sizeof(ev.text), "%s%.*s;", s_strings[r[4]], r[9], (const char *)r + 10);
+            pos += 10 + r[9];
+            break;
+        case WS_REC_CAT_RX:
+            ev.kind = WS_EV_CAT_RX;
+            snprintf(ev.cmd, sizeof(ev.cmd), "%s", s_strings[r[1]]);
+            ev.t_ms = get_u32(r + 2);
+            snprintf(ev.text, sizeof(ev.text), "%.*s", r[6], (const char *)r + 7);
+            pos += 7 + r[6];
+            break;
+        case WS_REC_CAT_TX_STR: {
+            static char name[64];
+            int nlen = r[7], len = r[8 + nlen];
+            ev.kind = WS_EV_CAT;
+            ev.control_id = r[1];
+            ev.exec_type = r[2];
+            ev.t_ms = get_u32(r + 3);
+            snprintf(name, sizeof(name), "%.*s", nlen, (const char *)r + 8);
+            ev.command_name = name;
+            snprintf(ev.text, sizeof(ev.text), "%.*s;", len, (const char *)r + 9 + nlen);
+            pos += 9 + nlen + len;
+            break;
+        }
+        case WS_REC_CAT_RX_STR: {
+            int plen = r[5], len = r[6 + plen];
+            ev.kind = WS_EV_CAT_RX;
+            ev.t_ms = get_u32(r + 1);
+            snprintf(ev.cmd, sizeof(ev.cmd), "%.*s", plen, (const char *)r + 6);
+            snprintf(ev.text, sizeof(ev.text), "%.*s", len, (const char *)r + 7 + plen);
+            pos += 7 + plen + len;
+            break;
+        }
+        case WS_REC_RAW:
+            ev.kind = WS_EV_RAW;
+            ev.t_ms = get_u32(r + 1);
+            ev.raw = r + 6;
+            ev.raw_len = r[5];
+            pos += 6 + r[5];
+            break;
+        default:
+            fprintf(stderr, "bad record kind 0x%02x at %d\n", r[0], pos);
+            return -1;
+        }
+        o += ws_proto_json(out + o, out_size - o, &ev);
+        o += snprintf(out + o, out_size - o, "\n");
+        n++;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int events = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--events N]\n", argv[0]);
+            return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+    dj_state_reset();
+    ws_proto_init();
+
+    // A new client's hello frames carry the control names
+    uint8_t buf[WS_PROTO_BIN_MAX * 4];
+    int next = 0, hello_bytes = 0, len;
+    char text[4096];
+    while ((len = ws_proto_hello(buf, sizeof(buf), &next)) > 0) {
+        hello_bytes += len;
+        decode(buf, len, text, sizeof(text));
+    }
+    printf("hello: %d bytes (%d control names)\n\n", hello_bytes, dj_state_control_count());
+
+    // Round trip: binary -> decode -> JSON must equal direct JSON
+    int rc = 0;
+    for (int i = 0; i < 1000; i++) {
+        for (int k = 0; k < KINDS; k++) {
+            ws_event_t ev = make_event(k, i);
+            char json[256], expect[256];
+            snprintf(expect, sizeof(expect), "%.*s\n",
+                     ws_proto_json(json, sizeof(json), &ev), json);
+            len = ws_proto_binary(buf, sizeof(buf), &ev);
+            if (decode(buf, len, text, sizeof(text)) != 1 || strcmp(text, expect) != 0) {
+                fprintf(stderr, "MISMATCH\n  json:   %s  binary: %s", expect, text);
+                rc = 1;
+            }
+        }
+    }
+
+    printf("%-18s %10s %10s %10s %10s\n", "event", "json B", "binary B", "json ns", "binary ns");
+    for (int k = 0; k < KINDS; k++) {
+        ws_event_t *evs = malloc(sizeof(ws_event_t) * 1024);
+        for (int i = 0; i < 1024; i++) evs[i] = make_event(k, i);
+
+        char json[256];
+        long json_bytes = 0, bin_bytes = 0;
+        volatile int sink = 0;
+
+        double t0 = now_ns();
+        for (int i = 0; i < events; i++) {
+            int n = ws_proto_json(json, sizeof(json), &evs[i & 1023]);
+            json_bytes += n;
+            sink += json[n - 1];
+        }
+        double json_ns = (now_ns() - t0) / events;
+
+        t0 = now_ns();
+        for (int i = 0; i < events; i++) {
+            int n = ws_proto_binary(buf, sizeof(buf), &evs[i & 1023]);
+            bin_bytes += n;
+            sink += buf[n - 1];
+        }
+        double bin_ns = (now_ns() - t0) / events;
+        (void)sink;
+
+        // +1 for the ',' between array items
+        printf("%-18s %10.1f %10.1f %10.1f %10.1f\n", s_kind_names[k],
+               (double)json_bytes / events + 1, (double)bin_bytes / events, json_ns, bin_ns);
+        free(evs);
+    }
+
+    // Fill the string table with made-up command names: events with new
+    // strings must still round-trip, with the strings inline
+    int inline_before = (int)metrics_get(METRIC_WS_INLINE_STRINGS);
+    for (int i = 0; i < 400; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "Made-up command %d", i);
+        for (int k = WS_EV_CAT; k <= WS_EV_CAT_RX; k++) {
+            ws_event_t ev = make_event(k, i);
+            if (k == WS_EV_CAT) {
+                ev.command_name = name;
+                snprintf(ev.text, sizeof(ev.text), "Z%c%c%c%05d;", 'A' + i % 26, 'A' + i / 26 % 26, 'Q', i);
+            } else {
+                snprintf(ev.cmd, sizeof(ev.cmd), "Y%c%c%c", 'A' + i % 26, 'A' + i / 26 % 26, 'R');
+            }
+            char json[256], expect[256];
+            snprintf(expect, sizeof(expect), "%.*s\n",
+                     ws_proto_json(json, sizeof(json), &ev), json);
+            len = ws_proto_binary(buf, sizeof(buf), &ev);
+            if (decode(buf, len, text, sizeof(text)) != 1 || strcmp(text, expect) != 0) {
+                fprintf(stderr, "MISMATCH (table full)\n  json:   %s  binary: %s", expect, text);
+                rc = 1;
+            }
+        }
+    }
+    int inlined = (int)metrics_get(METRIC_WS_INLINE_STRINGS) - inline_before;
+    printf("\nstring table full: %d of 800 events sent with inline strings, %s\n",
+           inlined, rc ? "FAILED" : "all decoded");
+    if (inlined == 0) rc = 1;
+    return rc;
+}
@@ -0,0 +1,130 @@
+// Host reader for the www asset bundle (main/www_bundle.c, built by
+// scripts/pack_www.py). Validates the image the same way the firmware does,
+// lists it, looks every path up again, and can extract one body.
+//
+//   www_bundle_tool build/www.bin                  # check + list
+//   www_bundle_tool build/www.bin --get /index.html | zcat
+//   www_bundle_tool build/www.bin --get /index.html --plain
+
+#include "www_bundle.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(len > 0 ? len : 1);
+    if (buf && fread(buf, 1, len, f) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *size = len;
+    return buf;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    const char *image_path = NULL;
+    const char *get = NULL;
+    bool plain = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--get") == 0 && i + 1 < argc) {
+            get = argv[++i];
+        } else if (strcmp(argv[i], "--plain") == 0) {
+            plain = true;
+        } else if (argv[i][0] != '-' && !image_path) {
+            image_path = argv[i];
+        } else {
+            image_path = NULL;
+            break;
+        }
+    }
+    if (!image_path) {
+        fprintf(stderr, "usage: %s IMAGE [--get PATH [--plain]]\n", argv[0]);
+        return 2;
+    }
+
+    size_t size;
+    uint8_t *image = read_file(image_path, &size);
+    if (!image) {
+        perror(image_path);
+        return 1;
+    }
+
+    www_bundle_t bundle;
+    esp_err_t err = www_bundle_open(&bundle, image, size);
+    if (err != ESP_OK) {
+        fprintf(stderr, "%s: not a valid bundle (%s)\n", image_path, esp_err_to_name(err));
+        return 1;
+    }
+
+    www_asset_t asset;
+    if (get) {
+        if (!www_bundle_find(&bundle, get, strlen(get), &asset)) {
+            fprintf(stderr, "%s: not in bundle\n", get);
+            return 1;
+        }
+        if (plain) fwrite(asset.plain, 1, asset.plain_len, stdout);
+        else fwrite(asset.body, 1, asset.len, stdout);
+        return 0;
+    }
+
+    // Every entry must be found again by its own path
+    int rc = 0;
+    printf("%d files, %zu bytes\n", bundle.count, bundle.size);
+    for (int i = 0; i < bundle.count; i++) {
+        www_bundle_get(&bundle, i, &asset);
+        www_asset_t found;
+        if (!www_bundle_find(&bundle, asset.path, strlen(asset.path), &found) ||
+            found.body != asset.body) {
+            fprintf(stderr, "lookup failed: %s\n", asset.path);
+            rc = 1;
+        }
+        if (asset.gzip && (asset.len < 2 || asset.body[0] != 0x1f || asset.body[1] != 0x8b)) {
+            fprintf(stderr, "bad gzip body: %s\n", asset.path);
+            rc = 1;
+        }
+        if (asset.gzip ? asset.plain == asset.body || asset.plain_len <= asset.len
+                       : asset.plain != asset.body || asset.plain_len != asset.len) {
+            fprintf(stderr, "bad plain copy: %s\n", asset.path);
+            rc = 1;
+        }
+        printf("  %s %8u %8u  %-24s %s  %s\n", asset.gzip ? "gz" : "  ", (unsigned)asset.len,
+               (unsigned)asset.plain_len, asset.mime, asset.etag, asset.path);
+    }
+    if (www_bundle_find(&bundle, "/no/such/file", 13, &asset)) {
+        fprintf(stderr, "found a path that is not there\n");
+        rc = 1;
+    }
+
+    // Lookup cost, cycling through all paths
+    const int lookups = 1000000;
+    volatile uint32_t sink = 0;
+    double t0 = now_ns();
+    for (int i = 0; i < lookups; i++) {
+        www_bundle_get(&bundle, i % bundle.count, &asset);
+        www_asset_t found;
+        www_bundle_find(&bundle, asset.path, strlen(asset.path), &found);
+        sink += found.len;
+    }
+    (void)sink;
+    printf("lookup: %.1f ns\n", (now_ns() - t0) / lookups);
+
+    free(image);
+    return rc;
+}
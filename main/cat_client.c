@@ -1,5 +1,7 @@
 #include "cat_client.h"
 #include "status_led.h"
+#include "latency.h"
+#include "metrics.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -10,11 +12,13 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdatomic.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 static const char *TAG = "cat";
 
@@ -23,6 +27,13 @@ static const char *TAG = "cat";
 #define RECONNECT_DELAY_MS 3000
 #define CONNECT_TIMEOUT_MS 5000
 #define RECV_TIMEOUT_MS    30000
+#define CAT_TX_QUEUE_DEPTH 128   // Power of two
+#define CAT_TX_BATCH_SIZE  2048  // Max bytes coalesced into one send()
+#define CAT_LATEST_SLOTS   16    // Distinct prefixes with latest-value coalescing
+#define ECHO_SLOTS         16    // Prefixes awaiting a Thetis reply (latency)
+#define ECHO_TIMEOUT_US    2000000LL  // Sets usually get no reply: forget them
+
+_Static_assert(CAT_TX_BATCH_MAX <= CAT_TX_QUEUE_DEPTH / 2, "batch must fit the queue");
 
 // ---------------------------------------------------------------------------
 // State
@@ -32,8 +43,10 @@ static cat_client_config_t s_config;
 static cat_state_t         s_state = CAT_STATE_DISCONNECTED;
 static int                 s_sock = -1;
 static TaskHandle_t        s_task_handle = NULL;
+static TaskHandle_t        s_tx_task_handle = NULL;
 static SemaphoreHandle_t   s_send_mutex = NULL;
 static bool                s_stop_requested = false;
+static bool                s_connected_once = false;   // Later connects are reconnects
 
 // Message accumulator (CAT messages end with ';')
 static char s_msg_buf[CAT_RX_BUF_SIZE];
@@ -45,10 +58,11 @@ static char s_sent_ring[SENT_RING_SIZE][CAT_MAX_CMD_LEN];
 static int  s_sent_ring_head = 0;
 static int  s_sent_ring_count = 0;
 
-static void track_sent(const char *cmd)
+static void track_sent(const char *cmd, int len)
 {
-    strncpy(s_sent_ring[s_sent_ring_head], cmd, CAT_MAX_CMD_LEN - 1);
-    s_sent_ring[s_sent_ring_head][CAT_MAX_CMD_LEN - 1] = '\0';
+    if (len > CAT_MAX_CMD_LEN - 1) len = CAT_MAX_CMD_LEN - 1;
+    memcpy(s_sent_ring[s_sent_ring_head], cmd, len);
+    s_sent_ring[s_sent_ring_head][len] = '\0';
     s_sent_ring_head = (s_sent_ring_head + 1) % SENT_RING_SIZE;
     if (s_sent_ring_count < SENT_RING_SIZE) s_sent_ring_count++;
 }
@@ -62,6 +76,312 @@ static void dump_recent_sent(void)
     }
 }
 
+// ---------------------------------------------------------------------------
+// TX queue: bounded lock-free MPSC ring of pre-formatted commands.
+// Any task may push (cat_client_send never blocks); cat_tx_task is the
+// only consumer. Each cell's sequence number says whose turn it is:
+// seq == pos -> free for the producer claiming pos, seq == pos + 1 ->
+// filled, ready for the consumer.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    atomic_uint seq;
+    uint8_t     len;
+    uint8_t     latest;         // TX_NOT_LATEST, or s_latest[] index (data unused)
+    int64_t     queued_us;      // When the command was queued (latency)
+    char        data[CAT_MAX_CMD_LEN];
+} tx_cell_t;
+
+#define TX_NOT_LATEST 0xFF
+
+static tx_cell_t   s_tx_ring[CAT_TX_QUEUE_DEPTH];
+static atomic_uint s_tx_head;           // Next position producers claim
+static unsigned    s_tx_tail;           // Next position to drain (consumer only)
+
+static atomic_uint s_tx_depth;
+static atomic_uint s_tx_high_water;
+static atomic_uint s_tx_enqueued;
+static atomic_uint s_tx_dropped;
+static atomic_uint s_tx_coalesced;
+static uint32_t    s_tx_batches;        // Written by the consumer only
+static uint32_t    s_tx_bytes;
+
+_Static_assert((CAT_TX_QUEUE_DEPTH & (CAT_TX_QUEUE_DEPTH - 1)) == 0,
+               "CAT_TX_QUEUE_DEPTH must be a power of two");
+
+static void latest_mark(uint8_t index, unsigned pos);
+
+static bool tx_push(const char *cmd, int len, uint8_t latest)
+{
+    unsigned pos = atomic_load_explicit(&s_tx_head, memory_order_relaxed);
+    for (;;) {
+        tx_cell_t *cell = &s_tx_ring[pos & (CAT_TX_QUEUE_DEPTH - 1)];
+        unsigned seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&s_tx_head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                if (cmd) memcpy(cell->data, cmd, len);
+                cell->len = (uint8_t)len;
+                cell->latest = latest;
+                cell->queued_us = esp_timer_get_time();
+                // The marker must be live before the writer can see the cell
+                if (latest != TX_NOT_LATEST) latest_mark(latest, pos);
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                break;
+            }
+            // CAS failure reloaded pos, retry
+        } else if (diff < 0) {
+            return false;   // Full: the consumer has not freed this cell yet
+        } else {
+            pos = atomic_load_explicit(&s_tx_head, memory_order_relaxed);
+        }
+    }
+
+    atomic_fetch_add_explicit(&s_tx_enqueued, 1, memory_order_relaxed);
+    unsigned depth = atomic_fetch_add_explicit(&s_tx_depth, 1, memory_order_relaxed) + 1;
+    unsigned hw = atomic_load_explicit(&s_tx_high_water, memory_order_relaxed);
+    while (depth > hw &&
+           !atomic_compare_exchange_weak_explicit(&s_tx_high_water, &hw, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    return true;
+}
+
+static int format_cmd(const char *cmd, char *buf);
+
+// Reserve count consecutive cells, fill them, then publish last-to-first so
+// the writer (which stops at the first unpublished cell) sees all or none.
+static bool tx_push_batch(const char *const *cmds, int count)
+{
+    unsigned pos = atomic_load_explicit(&s_tx_head, memory_order_relaxed);
+    for (;;) {
+        // Cells are freed in order, so if the last one is free all are
+        tx_cell_t *first = &s_tx_ring[pos & (CAT_TX_QUEUE_DEPTH - 1)];
+        tx_cell_t *last = &s_tx_ring[(pos + count - 1) & (CAT_TX_QUEUE_DEPTH - 1)];
+        int diff_first = (int)(atomic_load_explicit(&first->seq, memory_order_acquire) - pos);
+        int diff_last = (int)(atomic_load_explicit(&last->seq, memory_order_acquire) - (pos + count - 1));
+        if (diff_first == 0 && diff_last == 0) {
+            if (atomic_compare_exchange_weak_explicit(&s_tx_head, &pos, pos + count,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff_first < 0 || diff_last < 0) {
+            return false;   // Not enough free cells
+        } else {
+            pos = atomic_load_explicit(&s_tx_head, memory_order_relaxed);
+        }
+    }
+
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        tx_cell_t *cell = &s_tx_ring[(pos + i) & (CAT_TX_QUEUE_DEPTH - 1)];
+        cell->len = (uint8_t)format_cmd(cmds[i], cell->data);
+        cell->latest = TX_NOT_LATEST;
+        cell->queued_us = now;
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        tx_cell_t *cell = &s_tx_ring[(pos + i) & (CAT_TX_QUEUE_DEPTH - 1)];
+        atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+    }
+
+    atomic_fetch_add_explicit(&s_tx_enqueued, count, memory_order_relaxed);
+    unsigned depth = atomic_fetch_add_explicit(&s_tx_depth, count, memory_order_relaxed) + count;
+    unsigned hw = atomic_load_explicit(&s_tx_high_water, memory_order_relaxed);
+    while (depth > hw &&
+           !atomic_compare_exchange_weak_explicit(&s_tx_high_water, &hw, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Latest-value slots: an absolute set (ZZFA{freq}, ZZAG{level}, ...) that is
+// still waiting to be sent is overwritten in place by the next set with the
+// same prefix, as long as nothing was queued after it. The ring holds a
+// marker for the unsent set; the writer sends whatever value the slot holds
+// when it gets there. Once another command is queued behind the marker, a
+// new set retires the marker (the writer skips it) and queues a fresh one at
+// the tail, so the set never overtakes commands queued before it.
+// Slot data is guarded by a sequence lock (odd = being written).
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    atomic_uint key;            // cat_cmd_key() of the prefix, 0 = free
+    atomic_uint gen;            // Sequence lock
+    atomic_uint marker;         // Ring position + 1 of the live marker, 0 = none
+    uint8_t     len;
+    char        data[CAT_MAX_CMD_LEN];
+} latest_slot_t;
+
+static latest_slot_t s_latest[CAT_LATEST_SLOTS];
+
+static latest_slot_t *latest_slot(uint32_t key, uint8_t *index)
+{
+    for (int i = 0; i < CAT_LATEST_SLOTS; i++) {
+        unsigned k = atomic_load_explicit(&s_latest[i].key, memory_order_acquire);
+        if (k == 0) {
+            // Claim a free slot (or find that another producer just claimed it)
+            unsigned expected = 0;
+            if (!atomic_compare_exchange_strong(&s_latest[i].key, &expected, key) &&
+                expected != key) {
+                continue;
+            }
+            k = key;
+        }
+        if (k == key) {
+            *index = (uint8_t)i;
+            return &s_latest[i];
+        }
+    }
+    return NULL;
+}
+
+static void latest_write(latest_slot_t *slot, const char *cmd, int len)
+{
+    unsigned g = atomic_load_explicit(&slot->gen, memory_order_relaxed);
+    while ((g & 1) || !atomic_compare_exchange_weak_explicit(&slot->gen, &g, g + 1,
+                                                             memory_order_acquire,
+                                                             memory_order_relaxed)) {
+        g = atomic_load_explicit(&slot->gen, memory_order_relaxed);
+    }
+    memcpy(slot->data, cmd, len);
+    slot->len = (uint8_t)len;
+    atomic_store_explicit(&slot->gen, g + 2, memory_order_release);
+}
+
+static int latest_read(latest_slot_t *slot, char *out)
+{
+    int len;
+    unsigned g1, g2;
+    do {
+        g1 = atomic_load_explicit(&slot->gen, memory_order_acquire);
+        len = slot->len;
+        memcpy(out, slot->data, len);
+        atomic_thread_fence(memory_order_acquire);
+        g2 = atomic_load_explicit(&slot->gen, memory_order_relaxed);
+    } while ((g1 & 1) || g1 != g2);
+    return len;
+}
+
+static void latest_mark(uint8_t index, unsigned pos)
+{
+    atomic_store_explicit(&s_latest[index].marker, pos + 1, memory_order_seq_cst);
+}
+
+static void latest_reset(void)
+{
+    for (int i = 0; i < CAT_LATEST_SLOTS; i++) {
+        atomic_store(&s_latest[i].key, 0);
+        atomic_store(&s_latest[i].gen, 0);
+        atomic_store(&s_latest[i].marker, 0);
+    }
+}
+
+static void tx_queue_reset(void)
+{
+    for (unsigned i = 0; i < CAT_TX_QUEUE_DEPTH; i++) {
+        atomic_store_explicit(&s_tx_ring[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store(&s_tx_head, 0);
+    s_tx_tail = 0;
+    atomic_store(&s_tx_depth, 0);
+    latest_reset();
+}
+
+// Append the oldest command to out if it fits in room bytes. Returns its
+// length, -1 if the queue is empty, -2 if it does not fit (left queued).
+static int tx_pop(char *out, int room, int64_t *queued_us)
+{
+    for (;;) {
+        tx_cell_t *cell = &s_tx_ring[s_tx_tail & (CAT_TX_QUEUE_DEPTH - 1)];
+        unsigned seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq != s_tx_tail + 1) return -1;
+        if (room < CAT_MAX_CMD_LEN &&
+            (cell->latest != TX_NOT_LATEST || cell->len > room)) {
+            return -2;
+        }
+
+        int len = -1;
+        if (cell->latest != TX_NOT_LATEST) {
+            // Take the marker first: a set arriving from now on queues a
+            // fresh one. A retired marker (a newer one is live) is skipped.
+            latest_slot_t *slot = &s_latest[cell->latest];
+            unsigned mine = s_tx_tail + 1;
+            if (atomic_compare_exchange_strong_explicit(&slot->marker, &mine, 0,
+                                                        memory_order_seq_cst,
+                                                        memory_order_seq_cst)) {
+                len = latest_read(slot, out);
+            }
+        } else {
+            len = cell->len;
+            memcpy(out, cell->data, len);
+        }
+        *queued_us = cell->queued_us;
+        atomic_store_explicit(&cell->seq, s_tx_tail + CAT_TX_QUEUE_DEPTH, memory_order_release);
+        s_tx_tail++;
+        atomic_fetch_sub_explicit(&s_tx_depth, 1, memory_order_relaxed);
+        if (len >= 0) return len;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Echo tracking: when each prefix last went out, so the reply carrying the
+// same prefix can be timed. Written by the writer task, matched by the
+// receive task.
+// ---------------------------------------------------------------------------
+
+static struct {
+    uint32_t key;               // Prefix as the reply will carry it, 0 = free
+    int64_t  sent_us;
+} s_echo[ECHO_SLOTS];
+static SemaphoreHandle_t s_echo_mutex = NULL;
+
+// Replies carry 4-char ZZ prefixes or 2-char Kenwood ones
+static uint32_t reply_key(const char *cmd)
+{
+    uint32_t key = cat_cmd_key(cmd);
+    return (cmd[0] == 'Z' && cmd[1] == 'Z') ? key : (key & 0xFFFF);
+}
+
+static void echo_sent(const uint32_t *keys, int count, int64_t now)
+{
+    xSemaphoreTake(s_echo_mutex, portMAX_DELAY);
+    for (int i = 0; i < count; i++) {
+        int slot = -1;
+        for (int j = 0; j < ECHO_SLOTS; j++) {
+            if (s_echo[j].key == keys[i]) { slot = j; break; }
+            if (slot < 0 && (s_echo[j].key == 0 ||
+                             now - s_echo[j].sent_us > ECHO_TIMEOUT_US)) {
+                slot = j;
+            }
+        }
+        if (slot < 0) continue;     // All slots awaiting fresh replies
+        s_echo[slot].key = keys[i];
+        s_echo[slot].sent_us = now;
+    }
+    xSemaphoreGive(s_echo_mutex);
+}
+
+static void echo_received(const char *prefix)
+{
+    uint32_t key = cat_cmd_key(prefix);
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_echo_mutex, portMAX_DELAY);
+    for (int j = 0; j < ECHO_SLOTS; j++) {
+        if (s_echo[j].key == key) {
+            if (now - s_echo[j].sent_us <= ECHO_TIMEOUT_US) {
+                latency_record(LATENCY_WIRE_TO_ECHO, now - s_echo[j].sent_us);
+            }
+            s_echo[j].key = 0;
+            break;
+        }
+    }
+    xSemaphoreGive(s_echo_mutex);
+}
+
 // ---------------------------------------------------------------------------
 // Helpers
 // ---------------------------------------------------------------------------
@@ -87,6 +407,7 @@ static void process_cat_message(const char *msg, int len)
     // We receive them without the trailing ';' (stripped by caller)
 
     if (len == 0) return;
+    metrics_inc(METRIC_CAT_RESPONSES);
 
     // Skip welcome/info messages starting with '#'
     if (msg[0] == '#') {
@@ -97,6 +418,7 @@ static void process_cat_message(const char *msg, int len)
     // Error response — dump recent sent commands so we know what caused it
     if (msg[0] == '?' || msg[0] == 'E' || msg[0] == 'O') {
         ESP_LOGW(TAG, "CAT error response: \"%s\"", msg);
+        metrics_inc(METRIC_CAT_ERROR_RESPONSES);
         dump_recent_sent();
         return;
     }
@@ -110,6 +432,7 @@ static void process_cat_message(const char *msg, int len)
         const char *value = (len > 4) ? msg + 4 : "";
 
         ESP_LOGI(TAG, "RX: %s = \"%s\"", cmd, value);
+        echo_received(cmd);
 
         if (s_config.response_cb) {
             s_config.response_cb(cmd, value);
@@ -126,6 +449,7 @@ static void process_cat_message(const char *msg, int len)
         const char *value = (len > 2) ? msg + 2 : "";
 
         ESP_LOGI(TAG, "RX: %s = \"%s\"", cmd, value);
+        echo_received(cmd);
 
         if (s_config.response_cb) {
             s_config.response_cb(cmd, value);
@@ -202,19 +526,85 @@ static esp_err_t tcp_connect(void)
     setsockopt(s_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
     ESP_LOGI(TAG, "CAT TCP connected to %s:%d", s_config.host, s_config.port);
+    if (s_connected_once) metrics_inc(METRIC_CAT_RECONNECTS);
+    s_connected_once = true;
     set_state(CAT_STATE_CONNECTED);
     return ESP_OK;
 }
 
 static void tcp_disconnect(void)
 {
+    // Wait for an in-flight send() (bounded by SO_SNDTIMEO) before closing
+    xSemaphoreTake(s_send_mutex, portMAX_DELAY);
     if (s_sock >= 0) {
         close(s_sock);
         s_sock = -1;
     }
+    xSemaphoreGive(s_send_mutex);
     set_state(CAT_STATE_DISCONNECTED);
 }
 
+// ---------------------------------------------------------------------------
+// TX writer task: drains the queue, one send() per batch
+// ---------------------------------------------------------------------------
+
+static void cat_tx_task(void *arg)
+{
+    static char     batch[CAT_TX_BATCH_SIZE];
+    static int64_t  queued_us[CAT_TX_QUEUE_DEPTH];  // Per command in the batch
+    static uint32_t keys[CAT_TX_QUEUE_DEPTH];
+
+    while (!s_stop_requested) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Coalesce everything pending (up to the batch size) into one buffer
+        int len;
+        do {
+            int n = 0, cmds = 0;
+            while (cmds < CAT_TX_QUEUE_DEPTH &&
+                   (len = tx_pop(batch + n, CAT_TX_BATCH_SIZE - n, &queued_us[cmds])) >= 0) {
+                track_sent(batch + n, len);
+                keys[cmds++] = reply_key(batch + n);
+                n += len;
+            }
+            if (n == 0) break;
+
+            xSemaphoreTake(s_send_mutex, portMAX_DELAY);
+            if (s_sock < 0) {
+                // Connection dropped while queued; stale commands are discarded
+                xSemaphoreGive(s_send_mutex);
+                continue;
+            }
+            ESP_LOGI(TAG, "TX: %.*s", n, batch);
+            int sent = 0;
+            while (sent < n) {
+                int r = send(s_sock, batch + sent, n - sent, 0);
+                if (r < 0) {
+                    ESP_LOGW(TAG, "Send failed: %d", errno);
+                    break;
+                }
+                sent += r;
+            }
+            xSemaphoreGive(s_send_mutex);
+            s_tx_batches++;
+            s_tx_bytes += sent;
+            metrics_add(METRIC_CAT_BYTES_SENT, sent);
+
+            if (sent == n) {
+                metrics_add(METRIC_CAT_CMDS_SENT, cmds);
+                int64_t now = esp_timer_get_time();
+                for (int i = 0; i < cmds; i++) {
+                    latency_record(LATENCY_DISPATCH_TO_WIRE, now - queued_us[i]);
+                }
+                echo_sent(keys, cmds, now);
+            }
+        } while (atomic_load_explicit(&s_tx_depth, memory_order_relaxed) > 0);
+    }
+
+    s_tx_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
 // ---------------------------------------------------------------------------
 // Main CAT client task
 // ---------------------------------------------------------------------------
@@ -256,6 +646,7 @@ static void cat_client_task(void *arg)
             }
 
             rx_buf[n] = '\0';
+            metrics_add(METRIC_CAT_BYTES_RECEIVED, n);
             process_incoming_data(rx_buf, n);
         }
 
@@ -290,8 +681,18 @@ esp_err_t cat_client_init(const cat_client_config_t *config)
 
     s_stop_requested = false;
     s_send_mutex = xSemaphoreCreateMutex();
+    s_echo_mutex = xSemaphoreCreateMutex();
+    memset(s_echo, 0, sizeof(s_echo));
+    tx_queue_reset();
 
     BaseType_t ret = xTaskCreatePinnedToCore(
+        cat_tx_task, "cat_tx", 3072, NULL, 3, &s_tx_task_handle, 1);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create CAT TX task");
+        return ESP_FAIL;
+    }
+
+    ret = xTaskCreatePinnedToCore(
         cat_client_task, "cat_client", 4096, NULL, 3, &s_task_handle, 1);
 
     if (ret != pdPASS) {
@@ -311,16 +712,22 @@ void cat_client_stop(void)
         shutdown(s_sock, SHUT_RDWR);
     }
 
-    if (s_task_handle) {
-        for (int i = 0; i < 50 && s_task_handle != NULL; i++) {
-            vTaskDelay(pdMS_TO_TICKS(100));
-        }
+    if (s_tx_task_handle) {
+        xTaskNotifyGive(s_tx_task_handle);
+    }
+
+    for (int i = 0; i < 50 && (s_task_handle != NULL || s_tx_task_handle != NULL); i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
     }
 
     if (s_send_mutex) {
         vSemaphoreDelete(s_send_mutex);
         s_send_mutex = NULL;
     }
+    if (s_echo_mutex) {
+        vSemaphoreDelete(s_echo_mutex);
+        s_echo_mutex = NULL;
+    }
 
     ESP_LOGI(TAG, "CAT client stopped");
 }
@@ -330,50 +737,113 @@ cat_state_t cat_client_get_state(void)
     return s_state;
 }
 
+// Copy cmd into buf with a trailing ';'. Returns the length.
+static int format_cmd(const char *cmd, char *buf)
+{
+    int len = strlen(cmd);
+    if (len >= CAT_MAX_CMD_LEN - 1) {
+        len = CAT_MAX_CMD_LEN - 2;  // Leave room for ';' + '\0'
+    }
+
+    // Append ';' if missing
+    memcpy(buf, cmd, len);
+    if (len > 0 && cmd[len - 1] != ';') {
+        buf[len++] = ';';
+    }
+    return len;
+}
+
 esp_err_t cat_client_send(const char *cmd)
 {
     if (s_state < CAT_STATE_CONNECTED || s_sock < 0) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    if (xSemaphoreTake(s_send_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
+    char buf[CAT_MAX_CMD_LEN];
+    int len = format_cmd(cmd, buf);
+
+    if (!tx_push(buf, len, TX_NOT_LATEST)) {
+        atomic_fetch_add_explicit(&s_tx_dropped, 1, memory_order_relaxed);
+        ESP_LOGD(TAG, "TX queue full, dropped %.*s", len, buf);  // Counted in stats
+        return ESP_ERR_NO_MEM;
     }
 
-    char buf[CAT_MAX_CMD_LEN];
-    int len = strlen(cmd);
-    if (len >= (int)sizeof(buf) - 1) {
-        len = (int)sizeof(buf) - 2;  // Leave room for ';' + '\0'
+    xTaskNotifyGive(s_tx_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t cat_client_send_latest(const char *cmd)
+{
+    if (s_state < CAT_STATE_CONNECTED || s_sock < 0) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    // Append ';' if missing
-    if (len > 0 && cmd[len - 1] != ';') {
-        memcpy(buf, cmd, len);
-        buf[len] = ';';
-        buf[len + 1] = '\0';
+    uint8_t index;
+    latest_slot_t *slot = latest_slot(cat_cmd_key(cmd), &index);
+    if (!slot) return cat_client_send(cmd);  // Out of slots: send as-is
+
+    char buf[CAT_MAX_CMD_LEN];
+    int len = format_cmd(cmd, buf);
+
+    unsigned marker = atomic_load_explicit(&slot->marker, memory_order_seq_cst);
+    if (marker != 0 && atomic_load_explicit(&s_tx_head, memory_order_seq_cst) == marker) {
+        // The unsent set is still the newest command: replace its value.
+        // If the writer took the marker meanwhile, queue the value again.
+        latest_write(slot, buf, len);
+        if (atomic_load_explicit(&slot->marker, memory_order_seq_cst) == marker) {
+            atomic_fetch_add_explicit(&s_tx_coalesced, 1, memory_order_relaxed);
+            return ESP_OK;
+        }
     } else {
-        memcpy(buf, cmd, len);
-        buf[len] = '\0';
+        // Commands were queued behind the unsent set: retire its marker so
+        // the new value goes out after them, not in the old set's place
+        if (marker != 0 &&
+            atomic_compare_exchange_strong_explicit(&slot->marker, &marker, 0,
+                                                    memory_order_seq_cst,
+                                                    memory_order_seq_cst)) {
+            atomic_fetch_add_explicit(&s_tx_coalesced, 1, memory_order_relaxed);
+        }
+        latest_write(slot, buf, len);
     }
 
-    len = strlen(buf);
-    ESP_LOGI(TAG, "TX: %s", buf);
-    track_sent(buf);
+    if (!tx_push(NULL, 0, index)) {
+        atomic_fetch_add_explicit(&s_tx_dropped, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
 
-    int sent = 0;
-    while (sent < len) {
-        int n = send(s_sock, buf + sent, len - sent, 0);
-        if (n < 0) {
-            xSemaphoreGive(s_send_mutex);
-            return ESP_FAIL;
-        }
-        sent += n;
+    xTaskNotifyGive(s_tx_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t cat_client_send_batch(const char *const *cmds, int count)
+{
+    if (count <= 0) return ESP_OK;
+    if (count > CAT_TX_BATCH_MAX) return ESP_ERR_INVALID_SIZE;
+    if (s_state < CAT_STATE_CONNECTED || s_sock < 0) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    xSemaphoreGive(s_send_mutex);
+    if (!tx_push_batch(cmds, count)) {
+        atomic_fetch_add_explicit(&s_tx_dropped, count, memory_order_relaxed);
+        ESP_LOGD(TAG, "TX queue full, dropped batch of %d", count);  // Counted in stats
+        return ESP_ERR_NO_MEM;
+    }
+
+    xTaskNotifyGive(s_tx_task_handle);
     return ESP_OK;
 }
 
+void cat_client_get_tx_stats(cat_tx_stats_t *stats)
+{
+    stats->depth      = atomic_load_explicit(&s_tx_depth, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&s_tx_high_water, memory_order_relaxed);
+    stats->enqueued   = atomic_load_explicit(&s_tx_enqueued, memory_order_relaxed);
+    stats->dropped    = atomic_load_explicit(&s_tx_dropped, memory_order_relaxed);
+    stats->coalesced  = atomic_load_explicit(&s_tx_coalesced, memory_order_relaxed);
+    stats->batches    = s_tx_batches;
+    stats->bytes      = s_tx_bytes;
+}
+
 // Frequency: 11 digits, zero-padded (e.g., 14074000 -> "00014074000")
 esp_err_t cat_client_set_vfo_a(long freq_hz)
 {
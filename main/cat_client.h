@@ -78,6 +78,19 @@ typedef void (*cat_state_callback_t)(cat_state_t new_state);
  */
 typedef void (*cat_response_callback_t)(const char *cmd, const char *value);
 
+/**
+ * Pack a CAT command prefix (up to 4 chars, e.g. "ZZFA" or "FA") into a
+ * uint32_t for switch/hash dispatch. Stops at NUL or ';'. Returns 0 for "".
+ */
+static inline uint32_t cat_cmd_key(const char *cmd)
+{
+    uint32_t key = 0;
+    for (int i = 0; i < 4 && cmd[i] != '\0' && cmd[i] != ';'; i++) {
+        key |= (uint32_t)(uint8_t)cmd[i] << (8 * i);
+    }
+    return key;
+}
+
 /**
  * CAT client configuration.
  */
@@ -105,11 +118,50 @@ void cat_client_stop(void);
 cat_state_t cat_client_get_state(void);
 
 /**
- * Send a raw CAT command. The trailing ';' is appended if missing.
- * Thread-safe. Response comes via callback.
+ * Queue a raw CAT command. The trailing ';' is appended if missing.
+ * Thread-safe and never blocks: a writer task coalesces queued commands
+ * into one send(). Returns ESP_ERR_NO_MEM if the queue is full (command
+ * dropped). Response comes via callback.
  */
 esp_err_t cat_client_send(const char *cmd);
 
+/**
+ * Queue several commands as one unit: they are written back to back,
+ * normally in a single send() (the writer buffers up to 2 KB), or all
+ * refused if the queue lacks room (ESP_ERR_NO_MEM). At most
+ * CAT_TX_BATCH_MAX commands; ';' is appended to each if missing.
+ */
+#define CAT_TX_BATCH_MAX 48
+
+esp_err_t cat_client_send_batch(const char *const *cmds, int count);
+
+/**
+ * Queue an absolute set command (e.g. "ZZFA00014074000;", "ZZAG050;").
+ * If a set with the same 4-char prefix is still waiting to be sent and
+ * nothing was queued after it, its value is replaced in place. If other
+ * commands were queued after it, the unsent value is discarded and the new
+ * one queued behind them, so a set never overtakes an earlier command (a
+ * band button, a re-sync query). Either way only the latest value reaches
+ * Thetis. Not for buttons, toggles or relative commands
+ * (ZZRU/ZZRD...), which must keep exact counts: use cat_client_send().
+ */
+esp_err_t cat_client_send_latest(const char *cmd);
+
+/**
+ * TX queue counters.
+ */
+typedef struct {
+    uint32_t depth;       // Commands waiting now
+    uint32_t high_water;  // Max depth since boot
+    uint32_t enqueued;    // Commands accepted
+    uint32_t dropped;     // Commands refused (queue full)
+    uint32_t coalesced;   // Sets replaced by a newer value before sending
+    uint32_t batches;     // send() batches written
+    uint32_t bytes;       // Bytes written
+} cat_tx_stats_t;
+
+void cat_client_get_tx_stats(cat_tx_stats_t *stats);
+
 // Convenience functions:
 
 esp_err_t cat_client_set_vfo_a(long freq_hz);
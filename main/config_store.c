@@ -1,4 +1,5 @@
 #include "config_store.h"
+#include "metrics.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -28,6 +29,7 @@ esp_err_t config_set_str(const char *key, const char *value)
     err = nvs_set_str(nvs, key, value);
     if (err == ESP_OK) err = nvs_commit(nvs);
     nvs_close(nvs);
+    if (err == ESP_OK) metrics_inc(METRIC_NVS_WRITES);
 
     if (err == ESP_OK) {
         ESP_LOGI(TAG, "Set %s = %s", key, value);
@@ -55,6 +57,7 @@ esp_err_t config_set_u16(const char *key, uint16_t value)
     err = nvs_set_u16(nvs, key, value);
     if (err == ESP_OK) err = nvs_commit(nvs);
     nvs_close(nvs);
+    if (err == ESP_OK) metrics_inc(METRIC_NVS_WRITES);
     return err;
 }
 
@@ -78,6 +81,49 @@ esp_err_t config_set_u8(const char *key, uint8_t value)
     err = nvs_set_u8(nvs, key, value);
     if (err == ESP_OK) err = nvs_commit(nvs);
     nvs_close(nvs);
+    if (err == ESP_OK) metrics_inc(METRIC_NVS_WRITES);
     return err;
 }
 
+
+esp_err_t config_set_blob(const char *key, const void *data, size_t len)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) return err;
+
+    err = nvs_set_blob(nvs, key, data, len);
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    nvs_close(nvs);
+    if (err == ESP_OK) metrics_inc(METRIC_NVS_WRITES);
+    return err;
+}
+
+char *config_get_blob(const char *key, size_t *out_len)
+{
+    *out_len = 0;
+    nvs_handle_t nvs;
+    if (nvs_open(CONFIG_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return NULL;
+
+    size_t len = 0;
+    esp_err_t err = nvs_get_blob(nvs, key, NULL, &len);
+    if (err != ESP_OK || len == 0) {
+        nvs_close(nvs);
+        return NULL;
+    }
+
+    char *buf = malloc(len + 1);
+    if (!buf) {
+        nvs_close(nvs);
+        return NULL;
+    }
+    err = nvs_get_blob(nvs, key, buf, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        free(buf);
+        return NULL;
+    }
+    buf[len] = '\0';
+    *out_len = len;
+    return buf;
+}
@@ -18,6 +18,7 @@
 #define CFG_KEY_CAT_PORT     "cat_port"
 #define CFG_KEY_DEBUG_LEVEL  "debug_lvl"
 #define CFG_KEY_MAPPINGS     "mappings"
+#define CFG_KEY_WS_TICK_HZ   "ws_tick_hz"
 
 /**
  * Get a string value from NVS. Returns ESP_ERR_NOT_FOUND if key doesn't exist.
@@ -49,3 +50,14 @@ esp_err_t config_get_u8(const char *key, uint8_t *out);
  */
 esp_err_t config_set_u8(const char *key, uint8_t value);
 
+
+/**
+ * Set a binary blob in NVS (e.g. the JSON mapping table).
+ */
+esp_err_t config_set_blob(const char *key, const void *data, size_t len);
+
+/**
+ * Get a blob from NVS. Returns a malloc'd buffer with a trailing NUL (caller
+ * frees) and stores the blob length in out_len, or NULL if not found.
+ */
+char *config_get_blob(const char *key, size_t *out_len);
@@ -1,127 +1,275 @@
 #include "dj_led.h"
+#include "led_anim.h"
 #include "usb_dj_host.h"
+#include "metrics.h"
 
-#include <string.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 static const char *TAG = "dj_led";
 
-static uint8_t s_led_state[LED_NOTE_MAX + 1];
+// ----- Frames -----
+//
+// Two frames of two bitmaps each (dj_led_frame_t): the state callers want,
+// and the state the console was last confirmed to show. Callers (USB
+// callback, mapping engine, HTTP handlers) only edit the desired frame. The
+// led_out task owns the bulk OUT endpoint: once per frame period it diffs
+// the two and sends just the differences, so any number of changes between
+// two frames cost at most the messages for the final state. The device
+// frame only moves when a send succeeded; after a failure the next frame
+// diffs against the old one and sends the same messages again.
 
-// All valid LED notes (skip gaps in the note map)
-static const uint8_t s_valid_notes[] = {
-    1, 2, 3, 4, 5, 6, 7, 8, 10, 11, 14, 15, 16, 18, 19,  // Deck A
-    20, 21, 22, 23, 24, 25, 26, 27, 30, 31, 34, 35, 36, 38, 39,  // Deck B
-    40, 41, 45, 46,  // Global
-};
-#define VALID_NOTE_COUNT (sizeof(s_valid_notes) / sizeof(s_valid_notes[0]))
+#define LED_FRAME_MS    20      // Diff/flush period (50 fps)
+#define LED_RESET_MS    50      // Settle time after the controller reset
 
-static void send_note(uint8_t note, uint8_t velocity)
+#define NOTE_BIT(n)     (1ULL << (n))
+
+static SemaphoreHandle_t s_lock = NULL;     // Guards the frames below
+static dj_led_frame_t   s_want;             // Desired
+static dj_led_frame_t   s_device;           // Last confirmed (written by led_out only)
+static uint64_t         s_bar_mask;         // Notes owned by bar graphs (dj_led_set_bar)
+static uint64_t         s_bar_lit;          // Lit bar segments
+static uint64_t         s_known;            // Notes whose device state is known
+static atomic_bool      s_ready;            // led_out has reset the connected console
+static TaskHandle_t     s_task = NULL;
+static dj_led_frame_cb_t s_frame_cb = NULL;
+
+// ----- Batching -----
+//
+// One frame queues all its messages, then hands them to the transport in a
+// single call; it packs as many as fit into each bulk OUT transfer, so a
+// scene change or all-off costs a few transfers.
+
+#define LED_BATCH_MAX   ((LED_NOTE_MAX + 1) * 2)    // Each layer of every note, once
+
+static uint8_t  s_batch[LED_BATCH_MAX * 3];         // led_out task only
+static int      s_batch_len;                        // Messages queued
+static int      s_fail_streak;                      // Failed sends in a row
+
+static void queue_note(uint8_t note, uint8_t velocity)
+{
+    uint8_t *msg = s_batch + 3 * s_batch_len++;
+    msg[0] = 0x90;
+    msg[1] = note;
+    msg[2] = velocity;
+}
+
+static void queue_notes(uint64_t notes, uint8_t offset, uint8_t velocity)
+{
+    for (; notes; notes &= notes - 1) queue_note(__builtin_ctzll(notes) + offset, velocity);
+}
+
+static esp_err_t send_batch(void)
 {
-    uint8_t pkt[3] = {0x90, note, velocity};
-    esp_err_t err = usb_dj_host_send(pkt, sizeof(pkt));
+    if (s_batch_len == 0) return ESP_OK;
+    esp_err_t err = usb_dj_host_send_msgs(s_batch, s_batch_len);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "LED send note=%d vel=0x%02X: %s",
-                 note, velocity, esp_err_to_name(err));
+        // Retried every frame; only log when it starts failing
+        if (s_fail_streak++ == 0) {
+            ESP_LOGW(TAG, "LED send (%d messages): %s", s_batch_len, esp_err_to_name(err));
+        }
     } else {
-        ESP_LOGI(TAG, "LED note=%d vel=0x%02X OK", note, velocity);
+        if (s_fail_streak) ESP_LOGI(TAG, "LED send OK after %d failures", s_fail_streak);
+        s_fail_streak = 0;
+        ESP_LOGD(TAG, "LED send (%d messages) OK", s_batch_len);
     }
+    s_batch_len = 0;
+    return err;
 }
 
-void dj_led_init(void)
+static void publish_device(const dj_led_frame_t *device, uint64_t known)
 {
-    memset(s_led_state, LED_STATE_OFF, sizeof(s_led_state));
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_device = *device;
+    s_known = known;
+    xSemaphoreGive(s_lock);
+    if (s_frame_cb) s_frame_cb(device);
+}
+
+// Send what turns the device frame into want. Layers going off go first,
+// so a blink -> on change never shows both; notes in an unknown state get
+// both layers written.
+static void render(const dj_led_frame_t *want, const dj_led_frame_t *device, uint64_t known)
+{
+    uint64_t unknown = LED_VALID_MASK & ~known;
+    uint64_t solid_off = (device->solid | unknown) & ~want->solid;
+    uint64_t blink_off = (device->blink | unknown) & ~want->blink;
+    uint64_t solid_on  = want->solid & (~device->solid | unknown);
+    uint64_t blink_on  = want->blink & (~device->blink | unknown);
+    if (!(solid_off | blink_off | solid_on | blink_on)) return;
 
-    // Reset LED controller
-    uint8_t reset_cmd[] = {0xB0, 0x7F, 0x7F};
+    queue_notes(blink_off, LED_BLINK_OFFSET, 0x00);
+    queue_notes(solid_off, 0, 0x00);
+    queue_notes(solid_on, 0, 0x7F);
+    queue_notes(blink_on, LED_BLINK_OFFSET, 0x7F);
+    if (send_batch() == ESP_OK) publish_device(want, LED_VALID_MASK);
+}
+
+// The console was (re)connected: reset its LED controller and clear both
+// layers of every LED. The next frame restores whatever is wanted; if the
+// clear failed, nothing is known and that frame writes every LED.
+static void reset_device(void)
+{
+    const uint8_t reset_cmd[] = {0xB0, 0x7F, 0x7F};
+    const dj_led_frame_t dark = {0, 0};
     usb_dj_host_send(reset_cmd, sizeof(reset_cmd));
-    vTaskDelay(pdMS_TO_TICKS(20));
+    vTaskDelay(pdMS_TO_TICKS(LED_RESET_MS));
+    queue_notes(LED_VALID_MASK, LED_BLINK_OFFSET, 0x00);
+    queue_notes(LED_VALID_MASK, 0, 0x00);
+    bool ok = send_batch() == ESP_OK;
+    publish_device(&dark, ok ? LED_VALID_MASK : 0);
+    ESP_LOGI(TAG, "LED controller reset%s", ok ? "" : " (clear failed, rewriting all)");
+}
 
-    // All off
-    dj_led_all_off();
-    ESP_LOGI(TAG, "LED driver initialized (%d LEDs)", VALID_NOTE_COUNT);
+// The desired frame with the bar graphs on top (caller holds s_lock)
+static dj_led_frame_t wanted(void)
+{
+    dj_led_frame_t want = {
+        .solid = (s_want.solid & ~s_bar_mask) | s_bar_lit,
+        .blink = s_want.blink & ~s_bar_mask,
+    };
+    return want;
 }
 
-void dj_led_set(uint8_t note, bool on)
+static void led_out_task(void *arg)
 {
-    if (note > LED_NOTE_MAX) return;
+    bool connected = false;
+    TickType_t wake = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(LED_FRAME_MS));
 
-    uint8_t old_state = s_led_state[note];
-    uint8_t new_state = on ? LED_STATE_ON : LED_STATE_OFF;
-    if (old_state == new_state) return;
+        // A playing animation replaces the desired frame; its clock runs
+        // (and the queue drains) even with no console
+        dj_led_frame_t anim;
+        bool animating = led_anim_render(esp_timer_get_time(), &anim);
 
-    s_led_state[note] = new_state;
+        bool now = usb_dj_host_is_connected();
+        if (now && !connected) reset_device();
+        if (!now && connected) {
+            const dj_led_frame_t dark = {0, 0};
+            publish_device(&dark, 0);
+        }
+        connected = now;
+        atomic_store(&s_ready, connected);
+        if (!connected) continue;
 
-    // If transitioning from blink, turn off blink note first
-    if (old_state == LED_STATE_BLINK) {
-        send_note(note + LED_BLINK_OFFSET, 0x00);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        dj_led_frame_t want = animating ? anim : wanted();
+        dj_led_frame_t device = s_device;
+        uint64_t known = s_known;
+        xSemaphoreGive(s_lock);
+        render(&want, &device, known);
     }
-
-    send_note(note, on ? 0x7F : 0x00);
 }
 
-void dj_led_blink(uint8_t note, bool blink)
+// Set one note's layers in the desired frame
+static void request(uint8_t note, bool solid, bool blink)
 {
-    if (note > LED_NOTE_MAX) return;
-
-    uint8_t old_state = s_led_state[note];
-    uint8_t new_state = blink ? LED_STATE_BLINK : LED_STATE_OFF;
-    if (old_state == new_state) return;
-
-    s_led_state[note] = new_state;
+    uint64_t bit = NOTE_BIT(note);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool changed = ((s_want.solid & bit) != 0) != solid || ((s_want.blink & bit) != 0) != blink;
+    s_want.solid = solid ? s_want.solid | bit : s_want.solid & ~bit;
+    s_want.blink = blink ? s_want.blink | bit : s_want.blink & ~bit;
+    xSemaphoreGive(s_lock);
+    if (changed) metrics_inc(METRIC_LED_REQUESTS);
+}
 
-    if (blink) {
-        // Turn off solid first, then send blink note
-        send_note(note, 0x00);
-        send_note(note + LED_BLINK_OFFSET, 0x7F);
-    } else {
-        send_note(note + LED_BLINK_OFFSET, 0x00);
-        send_note(note, 0x00);
+void dj_led_init(void)
+{
+    if (s_task) return;
+    s_lock = xSemaphoreCreateMutex();
+    led_anim_init();
+    if (xTaskCreatePinnedToCore(led_out_task, "led_out", 3072, NULL, 3, &s_task, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start LED task");
+        return;
     }
+    ESP_LOGI(TAG, "LED driver initialized (%d LEDs, %d ms frames)",
+             __builtin_popcountll(LED_VALID_MASK), LED_FRAME_MS);
 }
 
-void dj_led_all_off(void)
+void dj_led_set_frame_callback(dj_led_frame_cb_t cb)
 {
-    for (int i = 0; i < (int)VALID_NOTE_COUNT; i++) {
-        uint8_t note = s_valid_notes[i];
-        send_note(note, 0x00);
-        send_note(note + LED_BLINK_OFFSET, 0x00);
-        s_led_state[note] = LED_STATE_OFF;
-    }
+    s_frame_cb = cb;
 }
 
-uint8_t dj_led_get(uint8_t note)
+void dj_led_set(uint8_t note, bool on)
 {
-    if (note > LED_NOTE_MAX) return LED_STATE_OFF;
-    return s_led_state[note];
+    if (note > LED_NOTE_MAX || !s_lock) return;
+    request(note, on, false);
 }
 
-const uint8_t *dj_led_get_all(void)
+void dj_led_blink(uint8_t note, bool blink)
 {
-    return s_led_state;
+    if (note > LED_NOTE_MAX || !s_lock) return;
+    request(note, false, blink);
 }
 
-void dj_led_test(void)
+void dj_led_all_off(void)
 {
-    ESP_LOGI(TAG, "Running LED test sequence...");
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool changed = s_want.solid || s_want.blink;
+    s_want.solid = 0;
+    s_want.blink = 0;
+    xSemaphoreGive(s_lock);
+    if (changed) metrics_inc(METRIC_LED_REQUESTS);
+}
 
-    // Sweep on
-    for (int i = 0; i < (int)VALID_NOTE_COUNT; i++) {
-        send_note(s_valid_notes[i], 0x7F);
-        s_led_state[s_valid_notes[i]] = LED_STATE_ON;
-        vTaskDelay(pdMS_TO_TICKS(30));
+void dj_led_set_bar(uint8_t n1, int segments)
+{
+    if (n1 + 7 > LED_NOTE_MAX || !s_lock) return;
+    uint64_t deck = 0xFFULL << n1;
+    uint64_t lit = segments > 0 ? ((1ULL << (segments > 8 ? 8 : segments)) - 1) << n1 : 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (segments < 0) {
+        s_bar_mask &= ~deck;
+        s_bar_lit &= ~deck;
+    } else {
+        s_bar_mask |= deck;
+        s_bar_lit = (s_bar_lit & ~deck) | lit;
     }
+    xSemaphoreGive(s_lock);
+}
 
-    vTaskDelay(pdMS_TO_TICKS(500));
+uint8_t dj_led_get(uint8_t note)
+{
+    dj_led_frame_t want;
+    dj_led_get_frames(&want, NULL);
+    return dj_led_frame_state(&want, note);
+}
 
-    // Sweep off
-    for (int i = 0; i < (int)VALID_NOTE_COUNT; i++) {
-        send_note(s_valid_notes[i], 0x00);
-        s_led_state[s_valid_notes[i]] = LED_STATE_OFF;
-        vTaskDelay(pdMS_TO_TICKS(30));
+void dj_led_get_frames(dj_led_frame_t *desired, dj_led_frame_t *device)
+{
+    const dj_led_frame_t dark = {0, 0};
+    if (!s_lock) {
+        if (desired) *desired = dark;
+        if (device) *device = dark;
+        return;
     }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (desired) *desired = wanted();
+    if (device) *device = s_device;
+    xSemaphoreGive(s_lock);
+}
 
-    ESP_LOGI(TAG, "LED test complete");
+bool dj_led_flush(uint32_t timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (1) {
+        if (!s_task || !usb_dj_host_is_connected()) return false;
+        if (atomic_load(&s_ready)) {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            dj_led_frame_t want = wanted();
+            bool synced = s_known == LED_VALID_MASK &&
+                          want.solid == s_device.solid && want.blink == s_device.blink;
+            xSemaphoreGive(s_lock);
+            if (synced) return true;
+        }
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) return false;
+        vTaskDelay(1);
+    }
 }
@@ -10,6 +10,15 @@
  *   {0x90, note, velocity}  velocity=0x7F=on, 0x00=off
  *   Notes 48+ = blinking version of (note - 48)
  *   {0xB0, 0x7F, 0x7F} = reset LED controller
+ *
+ * The driver keeps two frames: the desired LED state and the state the
+ * console last confirmed. The set/blink/all-off calls never block: they
+ * only edit the desired frame. The led_out task, the only writer of the
+ * bulk OUT endpoint, diffs the frames every LED frame period (20 ms) and
+ * sends just the differences, and retries them on the next frame if a send
+ * fails. It also resets the controller whenever the console (re)connects.
+ * Bar graphs (led_meter.h) replace the desired state of their LEDs, and
+ * while an animation plays (led_anim.h) its frame is sent instead.
  */
 
 // LED note assignments - Deck A
@@ -53,6 +62,9 @@
 #define LED_AUTOMIX        46
 
 #define LED_NOTE_MAX       46
+
+// Every note above that has an LED (bit n = note n)
+#define LED_VALID_MASK     0x63dccffdcdfeULL
 #define LED_BLINK_OFFSET   48  // note + 48 = blinking version
 
 // LED state values
@@ -61,11 +73,39 @@
 #define LED_STATE_BLINK     2
 
 /**
- * Initialize LED driver. Resets controller and turns all LEDs off.
- * Call after USB device is connected.
+ * A full LED frame: bit n of solid is note n, bit n of blink is note
+ * n + LED_BLINK_OFFSET, for notes 0..LED_NOTE_MAX. The set/blink calls
+ * keep at most one layer lit per note.
+ */
+typedef struct {
+    uint64_t solid;
+    uint64_t blink;
+} dj_led_frame_t;
+
+/** LED_STATE_* of one note in a frame (blink wins if both layers are lit). */
+static inline uint8_t dj_led_frame_state(const dj_led_frame_t *frame, uint8_t note)
+{
+    if (note > LED_NOTE_MAX) return LED_STATE_OFF;
+    if (frame->blink & (1ULL << note)) return LED_STATE_BLINK;
+    if (frame->solid & (1ULL << note)) return LED_STATE_ON;
+    return LED_STATE_OFF;
+}
+
+/** Called from the LED task whenever the confirmed device frame changes. */
+typedef void (*dj_led_frame_cb_t)(const dj_led_frame_t *device);
+
+/**
+ * Start the LED output task. Call once at boot; the controller is reset
+ * when the console connects.
  */
 void dj_led_init(void);
 
+/**
+ * Register a callback for device frame changes (e.g. to show the hardware
+ * state in the web UI). Called from the LED task: keep it short.
+ */
+void dj_led_set_frame_callback(dj_led_frame_cb_t cb);
+
 /**
  * Set an LED on or off.
  * @param note  LED note number (use LED_* defines)
@@ -86,20 +126,28 @@ void dj_led_blink(uint8_t note, bool blink);
 void dj_led_all_off(void);
 
 /**
- * Get current state of an LED.
+ * Show a bar graph on the 8 LEDs from note n1 (LED_N1_A or LED_N1_B): the
+ * first segments (0-8) lit, the rest off, over whatever they would show
+ * otherwise. segments < 0 gives the LEDs back.
+ */
+void dj_led_set_bar(uint8_t n1, int segments);
+
+/**
+ * Get the desired state of an LED.
  * @param note  LED note number
  * @return LED_STATE_OFF, LED_STATE_ON, or LED_STATE_BLINK
  */
 uint8_t dj_led_get(uint8_t note);
 
 /**
- * Get all LED states as an array.
- * @return pointer to internal state array of size LED_NOTE_MAX+1
+ * Copy the desired frame (bar graphs included) and the last confirmed
+ * device frame (either pointer may be NULL). The device frame is dark while no console is
+ * connected.
  */
-const uint8_t *dj_led_get_all(void);
+void dj_led_get_frames(dj_led_frame_t *desired, dj_led_frame_t *device);
 
 /**
- * Run a test sequence: sweep all LEDs on then off.
- * Blocking - takes ~2 seconds.
+ * Wait until the console confirmed the desired frame (host tools).
+ * @return false on timeout, or if there is no task or no console
  */
-void dj_led_test(void);
+bool dj_led_flush(uint32_t timeout_ms);
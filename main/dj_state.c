@@ -0,0 +1,283 @@
+#include "dj_state.h"
+#include "metrics.h"
+
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "dj_state";
+
+// ---------------------------------------------------------------------------
+// Control mapping table (ported from sample.ino)
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const char *name;
+    uint8_t byte_offset;
+    uint8_t byte_mask;
+    dj_control_type_t control_type;
+} control_mapping_t;
+
+static const control_mapping_t s_mappings[] = {
+    // Buttons (type 0) - Deck A
+    { "PitchReset_A",    4, 0x80, DJ_CTRL_BUTTON },
+    { "PitchBendMinus_A",0, 0x02, DJ_CTRL_BUTTON },
+    { "PitchBendPlus_A", 0, 0x04, DJ_CTRL_BUTTON },
+    { "Sync_A",          4, 0x20, DJ_CTRL_BUTTON },
+    { "Shift_A",         0, 0x01, DJ_CTRL_BUTTON },
+    { "Shifted_A",       3, 0x10, DJ_CTRL_BUTTON },
+    { "N1_A",            4, 0x40, DJ_CTRL_BUTTON },
+    { "N2_A",            0, 0x10, DJ_CTRL_BUTTON },
+    { "N3_A",            0, 0x20, DJ_CTRL_BUTTON },
+    { "N4_A",            0, 0x40, DJ_CTRL_BUTTON },
+    { "N5_A",            5, 0x01, DJ_CTRL_BUTTON },
+    { "N6_A",            5, 0x02, DJ_CTRL_BUTTON },
+    { "N7_A",            5, 0x04, DJ_CTRL_BUTTON },
+    { "N8_A",            5, 0x08, DJ_CTRL_BUTTON },
+    { "RWD_A",           0, 0x08, DJ_CTRL_BUTTON },
+    { "FWD_A",           0, 0x80, DJ_CTRL_BUTTON },
+    { "CUE_A",           1, 0x02, DJ_CTRL_BUTTON },
+    { "Play_A",          1, 0x04, DJ_CTRL_BUTTON },
+    { "Listen_A",        1, 0x01, DJ_CTRL_BUTTON },
+    { "Load_A",          1, 0x08, DJ_CTRL_BUTTON },
+
+    // Buttons - Deck B
+    { "PitchReset_B",    4, 0x02, DJ_CTRL_BUTTON },
+    { "PitchBendMinus_B",3, 0x02, DJ_CTRL_BUTTON },
+    { "PitchBendPlus_B", 3, 0x04, DJ_CTRL_BUTTON },
+    { "Sync_B",          4, 0x08, DJ_CTRL_BUTTON },
+    { "Shift_B",         3, 0x01, DJ_CTRL_BUTTON },
+    { "Shifted_B",       3, 0x20, DJ_CTRL_BUTTON },
+    { "N1_B",            4, 0x04, DJ_CTRL_BUTTON },
+    { "N2_B",            2, 0x10, DJ_CTRL_BUTTON },
+    { "N3_B",            2, 0x20, DJ_CTRL_BUTTON },
+    { "N4_B",            2, 0x40, DJ_CTRL_BUTTON },
+    { "N5_B",            5, 0x10, DJ_CTRL_BUTTON },
+    { "N6_B",            5, 0x20, DJ_CTRL_BUTTON },
+    { "N7_B",            5, 0x40, DJ_CTRL_BUTTON },
+    { "N8_B",            5, 0x80, DJ_CTRL_BUTTON },
+    { "RWD_B",           3, 0x08, DJ_CTRL_BUTTON },
+    { "FWD_B",           2, 0x80, DJ_CTRL_BUTTON },
+    { "CUE_B",           2, 0x02, DJ_CTRL_BUTTON },
+    { "Play_B",          2, 0x04, DJ_CTRL_BUTTON },
+    { "Listen_B",        2, 0x01, DJ_CTRL_BUTTON },
+    { "Load_B",          2, 0x08, DJ_CTRL_BUTTON },
+
+    // Global buttons
+    { "Vinyl",           4, 0x10, DJ_CTRL_BUTTON },
+    { "Magic",           4, 0x01, DJ_CTRL_BUTTON },
+    { "Up",              1, 0x10, DJ_CTRL_BUTTON },
+    { "Down",            1, 0x80, DJ_CTRL_BUTTON },
+    { "Folders",         1, 0x20, DJ_CTRL_BUTTON },
+    { "Files",           1, 0x40, DJ_CTRL_BUTTON },
+
+    // Dials and sliders (type 1), range 0x00-0xFF
+    { "Treble_A",        7,  0xFF, DJ_CTRL_DIAL },
+    { "Medium_A",        8,  0xFF, DJ_CTRL_DIAL },
+    { "Bass_A",          9,  0xFF, DJ_CTRL_DIAL },
+    { "Vol_A",           6,  0xFF, DJ_CTRL_DIAL },
+    { "Treble_B",        12, 0xFF, DJ_CTRL_DIAL },
+    { "Medium_B",        13, 0xFF, DJ_CTRL_DIAL },
+    { "Bass_B",          14, 0xFF, DJ_CTRL_DIAL },
+    { "Vol_B",           11, 0xFF, DJ_CTRL_DIAL },
+    { "XFader",          10, 0xFF, DJ_CTRL_DIAL },
+
+    // Jog wheels / rotary encoders (type 2), 0x00-0xFF with wrap-around
+    { "Jog_A",           15, 0xFF, DJ_CTRL_ENCODER },
+    { "Pitch_A",         17, 0xFF, DJ_CTRL_ENCODER },
+    { "Jog_B",           16, 0xFF, DJ_CTRL_ENCODER },
+    { "Pitch_B",         18, 0xFF, DJ_CTRL_ENCODER },
+};
+
+#define NUM_MAPPINGS (sizeof(s_mappings) / sizeof(s_mappings[0]))
+
+_Static_assert(NUM_MAPPINGS == DJ_CONTROL_COUNT, "DJ_CONTROL_COUNT must match the control table");
+_Static_assert(METRIC_CONTROL_DIAL == METRIC_CONTROL_BUTTON + DJ_CTRL_DIAL &&
+               METRIC_CONTROL_ENCODER == METRIC_CONTROL_BUTTON + DJ_CTRL_ENCODER,
+               "control event metrics are indexed by control type");
+
+// ---------------------------------------------------------------------------
+// State buffers
+// ---------------------------------------------------------------------------
+
+// Packets are kept in 64-bit words (38 bytes padded to 40) so the diff can
+// be XORed a word at a time. Padding bytes stay zero.
+#define STATE_WORDS ((DJ_STATE_SIZE + 7) / 8)
+
+static uint64_t s_current_words[STATE_WORDS];
+static uint64_t s_old_words[STATE_WORDS];
+static uint8_t *const s_current_state = (uint8_t *)s_current_words;
+static uint8_t *const s_old_state = (uint8_t *)s_old_words;
+static dj_control_callback_t s_callback = NULL;
+
+// ---------------------------------------------------------------------------
+// Byte offset -> controls index (built once from s_mappings)
+// ---------------------------------------------------------------------------
+
+// Controls at byte offset o: s_offset_ctrls[s_offset_start[o] .. s_offset_start[o+1])
+static uint8_t  s_offset_start[DJ_STATE_SIZE + 1];
+static uint8_t  s_offset_ctrls[NUM_MAPPINGS];
+// Per word: 0xFF in every byte lane that at least one control reads
+static uint64_t s_word_mask[STATE_WORDS];
+static bool     s_index_built = false;
+
+_Static_assert(NUM_MAPPINGS <= 64, "changed-control set is a 64-bit mask");
+
+static void build_offset_index(void)
+{
+    uint8_t counts[DJ_STATE_SIZE] = {0};
+    for (int i = 0; i < NUM_MAPPINGS; i++) {
+        counts[s_mappings[i].byte_offset]++;
+    }
+
+    s_offset_start[0] = 0;
+    for (int o = 0; o < DJ_STATE_SIZE; o++) {
+        s_offset_start[o + 1] = s_offset_start[o] + counts[o];
+    }
+
+    // Fill in table order so each offset's list stays sorted by index
+    uint8_t fill[DJ_STATE_SIZE];
+    memcpy(fill, s_offset_start, DJ_STATE_SIZE);
+    memset(s_word_mask, 0, sizeof(s_word_mask));
+    for (int i = 0; i < NUM_MAPPINGS; i++) {
+        uint8_t o = s_mappings[i].byte_offset;
+        s_offset_ctrls[fill[o]++] = i;
+        s_word_mask[o / 8] |= (uint64_t)0xFF << ((o % 8) * 8);
+    }
+    s_index_built = true;
+}
+
+// ---------------------------------------------------------------------------
+// State diffing
+// ---------------------------------------------------------------------------
+
+static void emit_change(int i)
+{
+    const control_mapping_t *m = &s_mappings[i];
+
+    uint8_t old_val = s_old_state[m->byte_offset] & m->byte_mask;
+    uint8_t new_val = s_current_state[m->byte_offset] & m->byte_mask;
+
+    // Buttons: normalize to 0/1
+    if (m->control_type == DJ_CTRL_BUTTON) {
+        old_val = old_val > 0 ? 1 : 0;
+        new_val = new_val > 0 ? 1 : 0;
+    }
+
+    if (new_val != old_val) {
+        ESP_LOGD(TAG, "Control: %s %d -> %d", m->name, old_val, new_val);
+        metrics_inc(METRIC_CONTROL_BUTTON + m->control_type);
+
+        if (s_callback) {
+            s_callback(i, m->control_type, old_val, new_val);
+        }
+    }
+}
+
+/**
+ * Sparse decoder: XOR the packets word by word, visit only the changed
+ * bytes, and only the controls whose mask overlaps the changed bits.
+ * Callbacks fire in table order, same as the full scan below.
+ */
+static void process_state_update(void)
+{
+    uint64_t changed = 0;   // Bit i set: control i may have changed
+
+    for (int w = 0; w < STATE_WORDS; w++) {
+        uint64_t diff = (s_current_words[w] ^ s_old_words[w]) & s_word_mask[w];
+        while (diff) {
+            // Both targets (Xtensa LX7, x86-64) are little-endian:
+            // byte lane k of the word is byte offset w*8 + k
+            int lane = __builtin_ctzll(diff) / 8;
+            int o = w * 8 + lane;
+            uint8_t bits = (uint8_t)(diff >> (lane * 8));
+            diff &= ~((uint64_t)0xFF << (lane * 8));
+
+            for (int k = s_offset_start[o]; k < s_offset_start[o + 1]; k++) {
+                uint8_t i = s_offset_ctrls[k];
+                if (s_mappings[i].byte_mask & bits) changed |= (uint64_t)1 << i;
+            }
+        }
+    }
+
+    // Identical packets (or changes only in unmapped bytes) end here
+    if (!changed) return;
+
+    while (changed) {
+        int i = __builtin_ctzll(changed);
+        changed &= changed - 1;
+        emit_change(i);
+    }
+
+    memcpy(s_old_words, s_current_words, sizeof(s_old_words));
+}
+
+// Reference decoder (ported from sample.ino on_state_update): checks every
+// control on every packet. Kept for benchmarks and cross-checking.
+static void process_state_update_full(void)
+{
+    for (int i = 0; i < NUM_MAPPINGS; i++) {
+        emit_change(i);
+    }
+
+    memcpy(s_old_words, s_current_words, sizeof(s_old_words));
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+void dj_state_set_callback(dj_control_callback_t callback)
+{
+    s_callback = callback;
+}
+
+void dj_state_reset(void)
+{
+    memset(s_current_words, 0, sizeof(s_current_words));
+    memset(s_old_words, 0, sizeof(s_old_words));
+    if (!s_index_built) build_offset_index();
+}
+
+void dj_state_process(const uint8_t *packet)
+{
+    if (!s_index_built) build_offset_index();
+    memcpy(s_current_state, packet, DJ_STATE_SIZE);
+    process_state_update();
+}
+
+void dj_state_process_full(const uint8_t *packet)
+{
+    memcpy(s_current_state, packet, DJ_STATE_SIZE);
+    process_state_update_full();
+}
+
+const uint8_t *dj_state_get(void)
+{
+    return s_current_state;
+}
+
+int dj_state_control_count(void)
+{
+    return NUM_MAPPINGS;
+}
+
+const char *dj_control_name(uint8_t control_id)
+{
+    if (control_id >= NUM_MAPPINGS) return "?";
+    return s_mappings[control_id].name;
+}
+
+dj_control_type_t dj_control_type(uint8_t control_id)
+{
+    if (control_id >= NUM_MAPPINGS) return DJ_CTRL_BUTTON;
+    return s_mappings[control_id].control_type;
+}
+
+uint8_t dj_control_find(const char *name)
+{
+    if (!name) return DJ_CONTROL_NONE;
+    for (int i = 0; i < NUM_MAPPINGS; i++) {
+        if (strcmp(s_mappings[i].name, name) == 0) return i;
+    }
+    return DJ_CONTROL_NONE;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * DJ console state decoder.
+ *
+ * Owns the control table (byte offset + mask per control, ported from
+ * sample.ino) and the previous/current copies of the 38-byte bulk IN
+ * packet. Each packet fed to dj_state_process() is diffed against the
+ * previous one and a callback fires for every control whose value changed.
+ *
+ * Has no USB or FreeRTOS dependencies so it can be driven by the USB host
+ * driver on the device, or by a trace replay / benchmark on a host build.
+ */
+
+#define DJ_STATE_SIZE   38
+
+/**
+ * Controls are identified by a dense integer ID: their index in the control
+ * table. Mapping, LED and per-control state are arrays indexed by it; names
+ * are only needed at the UI / JSON boundary (dj_control_name / dj_control_find).
+ */
+#define DJ_CONTROL_COUNT 59
+#define DJ_CONTROL_NONE  0xFF
+
+/**
+ * Control types matching the original Teensy driver.
+ */
+typedef enum {
+    DJ_CTRL_BUTTON = 0,   // On/off, bitmask yields 0 or 1
+    DJ_CTRL_DIAL   = 1,   // Continuous 0x00-0xFF (sliders, knobs)
+    DJ_CTRL_ENCODER = 2,  // Rotary encoder 0x00-0xFF with wrap-around (jog wheels)
+} dj_control_type_t;
+
+/**
+ * Callback fired when a DJ console control changes state.
+ *
+ * @param control_id    Control ID, 0..DJ_CONTROL_COUNT-1 (see dj_control_name())
+ * @param control_type  Button, dial, or encoder
+ * @param old_value     Previous value
+ * @param new_value     New value
+ */
+typedef void (*dj_control_callback_t)(
+    uint8_t control_id,
+    dj_control_type_t control_type,
+    uint8_t old_value,
+    uint8_t new_value);
+
+/**
+ * Set the callback fired for each changed control (may be NULL).
+ */
+void dj_state_set_callback(dj_control_callback_t callback);
+
+/**
+ * Clear both state buffers (call when a device (re)connects).
+ */
+void dj_state_reset(void);
+
+/**
+ * Feed one raw packet (at least DJ_STATE_SIZE bytes). Diffs it against the
+ * previous packet and fires the control callback for each change.
+ */
+void dj_state_process(const uint8_t *packet);
+
+/**
+ * Same as dj_state_process() but checks every control in the table instead
+ * of only those at changed byte offsets. Reference for benchmarks.
+ */
+void dj_state_process_full(const uint8_t *packet);
+
+/**
+ * Get a pointer to the most recent 38-byte state (read-only).
+ */
+const uint8_t *dj_state_get(void);
+
+/**
+ * Number of controls in the control table (DJ_CONTROL_COUNT).
+ */
+int dj_state_control_count(void);
+
+/**
+ * Control name for an ID (e.g., "Play_A", "Jog_A"), or "?" if out of range.
+ */
+const char *dj_control_name(uint8_t control_id);
+
+/**
+ * Control type for an ID (DJ_CTRL_BUTTON if out of range).
+ */
+dj_control_type_t dj_control_type(uint8_t control_id);
+
+/**
+ * Look up a control ID by name (JSON / REST boundary, linear scan).
+ * Returns DJ_CONTROL_NONE if the name is unknown.
+ */
+uint8_t dj_control_find(const char *name);
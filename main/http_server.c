@@ -1,9 +1,8 @@
 #include <string.h>
 #include <unistd.h>
-#include <sys/stat.h>
+#include <stdatomic.h>
 #include "esp_log.h"
 #include "esp_http_server.h"
-#include "esp_spiffs.h"
 #include "cJSON.h"
 
 #include "http_server.h"
@@ -12,84 +11,701 @@
 #include "cat_client.h"
 #include "usb_dj_host.h"
 #include "usb_debug.h"
+#include "usb_trace.h"
 #include "wifi_manager.h"
 #include "dj_led.h"
+#include "led_anim.h"
+#include "led_meter.h"
+#include "latency.h"
+#include "metrics.h"
+#include "ws_proto.h"
+#include "www_bundle.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "http_srv";
 
 static httpd_handle_t s_server = NULL;
 
-// ----- WebSocket client tracking -----
+// ----- WebSocket client tracking and send queues -----
+//
+// Producers (USB, mapping engine, CAT, tick tasks) never touch the network:
+// ws_send_json()/ws_send_fds() build one refcounted frame and appends it to each
+// client's bounded queue, then schedules ws_drain_work() on the httpd task,
+// which does the actual sends. Telemetry frames (batches, latency) are
+// droppable; status, learned and LED messages must be delivered.
+//
+// A client whose queue fills up is a slow consumer: its queued telemetry
+// is discarded, and before anything else it is sent a "resync" snapshot
+// (status + LED states) so it can catch up without the backlog.
+
+#define MAX_WS_CLIENTS        4
+#define WS_CLIENT_QUEUE       16        // Frames per client
+#define WS_CLIENT_QUEUE_BYTES 16384     // Bytes per client
+
+// Topics a client can subscribe to ({"type":"subscribe",...}). Until it
+// does, a client gets everything except raw. Learn, latency and resync
+// messages are not topics and always go out.
+typedef enum {
+    WS_TOPIC_CONTROL = 0,
+    WS_TOPIC_CAT_TX,
+    WS_TOPIC_CAT_RX,
+    WS_TOPIC_STATUS,
+    WS_TOPIC_LED,
+    WS_TOPIC_RAW,
+    WS_TOPIC_COUNT,
+} ws_topic_t;
+
+#define TOPIC_BIT(t)       (1u << (t))
+#define WS_TOPICS_DEFAULT  (TOPIC_BIT(WS_TOPIC_COUNT) - 1 - TOPIC_BIT(WS_TOPIC_RAW))
+#define WS_MAX_PREFIXES    8
+
+static const char *const s_topic_names[WS_TOPIC_COUNT] = {
+    "control", "cat_tx", "cat_rx", "status", "led", "raw",
+};
+
+// What one client wants; clients with equal filters share encoded batches
+typedef struct {
+    uint8_t  topics;                        // TOPIC_BIT() mask
+    uint8_t  n_prefix;
+    uint8_t  n_exclude;
+    uint32_t prefix[WS_MAX_PREFIXES];       // cat_rx: only these (cat_cmd_key)
+    uint32_t exclude[WS_MAX_PREFIXES];      // cat_rx: never these
+    uint16_t min_ms[WS_TOPIC_COUNT];        // Rate cap per batched topic, 0 = none
+} ws_filter_t;
+
+typedef struct {
+    atomic_int refs;
+    bool       binary;
+    bool       droppable;
+    size_t     len;
+    uint8_t    data[];
+} ws_frame_t;
+
+typedef struct {
+    int         fd;
+    bool        binary;             // Connected with /ws?bin=1
+    bool        drain_queued;       // ws_drain_work() scheduled or running
+    bool        hello_pending;      // Binary: send the string table before the next frame
+    bool        resync_pending;     // Send a snapshot before the next frame
+    bool        closing;            // Close requested, queue nothing more
+    ws_filter_t filter;
+    uint32_t    topic_last_ms[WS_TOPIC_COUNT];   // Last batch that carried the topic
+    ws_frame_t *queue[WS_CLIENT_QUEUE];
+    uint8_t     head;
+    uint8_t     len;
+    size_t      bytes;
+    uint32_t    sent;
+    uint32_t    dropped;
+    uint32_t    resyncs;
+} ws_client_t;
+
+static ws_client_t       s_clients[MAX_WS_CLIENTS];
+static int               s_ws_count = 0;
+static int               s_ws_binary_count = 0;
+static SemaphoreHandle_t s_ws_lock = NULL;     // Guards s_clients
+static volatile uint8_t  s_topic_mask = 0;     // Union of all clients' topics
+
+// Recompute s_topic_mask. Caller holds s_ws_lock.
+static void update_topic_mask(void)
+{
+    uint8_t mask = 0;
+    for (int i = 0; i < s_ws_count; i++) mask |= s_clients[i].filter.topics;
+    s_topic_mask = mask;
+}
 
-#define MAX_WS_CLIENTS 4
+static bool topic_wanted(ws_topic_t t)
+{
+    return s_topic_mask & TOPIC_BIT(t);
+}
 
-static int s_ws_fds[MAX_WS_CLIENTS];
-static int s_ws_count = 0;
+static void frame_release(ws_frame_t *f)
+{
+    if (atomic_fetch_sub(&f->refs, 1) == 1) free(f);
+}
 
-static void ws_add_client(int fd)
+static ws_client_t *find_client(int fd)
 {
     for (int i = 0; i < s_ws_count; i++) {
-        if (s_ws_fds[i] == fd) return;
+        if (s_clients[i].fd == fd) return &s_clients[i];
     }
-    if (s_ws_count < MAX_WS_CLIENTS) {
-        s_ws_fds[s_ws_count++] = fd;
-        ESP_LOGI(TAG, "WS client connected (fd=%d, total=%d)", fd, s_ws_count);
+    return NULL;
+}
+
+static void client_drop(ws_client_t *c)
+{
+    c->dropped++;
+    metrics_inc(METRIC_WS_FRAMES_DROPPED);
+}
+
+// Discard queued telemetry, keep must-deliver frames in order
+static void client_drop_droppable(ws_client_t *c)
+{
+    int kept = 0;
+    for (int k = 0; k < c->len; k++) {
+        ws_frame_t *f = c->queue[(c->head + k) % WS_CLIENT_QUEUE];
+        if (f->droppable) {
+            c->bytes -= f->len;
+            client_drop(c);
+            frame_release(f);
+        } else {
+            c->queue[(c->head + kept) % WS_CLIENT_QUEUE] = f;
+            kept++;
+        }
     }
+    c->len = kept;
 }
 
-static void ws_remove_client(int fd)
+static void client_clear(ws_client_t *c)
 {
-    for (int i = 0; i < s_ws_count; i++) {
-        if (s_ws_fds[i] == fd) {
-            s_ws_fds[i] = s_ws_fds[--s_ws_count];
-            ESP_LOGI(TAG, "WS client disconnected (fd=%d, total=%d)", fd, s_ws_count);
-            return;
+    for (int k = 0; k < c->len; k++) {
+        frame_release(c->queue[(c->head + k) % WS_CLIENT_QUEUE]);
+    }
+    c->len = 0;
+    c->bytes = 0;
+}
+
+static void ws_drain_work(void *arg);
+
+// A binary client is registered before its hello goes out, and the hello
+// is built when its queue drains: every string interned before that is in
+// the hello, every later one is in a batch queued to this client.
+static void ws_add_client(int fd, bool binary)
+{
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    if (!find_client(fd) && s_ws_count < MAX_WS_CLIENTS) {
+        s_clients[s_ws_count] = (ws_client_t){
+            .fd = fd, .binary = binary, .hello_pending = binary,
+            .filter.topics = WS_TOPICS_DEFAULT,
+        };
+        if (binary) {
+            s_ws_binary_count++;
+            s_clients[s_ws_count].drain_queued =
+                httpd_queue_work(s_server, ws_drain_work, (void *)(intptr_t)fd) == ESP_OK;
         }
+        s_ws_count++;
+        update_topic_mask();
+        ESP_LOGI(TAG, "WS client connected (fd=%d, %s, total=%d)",
+                 fd, binary ? "binary" : "json", s_ws_count);
     }
+    xSemaphoreGive(s_ws_lock);
 }
 
-void http_server_ws_broadcast(const char *json)
+static void ws_remove_client(int fd)
 {
-    if (!s_server || s_ws_count == 0) return;
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    ws_client_t *c = find_client(fd);
+    if (c) {
+        client_clear(c);
+        if (c->binary) s_ws_binary_count--;
+        *c = s_clients[--s_ws_count];
+        update_topic_mask();
+        ESP_LOGI(TAG, "WS client disconnected (fd=%d, total=%d)", fd, s_ws_count);
+    }
+    xSemaphoreGive(s_ws_lock);
+}
 
-    httpd_ws_frame_t pkt = {
-        .type = HTTPD_WS_TYPE_TEXT,
-        .payload = (uint8_t *)json,
-        .len = strlen(json),
-    };
+static int format_resync(char *buf, size_t size, uint32_t dropped);
+static esp_err_t ws_send_hello(int fd);
 
-    for (int i = 0; i < s_ws_count; ) {
-        esp_err_t ret = httpd_ws_send_frame_async(s_server, s_ws_fds[i], &pkt);
-        if (ret != ESP_OK) {
-            ESP_LOGW(TAG, "WS send failed fd=%d: %s, removing", s_ws_fds[i], esp_err_to_name(ret));
-            ws_remove_client(s_ws_fds[i]);
+// Runs on the httpd task: send everything queued for one client
+static void ws_drain_work(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    while (1) {
+        xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+        ws_client_t *c = find_client(fd);
+        if (!c) {
+            xSemaphoreGive(s_ws_lock);
+            return;
+        }
+
+        httpd_ws_frame_t pkt = { .type = HTTPD_WS_TYPE_TEXT };
+        ws_frame_t *f = NULL;
+        bool hello = c->hello_pending;
+        bool resync = !hello && c->resync_pending;
+        uint32_t dropped = c->dropped;
+        if (hello) {
+            c->hello_pending = false;
+        } else if (resync) {
+            c->resync_pending = false;
+        } else if (c->len > 0) {
+            f = c->queue[c->head];
+            c->head = (c->head + 1) % WS_CLIENT_QUEUE;
+            c->len--;
+            c->bytes -= f->len;
+            pkt.type = f->binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+            pkt.payload = f->data;
+            pkt.len = f->len;
         } else {
-            i++;
+            c->drain_queued = false;
+            xSemaphoreGive(s_ws_lock);
+            return;
+        }
+        xSemaphoreGive(s_ws_lock);
+
+        char snapshot[640];
+        if (resync) {
+            pkt.payload = (uint8_t *)snapshot;
+            pkt.len = format_resync(snapshot, sizeof(snapshot), dropped);
+        }
+        esp_err_t ret = hello ? ws_send_hello(fd) : httpd_ws_send_frame_async(s_server, fd, &pkt);
+        if (f) frame_release(f);
+
+        xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+        c = find_client(fd);
+        if (c && ret == ESP_OK) {
+            c->sent++;
+            metrics_inc(METRIC_WS_FRAMES_SENT);
+        } else if (c) {
+            client_drop(c);
+        }
+        xSemaphoreGive(s_ws_lock);
+
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "WS send failed fd=%d: %s, closing", fd, esp_err_to_name(ret));
+            httpd_sess_trigger_close(s_server, fd);   // on_sock_close frees the queue
+            return;
+        }
+    }
+}
+
+// Append a frame to one client's queue. Caller holds s_ws_lock.
+static void client_enqueue(ws_client_t *c, ws_frame_t *f)
+{
+    bool full = c->len >= WS_CLIENT_QUEUE || c->bytes + f->len > WS_CLIENT_QUEUE_BYTES;
+    if (full || (f->droppable && c->resync_pending)) {
+        if (f->droppable) {
+            // Slow consumer: drop the backlog and resync instead. The dropped
+            // batches may have carried DEF records: a binary client gets the
+            // whole string table again first.
+            if (!c->resync_pending) {
+                c->resync_pending = true;
+                c->hello_pending = c->binary;
+                c->resyncs++;
+                ESP_LOGW(TAG, "WS client fd=%d is slow, resyncing", c->fd);
+            }
+            client_drop_droppable(c);
+            client_drop(c);
+            return;
+        }
+        client_drop_droppable(c);
+        if (c->len >= WS_CLIENT_QUEUE || c->bytes + f->len > WS_CLIENT_QUEUE_BYTES) {
+            // Only must-deliver frames queued and still no room: give up on it
+            ESP_LOGW(TAG, "WS client fd=%d not reading, closing", c->fd);
+            client_drop(c);
+            c->closing = true;
+            httpd_sess_trigger_close(s_server, c->fd);
+            return;
         }
     }
+
+    atomic_fetch_add(&f->refs, 1);
+    c->queue[(c->head + c->len) % WS_CLIENT_QUEUE] = f;
+    c->len++;
+    c->bytes += f->len;
+
+    if (!c->drain_queued &&
+        httpd_queue_work(s_server, ws_drain_work, (void *)(intptr_t)c->fd) == ESP_OK) {
+        c->drain_queued = true;
+    }
+}
+
+static ws_frame_t *frame_new(const void *data, size_t len, bool binary, bool droppable)
+{
+    ws_frame_t *f = malloc(sizeof(ws_frame_t) + len);
+    if (!f) return NULL;
+    atomic_init(&f->refs, 1);     // Held until every client has its own ref
+    f->binary = binary;
+    f->droppable = droppable;
+    f->len = len;
+    memcpy(f->data, data, len);
+    return f;
+}
+
+// JSON message for every client, or only those subscribed to topic (>= 0)
+static void ws_send_json(const char *json, int topic, bool droppable)
+{
+    if (!s_server || s_ws_count == 0 || !s_ws_lock) return;
+
+    ws_frame_t *f = frame_new(json, strlen(json), false, droppable);
+    if (!f) return;
+
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    for (int i = 0; i < s_ws_count; i++) {
+        ws_client_t *c = &s_clients[i];
+        if (c->closing) continue;
+        if (topic >= 0 && !(c->filter.topics & TOPIC_BIT(topic))) continue;
+        client_enqueue(c, f);
+    }
+    xSemaphoreGive(s_ws_lock);
+    frame_release(f);
 }
 
-// ----- Notification helpers -----
+// Batch frame for the clients listed in fds (same encoding and filter)
+static void ws_send_fds(const void *data, size_t len, bool binary, const int *fds, int n)
+{
+    ws_frame_t *f = frame_new(data, len, binary, true);
+    if (!f) return;
+
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    for (int k = 0; k < n; k++) {
+        ws_client_t *c = find_client(fds[k]);
+        if (c && !c->closing) client_enqueue(c, f);
+    }
+    xSemaphoreGive(s_ws_lock);
+    frame_release(f);
+}
+
+// Learned messages go to every client as JSON and are never dropped for a
+// slow client
+void http_server_ws_broadcast(const char *json)
+{
+    ws_send_json(json, -1, false);
+}
+
+// ----- WebSocket event batching -----
+//
+// Control, CAT, CAT reply and raw USB events are not sent as they happen:
+// producers (USB task, mapping engine, CAT task) append a small record to
+// the current batch, and ws_tick_task sends the whole batch as one frame per
+// client every 1/s_tick_hz seconds: a JSON array, or binary records
+// (ws_proto.h) for clients that connected with /ws?bin=1. A dial or encoder
+// that moves several times within one tick keeps a single entry (first old
+// value, latest new value); raw keeps only the latest packet. Nothing is
+// recorded for a topic no client subscribes to. Rare messages (status,
+// learned, led, latency) are still sent immediately as single objects.
+
+#define WS_TICK_HZ_DEFAULT 25
+#define WS_TICK_HZ_MIN     10
+#define WS_TICK_HZ_MAX     50
+#define WS_BATCH_MAX       64      // Events per tick; the tick runs early at 3/4
+#define WS_FRAME_MAX       4096    // Larger batches are split over several frames
+
+static SemaphoreHandle_t s_batch_lock = NULL;
+static TaskHandle_t      s_tick_task = NULL;
+static ws_event_t        s_batch[WS_BATCH_MAX];
+static int               s_batch_len = 0;
+static uint8_t           s_batch_slot[DJ_CONTROL_COUNT];  // Index + 1 of the control's entry, 0 = none
+static uint8_t           s_raw[DJ_STATE_SIZE];            // Latest raw packet this tick
+static uint32_t          s_raw_ms = 0;
+static bool              s_raw_pending = false;
+static volatile uint8_t  s_tick_hz = WS_TICK_HZ_DEFAULT;
+
+// Counters for /api/status
+static uint32_t s_batch_frames = 0;
+static uint32_t s_batch_events = 0;
+static uint32_t s_batch_merged = 0;
+static uint32_t s_batch_overflow = 0;
+static uint32_t s_batch_json_bytes = 0;
+static uint32_t s_batch_bin_bytes = 0;
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// Append an event, or return the existing entry of a dial/encoder. NULL if
+// the batch is full. Caller holds s_batch_lock.
+static ws_event_t *batch_slot(ws_event_kind_t kind, uint8_t control_id, bool latest_only)
+{
+    if (latest_only && s_batch_slot[control_id]) {
+        s_batch_merged++;
+        return &s_batch[s_batch_slot[control_id] - 1];
+    }
+    if (s_batch_len >= WS_BATCH_MAX) {
+        s_batch_overflow++;
+        return NULL;
+    }
+    ws_event_t *ev = &s_batch[s_batch_len++];
+    memset(ev, 0, sizeof(*ev));
+    ev->kind = kind;
+    ev->control_id = control_id;
+    ev->t_ms = now_ms();
+    if (latest_only) s_batch_slot[control_id] = s_batch_len;
+    if (s_batch_len == WS_BATCH_MAX * 3 / 4 && s_tick_task) xTaskNotifyGive(s_tick_task);
+    return ev;
+}
 
 void http_server_notify_control(
-    const char *name,
+    uint8_t control_id,
     dj_control_type_t control_type,
     uint8_t old_value,
     uint8_t new_value)
 {
-    if (s_ws_count == 0) return;
+    if (!topic_wanted(WS_TOPIC_CONTROL) || !s_batch_lock || control_id >= DJ_CONTROL_COUNT) return;
+
+    bool latest_only = control_type != DJ_CTRL_BUTTON;
+    xSemaphoreTake(s_batch_lock, portMAX_DELAY);
+    ws_event_t *ev = batch_slot(WS_EV_CONTROL, control_id, latest_only);
+    if (ev) {
+        if (ev->merged == 0) ev->old_value = old_value;
+        ev->control_type = control_type;
+        ev->new_value = new_value;
+        ev->merged++;
+    }
+    xSemaphoreGive(s_batch_lock);
+}
 
-    char buf[128];
-    snprintf(buf, sizeof(buf),
-        "{\"type\":\"control\",\"name\":\"%s\",\"ctrl\":%d,\"old\":%d,\"new\":%d}",
-        name, (int)control_type, old_value, new_value);
-    http_server_ws_broadcast(buf);
+void http_server_notify_raw(const uint8_t *data, int length)
+{
+    if (!topic_wanted(WS_TOPIC_RAW) || !s_batch_lock || length <= 0) return;
+    if (length > DJ_STATE_SIZE) length = DJ_STATE_SIZE;
+
+    xSemaphoreTake(s_batch_lock, portMAX_DELAY);
+    memcpy(s_raw, data, length);
+    s_raw_ms = now_ms();
+    s_raw_pending = true;
+    xSemaphoreGive(s_batch_lock);
 }
 
-void http_server_notify_status(void)
+static void batch_add_cat(uint8_t control_id, const char *command_name,
+                          cmd_exec_type_t exec_type, const char *cat_string)
 {
-    if (s_ws_count == 0) return;
+    if (!topic_wanted(WS_TOPIC_CAT_TX) || !s_batch_lock) return;
+
+    xSemaphoreTake(s_batch_lock, portMAX_DELAY);
+    ws_event_t *ev = batch_slot(WS_EV_CAT, control_id, false);
+    if (ev) {
+        ev->exec_type = exec_type;
+        ev->command_name = command_name;
+        snprintf(ev->text, sizeof(ev->text), "%s", cat_string);
+    }
+    xSemaphoreGive(s_batch_lock);
+}
+
+static ws_topic_t event_topic(const ws_event_t *ev)
+{
+    switch (ev->kind) {
+    case WS_EV_CONTROL: return WS_TOPIC_CONTROL;
+    case WS_EV_CAT:     return WS_TOPIC_CAT_TX;
+    case WS_EV_CAT_RX:  return WS_TOPIC_CAT_RX;
+    default:            return WS_TOPIC_RAW;
+    }
+}
+
+static bool key_in(uint32_t key, const uint32_t *keys, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (keys[i] == key) return true;
+    }
+    return false;
+}
+
+static bool cat_rx_passes(const ws_filter_t *f, uint32_t key)
+{
+    if (f->n_prefix && !key_in(key, f->prefix, f->n_prefix)) return false;
+    return !key_in(key, f->exclude, f->n_exclude);
+}
+
+// Does any client want this reply? Skips the S-meter polls nobody shows.
+static bool cat_rx_wanted(const char *cmd)
+{
+    if (!topic_wanted(WS_TOPIC_CAT_RX)) return false;
+    uint32_t key = cat_cmd_key(cmd);
+    bool wanted = false;
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    for (int i = 0; i < s_ws_count && !wanted; i++) {
+        const ws_filter_t *f = &s_clients[i].filter;
+        wanted = (f->topics & TOPIC_BIT(WS_TOPIC_CAT_RX)) && cat_rx_passes(f, key);
+    }
+    xSemaphoreGive(s_ws_lock);
+    return wanted;
+}
+
+// One client's view of this tick's batch (same view = same frames)
+typedef struct {
+    int         fds[MAX_WS_CLIENTS];
+    int         n_fds;
+    bool        binary;
+    uint8_t     topics;         // After rate caps
+    ws_filter_t filter;
+} ws_view_t;
+
+static bool event_in_view(const ws_event_t *ev, const ws_view_t *v)
+{
+    ws_topic_t t = event_topic(ev);
+    if (!(v->topics & TOPIC_BIT(t))) return false;
+    return t != WS_TOPIC_CAT_RX || cat_rx_passes(&v->filter, cat_cmd_key(ev->cmd));
+}
+
+static void flush_json(const ws_event_t *events, int n, const ws_view_t *v)
+{
+    static char frame[WS_FRAME_MAX];
+    int len = 0;
+    for (int i = 0; i <= n; i++) {
+        char item[256];
+        int item_len = 0;
+        if (i < n) {
+            if (!event_in_view(&events[i], v)) continue;
+            item_len = ws_proto_json(item, sizeof(item), &events[i]);
+            if (item_len <= 0 || item_len >= (int)sizeof(item)) continue;
+        }
+
+        // Close the current frame at the end or if this item would not fit (+ ",]\0")
+        if (len > 0 && (i == n || len + item_len + 3 > WS_FRAME_MAX)) {
+            frame[len++] = ']';
+            ws_send_fds(frame, len, false, v->fds, v->n_fds);
+            s_batch_frames++;
+            s_batch_json_bytes += len;
+            len = 0;
+        }
+        if (i == n) break;
+        frame[len] = len == 0 ? '[' : ',';
+        len++;
+        memcpy(frame + len, item, item_len);
+        len += item_len;
+    }
+}
 
+// defs: DEF records for strings first used in this batch; every binary
+// client gets them, even if its filter leaves no events
+static void flush_binary(const ws_event_t *events, int n, const ws_view_t *v,
+                         const uint8_t *defs, int defs_len)
+{
+    static uint8_t frame[WS_FRAME_MAX];
+    memcpy(frame, defs, defs_len);
+    int len = defs_len;
+    for (int i = 0; i < n; i++) {
+        if (!event_in_view(&events[i], v)) continue;
+        if (WS_FRAME_MAX - len < WS_PROTO_BIN_MAX) {
+            ws_send_fds(frame, len, true, v->fds, v->n_fds);
+            s_batch_frames++;
+            s_batch_bin_bytes += len;
+            len = 0;
+        }
+        len += ws_proto_binary(frame + len, WS_FRAME_MAX - len, &events[i]);
+    }
+    if (len > 0) {
+        ws_send_fds(frame, len, true, v->fds, v->n_fds);
+        s_batch_frames++;
+        s_batch_bin_bytes += len;
+    }
+}
+
+static bool filter_equal(const ws_filter_t *a, const ws_filter_t *b)
+{
+    return a->topics == b->topics && a->n_prefix == b->n_prefix && a->n_exclude == b->n_exclude &&
+           memcmp(a->prefix, b->prefix, a->n_prefix * sizeof(uint32_t)) == 0 &&
+           memcmp(a->exclude, b->exclude, a->n_exclude * sizeof(uint32_t)) == 0;
+}
+
+// Group clients by encoding and effective filter, applying rate caps
+static int build_views(ws_view_t *views, uint8_t batch_topics)
+{
+    uint32_t now = now_ms();
+    int n_views = 0;
+
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    for (int i = 0; i < s_ws_count; i++) {
+        ws_client_t *c = &s_clients[i];
+        if (c->closing) continue;
+
+        uint8_t topics = c->filter.topics & batch_topics;
+        for (int t = 0; t < WS_TOPIC_COUNT; t++) {
+            if (!(topics & TOPIC_BIT(t)) || !c->filter.min_ms[t]) continue;
+            if (now - c->topic_last_ms[t] < c->filter.min_ms[t]) {
+                topics &= ~TOPIC_BIT(t);    // Capped: skip this tick's events
+            } else {
+                c->topic_last_ms[t] = now;
+            }
+        }
+        if (!topics && !c->binary) continue;
+
+        ws_view_t *v = NULL;
+        for (int k = 0; k < n_views; k++) {
+            if (views[k].binary == c->binary && views[k].topics == topics &&
+                filter_equal(&views[k].filter, &c->filter)) {
+                v = &views[k];
+                break;
+            }
+        }
+        if (!v) {
+            v = &views[n_views++];
+            v->n_fds = 0;
+            v->binary = c->binary;
+            v->topics = topics;
+            v->filter = c->filter;
+        }
+        v->fds[v->n_fds++] = c->fd;
+    }
+    xSemaphoreGive(s_ws_lock);
+    return n_views;
+}
+
+// Send one batch to each group of clients; runs on the tick task only
+static void batch_flush(void)
+{
+    static ws_event_t events[WS_BATCH_MAX + 1];
+    static uint8_t raw[DJ_STATE_SIZE];
+    static uint8_t defs[WS_FRAME_MAX / 2];
+
+    xSemaphoreTake(s_batch_lock, portMAX_DELAY);
+    int n = s_batch_len;
+    memcpy(events, s_batch, n * sizeof(ws_event_t));
+    s_batch_len = 0;
+    memset(s_batch_slot, 0, sizeof(s_batch_slot));
+    if (s_raw_pending) {
+        memcpy(raw, s_raw, sizeof(raw));
+        events[n++] = (ws_event_t){
+            .kind = WS_EV_RAW, .t_ms = s_raw_ms, .raw = raw, .raw_len = sizeof(raw),
+        };
+        s_raw_pending = false;
+    }
+    xSemaphoreGive(s_batch_lock);
+
+    if (n == 0 || s_ws_count == 0) return;
+
+    uint8_t batch_topics = 0;
+    for (int i = 0; i < n; i++) {
+        batch_topics |= TOPIC_BIT(event_topic(&events[i]));
+    }
+
+    ws_view_t views[MAX_WS_CLIENTS];
+    int n_views = build_views(views, batch_topics);
+
+    // Every view must get an event's DEF records before the event itself:
+    // when the DEF buffer fills, send the events so far to every view and
+    // intern the rest in a new round
+    for (int start = 0, end; start < n; start = end) {
+        int defs_len = 0;
+        for (end = start; end < n; end++) {
+            if (s_ws_binary_count == 0) continue;
+            if ((int)sizeof(defs) - defs_len < WS_PROTO_BIN_MAX) break;
+            defs_len += ws_proto_defs(defs + defs_len, sizeof(defs) - defs_len, &events[end]);
+        }
+        for (int k = 0; k < n_views; k++) {
+            if (views[k].binary) {
+                flush_binary(events + start, end - start, &views[k], defs, defs_len);
+            } else {
+                flush_json(events + start, end - start, &views[k]);
+            }
+        }
+    }
+    s_batch_events += n;
+}
+
+static void ws_tick_task(void *arg)
+{
+    while (1) {
+        // Woken early when the batch is 3/4 full
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000 / s_tick_hz));
+        batch_flush();
+    }
+}
+
+void http_server_set_ws_tick_hz(uint8_t hz)
+{
+    if (hz < WS_TICK_HZ_MIN) hz = WS_TICK_HZ_MIN;
+    if (hz > WS_TICK_HZ_MAX) hz = WS_TICK_HZ_MAX;
+    s_tick_hz = hz;
+}
+
+static int format_status(char *buf, size_t size)
+{
     const char *cat_str = "disconnected";
     cat_state_t cs = cat_client_get_state();
     switch (cs) {
@@ -99,68 +715,182 @@ void http_server_notify_status(void)
     default: break;
     }
 
-    char buf[192];
-    snprintf(buf, sizeof(buf),
+    return snprintf(buf, size,
         "{\"type\":\"status\",\"usb\":%s,\"cat\":\"%s\",\"heap\":%lu}",
         usb_dj_host_is_connected() ? "true" : "false",
         cat_str,
         esp_get_free_heap_size());
-    http_server_ws_broadcast(buf);
 }
 
-void http_server_notify_cat_rx(const char *cmd, const char *value)
+void http_server_notify_status(void)
 {
-    if (s_ws_count == 0) return;
+    if (!topic_wanted(WS_TOPIC_STATUS)) return;
 
     char buf[192];
-    snprintf(buf, sizeof(buf),
-        "{\"type\":\"cat_rx\",\"cmd\":\"%s\",\"value\":\"%s\"}",
-        cmd, value ? value : "");
-    http_server_ws_broadcast(buf);
+    format_status(buf, sizeof(buf));
+    ws_send_json(buf, WS_TOPIC_STATUS, false);
 }
 
-// ----- Learn mode callback (fires when a control is learned) -----
+// Notes lit in a layer, as a JSON list: "[1,15]"
+static int format_notes(char *buf, size_t size, uint64_t notes)
+{
+    int len = snprintf(buf, size, "[");
+    for (; notes && len < (int)size - 4; notes &= notes - 1) {
+        len += snprintf(buf + len, size - len, "%s%d", len > 1 ? "," : "", __builtin_ctzll(notes));
+    }
+    return len + snprintf(buf + len, len < (int)size ? size - len : 0, "]");
+}
 
-static void on_learn_complete(const char *control_name, uint16_t command_id, const char *command_name)
+void http_server_notify_leds(const dj_led_frame_t *device)
 {
-    char buf[256];
-    snprintf(buf, sizeof(buf),
-        "{\"type\":\"learned\",\"control\":\"%s\",\"command_id\":%d,\"command_name\":\"%s\"}",
-        control_name, command_id, command_name);
-    http_server_ws_broadcast(buf);
+    if (!topic_wanted(WS_TOPIC_LED)) return;
+
+    char buf[320];
+    int len = snprintf(buf, sizeof(buf), "{\"type\":\"leds\",\"on\":");
+    len += format_notes(buf + len, sizeof(buf) - len, device->solid & ~device->blink);
+    len += snprintf(buf + len, sizeof(buf) - len, ",\"blink\":");
+    len += format_notes(buf + len, sizeof(buf) - len, device->blink);
+    snprintf(buf + len, sizeof(buf) - len, "}");
+    ws_send_json(buf, WS_TOPIC_LED, false);
 }
 
-// ----- CAT dispatch callback (fires when a mapped command sends CAT) -----
+// Snapshot for a slow client that skipped telemetry:
+// {"type":"resync","dropped":N,"status":{...},"leds":[[note,state],...]}
+static int format_resync(char *buf, size_t size, uint32_t dropped)
+{
+    int len = snprintf(buf, size, "{\"type\":\"resync\",\"dropped\":%lu,\"status\":",
+                       (unsigned long)dropped);
+    len += format_status(buf + len, size - len);
+    len += snprintf(buf + len, size - len, ",\"leds\":[");
+
+    dj_led_frame_t want;
+    dj_led_get_frames(&want, NULL);
+    bool first = true;
+    for (int note = 0; note <= LED_NOTE_MAX && len < (int)size - 16; note++) {
+        uint8_t state = dj_led_frame_state(&want, note);
+        if (state == LED_STATE_OFF) continue;
+        len += snprintf(buf + len, size - len, "%s[%d,%d]", first ? "" : ",", note, state);
+        first = false;
+    }
+    len += snprintf(buf + len, size - len, "]}");
+    return len < (int)size ? len : (int)size - 1;
+}
 
-static const char *exec_type_str(cmd_exec_type_t t)
+void http_server_notify_cat_rx(const char *cmd, const char *value)
 {
-    switch (t) {
-    case CMD_CAT_BUTTON: return "BTN";
-    case CMD_CAT_TOGGLE: return "TOG";
-    case CMD_CAT_SET:    return "SET";
-    case CMD_CAT_FREQ:   return "FRQ";
-    case CMD_CAT_WHEEL:        return "WHL";
-    case CMD_CAT_FILTER_WIDTH: return "FLW";
-    default:                   return "?";
+    if (!s_batch_lock || !cat_rx_wanted(cmd)) return;
+
+    xSemaphoreTake(s_batch_lock, portMAX_DELAY);
+    ws_event_t *ev = batch_slot(WS_EV_CAT_RX, 0, false);
+    if (ev) {
+        snprintf(ev->cmd, sizeof(ev->cmd), "%s", cmd);
+        snprintf(ev->text, sizeof(ev->text), "%s", value ? value : "");
     }
+    xSemaphoreGive(s_batch_lock);
 }
 
-static void on_cat_dispatch(const char *control_name, const char *command_name,
-                            cmd_exec_type_t exec_type, const char *cat_string)
+// ----- Topic subscriptions -----
+
+static int parse_prefixes(const cJSON *arr, uint32_t *keys)
+{
+    int n = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, arr) {
+        if (n < WS_MAX_PREFIXES && cJSON_IsString(item) && item->valuestring[0]) {
+            keys[n++] = cat_cmd_key(item->valuestring);
+        }
+    }
+    return n;
+}
+
+// {"type":"subscribe","topics":["cat_rx",...],"cat_rx_prefixes":["ZZFA"],
+//  "cat_rx_exclude":["ZZSM"],"rates":{"cat_rx":5}}
+// Replaces the client's filter. Rates are max batches per second carrying
+// the topic; only the batched topics (control, cat_tx, cat_rx, raw) are capped.
+static void ws_subscribe(int fd, const cJSON *msg)
+{
+    ws_filter_t f = {0};
+    const cJSON *item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(msg, "topics")) {
+        for (int t = 0; t < WS_TOPIC_COUNT; t++) {
+            if (cJSON_IsString(item) && strcmp(item->valuestring, s_topic_names[t]) == 0) {
+                f.topics |= TOPIC_BIT(t);
+            }
+        }
+    }
+    f.n_prefix = parse_prefixes(cJSON_GetObjectItem(msg, "cat_rx_prefixes"), f.prefix);
+    f.n_exclude = parse_prefixes(cJSON_GetObjectItem(msg, "cat_rx_exclude"), f.exclude);
+    cJSON *rates = cJSON_GetObjectItem(msg, "rates");
+    for (int t = 0; t < WS_TOPIC_COUNT; t++) {
+        cJSON *hz = cJSON_GetObjectItem(rates, s_topic_names[t]);
+        if (cJSON_IsNumber(hz) && hz->valuedouble > 0) {
+            double ms = 1000.0 / hz->valuedouble;
+            f.min_ms[t] = ms > UINT16_MAX ? UINT16_MAX : (uint16_t)ms;
+        }
+    }
+
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    ws_client_t *c = find_client(fd);
+    if (c) {
+        c->filter = f;
+        memset(c->topic_last_ms, 0, sizeof(c->topic_last_ms));
+        update_topic_mask();
+    }
+    xSemaphoreGive(s_ws_lock);
+    ESP_LOGD(TAG, "WS fd=%d topics=0x%02x", fd, f.topics);
+}
+
+// ----- Learn mode callback (fires when a control is learned) -----
+
+static void on_learn_complete(uint8_t control_id, uint16_t command_id, const char *command_name)
 {
     char buf[256];
     snprintf(buf, sizeof(buf),
-        "{\"type\":\"cat\",\"control\":\"%s\",\"cmd\":\"%s\",\"exec\":\"%s\",\"cat\":\"%s\"}",
-        control_name, command_name, exec_type_str(exec_type), cat_string);
+        "{\"type\":\"learned\",\"control\":\"%s\",\"command_id\":%d,\"command_name\":\"%s\"}",
+        dj_control_name(control_id), command_id, command_name);
     http_server_ws_broadcast(buf);
 }
 
+// ----- CAT dispatch callback (fires when a mapped command sends CAT) -----
+
+static void on_cat_dispatch(uint8_t control_id, const char *command_name,
+                            cmd_exec_type_t exec_type, const char *cat_string)
+{
+    batch_add_cat(control_id, command_name, exec_type, cat_string);
+}
+
 // ----- WebSocket handler -----
 
+// String table for a binary client (ws_proto.h), sent by ws_drain_work()
+// ahead of any batch
+static esp_err_t ws_send_hello(int fd)
+{
+    uint8_t buf[1024];
+    int next = 0;
+    int len;
+    while ((len = ws_proto_hello(buf, sizeof(buf), &next)) > 0) {
+        httpd_ws_frame_t pkt = {
+            .type = HTTPD_WS_TYPE_BINARY,
+            .payload = buf,
+            .len = len,
+        };
+        esp_err_t ret = httpd_ws_send_frame_async(s_server, fd, &pkt);
+        if (ret != ESP_OK) return ret;
+    }
+    return ESP_OK;
+}
+
 static esp_err_t ws_handler(httpd_req_t *req)
 {
     if (req->method == HTTP_GET) {
-        ws_add_client(httpd_req_to_sockfd(req));
+        // Binary telemetry is opt-in: /ws?bin=1
+        char query[16];
+        char bin[4];
+        bool binary = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                      httpd_query_key_value(query, "bin", bin, sizeof(bin)) == ESP_OK &&
+                      strcmp(bin, "1") == 0;
+        int fd = httpd_req_to_sockfd(req);
+        ws_add_client(fd, binary);
         http_server_notify_status();
         return ESP_OK;
     }
@@ -191,6 +921,10 @@ static esp_err_t ws_handler(httpd_req_t *req)
                         }
                     } else if (strcmp(type->valuestring, "learn_cancel") == 0) {
                         mapping_engine_cancel_learn();
+                    } else if (strcmp(type->valuestring, "subscribe") == 0) {
+                        ws_subscribe(httpd_req_to_sockfd(req), msg);
+                    } else if (strcmp(type->valuestring, "latency_reset") == 0) {
+                        latency_reset();
                     } else if (strcmp(type->valuestring, "led_set") == 0) {
                         cJSON *note_j = cJSON_GetObjectItem(msg, "note");
                         cJSON *state_j = cJSON_GetObjectItem(msg, "state");
@@ -202,14 +936,20 @@ static esp_err_t ws_handler(httpd_req_t *req)
                             else if (strcmp(st, "blink") == 0) dj_led_blink(note, true);
                             char ws_buf[64];
                             snprintf(ws_buf, sizeof(ws_buf), "{\"type\":\"led\",\"note\":%d,\"state\":\"%s\"}", note, st);
-                            http_server_ws_broadcast(ws_buf);
+                            ws_send_json(ws_buf, WS_TOPIC_LED, false);
                         }
                     } else if (strcmp(type->valuestring, "led_all_off") == 0) {
                         dj_led_all_off();
-                        http_server_ws_broadcast("{\"type\":\"led_all_off\"}");
+                        ws_send_json("{\"type\":\"led_all_off\"}", WS_TOPIC_LED, false);
                     } else if (strcmp(type->valuestring, "led_test") == 0) {
-                        dj_led_test();
-                        http_server_ws_broadcast("{\"type\":\"led_all_off\"}");
+                        led_anim_start(LED_ANIM_TEST);
+                    } else if (strcmp(type->valuestring, "led_anim") == 0) {
+                        cJSON *anim = cJSON_GetObjectItem(msg, "anim");
+                        if (anim && cJSON_IsString(anim)) {
+                            int id = led_anim_find(anim->valuestring);
+                            if (id >= 0) led_anim_start(id);
+                            else if (strcmp(anim->valuestring, "stop") == 0) led_anim_stop();
+                        }
                     }
                 }
                 cJSON_Delete(msg);
@@ -237,6 +977,35 @@ static esp_err_t api_status_get_handler(httpd_req_t *req)
     cJSON_AddStringToObject(root, "cat_state",
         (cs >= 0 && cs <= CAT_STATE_ERROR) ? cat_states[cs] : "unknown");
 
+    cat_tx_stats_t tx;
+    cat_client_get_tx_stats(&tx);
+    cJSON *cat_tx = cJSON_AddObjectToObject(root, "cat_tx");
+    cJSON_AddNumberToObject(cat_tx, "depth", tx.depth);
+    cJSON_AddNumberToObject(cat_tx, "high_water", tx.high_water);
+    cJSON_AddNumberToObject(cat_tx, "dropped", tx.dropped);
+    cJSON_AddNumberToObject(cat_tx, "coalesced", tx.coalesced);
+    cJSON_AddNumberToObject(cat_tx, "batches", tx.batches);
+
+    mapping_queue_stats_t eq;
+    mapping_engine_get_queue_stats(&eq);
+    cJSON *engine = cJSON_AddObjectToObject(root, "engine_queue");
+    cJSON_AddNumberToObject(engine, "depth", eq.depth);
+    cJSON_AddNumberToObject(engine, "high_water", eq.high_water);
+    cJSON_AddNumberToObject(engine, "dropped", eq.dropped);
+    cJSON_AddNumberToObject(engine, "coalesced", eq.coalesced);
+    cJSON_AddNumberToObject(engine, "latency_avg_us", eq.latency_avg_us);
+    cJSON_AddNumberToObject(engine, "latency_max_us", eq.latency_max_us);
+
+    cJSON *ws = cJSON_AddObjectToObject(root, "ws_batch");
+    cJSON_AddNumberToObject(ws, "tick_hz", s_tick_hz);
+    cJSON_AddNumberToObject(ws, "frames", s_batch_frames);
+    cJSON_AddNumberToObject(ws, "events", s_batch_events);
+    cJSON_AddNumberToObject(ws, "merged", s_batch_merged);
+    cJSON_AddNumberToObject(ws, "overflow", s_batch_overflow);
+    cJSON_AddNumberToObject(ws, "json_bytes", s_batch_json_bytes);
+    cJSON_AddNumberToObject(ws, "binary_bytes", s_batch_bin_bytes);
+    cJSON_AddNumberToObject(ws, "binary_clients", s_ws_binary_count);
+
     // WiFi
     cJSON_AddBoolToObject(root, "wifi_connected", wifi_manager_is_connected());
     cJSON_AddBoolToObject(root, "ap_mode", wifi_manager_is_ap_mode());
@@ -284,6 +1053,9 @@ static esp_err_t api_config_get_handler(httpd_req_t *req)
     config_get_u8(CFG_KEY_DEBUG_LEVEL, &dbg);
     cJSON_AddNumberToObject(root, "debug_level", dbg);
 
+    // WebSocket batch rate
+    cJSON_AddNumberToObject(root, "ws_tick_hz", s_tick_hz);
+
     char *json = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
 
@@ -365,6 +1137,14 @@ static esp_err_t api_config_put_handler(httpd_req_t *req)
         usb_debug_set_level(lvl);
     }
 
+    // WebSocket batch rate (applied on the next tick)
+    item = cJSON_GetObjectItem(root, "ws_tick_hz");
+    if (item && cJSON_IsNumber(item)) {
+        int hz = item->valueint;
+        http_server_set_ws_tick_hz(hz > 255 ? 255 : hz < 0 ? 0 : (uint8_t)hz);
+        config_set_u8(CFG_KEY_WS_TICK_HZ, s_tick_hz);
+    }
+
     cJSON_Delete(root);
 
     // Response
@@ -393,8 +1173,15 @@ static esp_err_t api_config_put_handler(httpd_req_t *req)
 }
 
 // ----- REST API: GET /api/commands -----
+//
+// The catalog is gzipped JSON prebuilt by extract_cat_commands.py and sent
+// straight from flash with a content-hash ETag; the browser revalidates
+// (Cache-Control: no-cache) and gets a bodyless 304 while it is unchanged.
+// Only a client that does not accept gzip gets it built from s_cmd_db.
 
-static esp_err_t api_commands_get_handler(httpd_req_t *req)
+static bool client_accepts_gzip(httpd_req_t *req);
+
+static esp_err_t api_commands_send_plain(httpd_req_t *req)
 {
     int count = 0;
     const thetis_cmd_t *db = cmd_db_get_all(&count);
@@ -426,17 +1213,41 @@ static esp_err_t api_commands_get_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+static esp_err_t api_commands_get_handler(httpd_req_t *req)
+{
+    if (!client_accepts_gzip(req)) return api_commands_send_plain(req);
+
+    size_t len;
+    const char *etag;
+    const uint8_t *gz = cmd_db_catalog_gz(&len, &etag);
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    char match[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK &&
+        strstr(match, etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)gz, len);
+}
+
 // ----- REST API: GET /api/mappings -----
 
 static esp_err_t api_mappings_get_handler(httpd_req_t *req)
 {
-    int count = 0;
-    const mapping_entry_t *table = mapping_engine_get_table(&count);
+    mapping_entry_t table[MAX_MAPPINGS];
+    int count = mapping_engine_get_table(table, MAX_MAPPINGS);
 
     cJSON *arr = cJSON_CreateArray();
     for (int i = 0; i < count; i++) {
         cJSON *entry = cJSON_CreateObject();
-        cJSON_AddStringToObject(entry, "c", table[i].control_name);
+        cJSON_AddStringToObject(entry, "c", dj_control_name(table[i].control_id));
         cJSON_AddNumberToObject(entry, "id", table[i].command_id);
         if (table[i].param != 0) {
             cJSON_AddNumberToObject(entry, "p", table[i].param);
@@ -458,6 +1269,20 @@ static esp_err_t api_mappings_get_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// LED meter entries ({"m":...}) of a mappings array. Returns how many, or
+// -1 if one is invalid or there are more than LED_METER_MAX.
+static int parse_meters(const cJSON *arr, led_meter_def_t *defs)
+{
+    int count = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, arr) {
+        if (!cJSON_GetObjectItem(item, "m")) continue;
+        if (count >= LED_METER_MAX || !led_meter_from_json(item, &defs[count])) return -1;
+        count++;
+    }
+    return count;
+}
+
 // ----- REST API: PUT /api/mappings -----
 
 static esp_err_t api_mappings_put_handler(httpd_req_t *req)
@@ -494,8 +1319,19 @@ static esp_err_t api_mappings_put_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
+    // The editor sends mappings only: keep the LED meters unless the array has some
+    led_meter_def_t meters[LED_METER_MAX];
+    int meter_count = parse_meters(arr, meters);
+    if (meter_count < 0) {
+        cJSON_Delete(arr);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid LED meter");
+        return ESP_FAIL;
+    }
+    if (meter_count == 0) meter_count = mapping_engine_get_meters(meters, LED_METER_MAX);
+
     // Clear and rebuild mapping table
     mapping_engine_reset_defaults();
+    mapping_engine_set_meters(meters, meter_count);
 
     int applied = 0;
     cJSON *item;
@@ -505,7 +1341,8 @@ static esp_err_t api_mappings_put_handler(httpd_req_t *req)
         if (!c || !cJSON_IsString(c) || !id || !cJSON_IsNumber(id)) continue;
 
         mapping_entry_t entry = {0};
-        strncpy(entry.control_name, c->valuestring, sizeof(entry.control_name) - 1);
+        entry.control_id = dj_control_find(c->valuestring);
+        if (entry.control_id == DJ_CONTROL_NONE) continue;
         entry.command_id = (uint16_t)id->valuedouble;
 
         cJSON *p = cJSON_GetObjectItem(item, "p");
@@ -554,13 +1391,13 @@ static esp_err_t api_mappings_reset_handler(httpd_req_t *req)
 
 static esp_err_t api_mappings_download_handler(httpd_req_t *req)
 {
-    int count = 0;
-    const mapping_entry_t *table = mapping_engine_get_table(&count);
+    mapping_entry_t table[MAX_MAPPINGS];
+    int count = mapping_engine_get_table(table, MAX_MAPPINGS);
 
     cJSON *arr = cJSON_CreateArray();
     for (int i = 0; i < count; i++) {
         cJSON *entry = cJSON_CreateObject();
-        cJSON_AddStringToObject(entry, "c", table[i].control_name);
+        cJSON_AddStringToObject(entry, "c", dj_control_name(table[i].control_id));
         cJSON_AddNumberToObject(entry, "id", table[i].command_id);
         if (table[i].param != 0) {
             cJSON_AddNumberToObject(entry, "p", table[i].param);
@@ -568,6 +1405,12 @@ static esp_err_t api_mappings_download_handler(httpd_req_t *req)
         cJSON_AddItemToArray(arr, entry);
     }
 
+    led_meter_def_t meters[LED_METER_MAX];
+    int meter_count = mapping_engine_get_meters(meters, LED_METER_MAX);
+    for (int i = 0; i < meter_count; i++) {
+        cJSON_AddItemToArray(arr, led_meter_to_json(&meters[i]));
+    }
+
     char *json = cJSON_PrintUnformatted(arr);
     cJSON_Delete(arr);
     if (!json) {
@@ -619,8 +1462,18 @@ static esp_err_t api_mappings_upload_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    // Reset to defaults then overlay uploaded mappings
+    led_meter_def_t meters[LED_METER_MAX];
+    int meter_count = parse_meters(arr, meters);
+    if (meter_count < 0) {
+        cJSON_Delete(arr);
+        free(buf);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid LED meter");
+        return ESP_FAIL;
+    }
+
+    // Reset to defaults then overlay uploaded mappings and meters
     mapping_engine_reset_defaults();
+    mapping_engine_set_meters(meters, meter_count);
 
     int applied = 0;
     cJSON *item;
@@ -630,7 +1483,8 @@ static esp_err_t api_mappings_upload_handler(httpd_req_t *req)
         if (!c || !cJSON_IsString(c) || !id || !cJSON_IsNumber(id)) continue;
 
         mapping_entry_t entry = {0};
-        strncpy(entry.control_name, c->valuestring, sizeof(entry.control_name) - 1);
+        entry.control_id = dj_control_find(c->valuestring);
+        if (entry.control_id == DJ_CONTROL_NONE) continue;
         entry.command_id = (uint16_t)id->valuedouble;
 
         cJSON *p = cJSON_GetObjectItem(item, "p");
@@ -649,9 +1503,8 @@ static esp_err_t api_mappings_upload_handler(httpd_req_t *req)
 
     cJSON *resp = cJSON_CreateObject();
     cJSON_AddBoolToObject(resp, "ok", save_ret == ESP_OK);
-    int count = 0;
-    mapping_engine_get_table(&count);
-    cJSON_AddNumberToObject(resp, "loaded", count);
+    cJSON_AddNumberToObject(resp, "loaded", mapping_engine_get_table(NULL, 0));
+    cJSON_AddNumberToObject(resp, "meters", meter_count);
     char *json = cJSON_PrintUnformatted(resp);
     cJSON_Delete(resp);
 
@@ -678,7 +1531,9 @@ static esp_err_t api_mapping_delete_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    esp_err_t ret = mapping_engine_remove(control);
+    uint8_t control_id = dj_control_find(control);
+    esp_err_t ret = (control_id == DJ_CONTROL_NONE) ? ESP_ERR_NOT_FOUND
+                                                    : mapping_engine_remove(control_id);
     if (ret == ESP_OK) {
         mapping_engine_save();
     }
@@ -698,15 +1553,20 @@ static esp_err_t api_mapping_delete_handler(httpd_req_t *req)
 
 static esp_err_t api_leds_get_handler(httpd_req_t *req)
 {
-    const uint8_t *states = dj_led_get_all();
+    static const char *const names[] = {"off", "on", "blink"};
+    dj_led_frame_t want, device;
+    dj_led_get_frames(&want, &device);
 
+    // Notes lit in either frame; "hw" is what the console confirmed
     cJSON *arr = cJSON_CreateArray();
     for (int note = 0; note <= LED_NOTE_MAX; note++) {
-        if (states[note] != LED_STATE_OFF) {
+        uint8_t state = dj_led_frame_state(&want, note);
+        uint8_t hw = dj_led_frame_state(&device, note);
+        if (state != LED_STATE_OFF || hw != LED_STATE_OFF) {
             cJSON *obj = cJSON_CreateObject();
             cJSON_AddNumberToObject(obj, "note", note);
-            const char *st = (states[note] == LED_STATE_BLINK) ? "blink" : "on";
-            cJSON_AddStringToObject(obj, "state", st);
+            cJSON_AddStringToObject(obj, "state", names[state]);
+            cJSON_AddStringToObject(obj, "hw", names[hw]);
             cJSON_AddItemToArray(arr, obj);
         }
     }
@@ -783,7 +1643,7 @@ static esp_err_t api_leds_post_handler(httpd_req_t *req)
     // Broadcast LED change via WebSocket
     char ws_buf[64];
     snprintf(ws_buf, sizeof(ws_buf), "{\"type\":\"led\",\"note\":%d,\"state\":\"%s\"}", note, state);
-    http_server_ws_broadcast(ws_buf);
+    ws_send_json(ws_buf, WS_TOPIC_LED, false);
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"ok\":true}");
@@ -796,23 +1656,113 @@ static esp_err_t api_leds_alloff_handler(httpd_req_t *req)
 {
     dj_led_all_off();
 
-    http_server_ws_broadcast("{\"type\":\"led_all_off\"}");
+    ws_send_json("{\"type\":\"led_all_off\"}", WS_TOPIC_LED, false);
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"ok\":true}");
     return ESP_OK;
 }
 
-// ----- REST API: POST /api/leds/test -----
+// ----- REST API: POST /api/leds/test[?anim=name] -----
 
 static esp_err_t api_leds_test_handler(httpd_req_t *req)
 {
+    // Default is the test sweep; ?anim=chase|flash|pulse|stop picks another
+    char query[32] = {0};
+    char name[12] = "test";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "anim", name, sizeof(name));
+    }
+
+    if (strcmp(name, "stop") == 0) {
+        led_anim_stop();
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, "{\"ok\":true}");
+        return ESP_OK;
+    }
+
+    int id = led_anim_find(name);
+    if (id < 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown animation");
+        return ESP_FAIL;
+    }
+    if (led_anim_start(id) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, "{\"ok\":false,\"msg\":\"Animation queue full\"}");
+        return ESP_OK;
+    }
+
+    // Queued: the LED task plays it, nothing here waits
+    char resp[64];
+    snprintf(resp, sizeof(resp), "{\"ok\":true,\"anim\":\"%s\",\"ms\":%lu}",
+             name, (unsigned long)led_anim_duration_ms(id));
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"ok\":true,\"msg\":\"Test started\"}");
+    httpd_resp_sendstr(req, resp);
+    return ESP_OK;
+}
+
+// ----- REST API: GET /api/meters -----
+
+static esp_err_t api_meters_get_handler(httpd_req_t *req)
+{
+    led_meter_def_t meters[LED_METER_MAX];
+    int count = mapping_engine_get_meters(meters, LED_METER_MAX);
+
+    cJSON *arr = cJSON_CreateArray();
+    for (int i = 0; i < count; i++) {
+        cJSON_AddItemToArray(arr, led_meter_to_json(&meters[i]));
+    }
+    char *json = cJSON_PrintUnformatted(arr);
+    cJSON_Delete(arr);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    free(json);
+    return ESP_OK;
+}
+
+// ----- REST API: PUT /api/meters -----
+
+static esp_err_t api_meters_put_handler(httpd_req_t *req)
+{
+    char body[512];
+    int total_len = req->content_len;
+    if (total_len <= 0 || total_len >= (int)sizeof(body)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid content length");
+        return ESP_FAIL;
+    }
+    int received = 0;
+    while (received < total_len) {
+        int ret = httpd_req_recv(req, body + received, total_len - received);
+        if (ret <= 0) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Receive failed");
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    body[total_len] = '\0';
 
-    dj_led_test();
+    cJSON *arr = cJSON_Parse(body);
+    if (!arr || !cJSON_IsArray(arr)) {
+        if (arr) cJSON_Delete(arr);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected JSON array");
+        return ESP_FAIL;
+    }
+    led_meter_def_t meters[LED_METER_MAX];
+    int count = parse_meters(arr, meters);
+    if (count != cJSON_GetArraySize(arr)) count = -1;   // Every entry must be a meter
+    cJSON_Delete(arr);
+    if (count < 0 || mapping_engine_set_meters(meters, count) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid LED meter");
+        return ESP_FAIL;
+    }
 
-    http_server_ws_broadcast("{\"type\":\"led_all_off\"}");
+    esp_err_t ret = mapping_engine_save();
+    char resp[48];
+    snprintf(resp, sizeof(resp), "{\"ok\":%s,\"meters\":%d}", ret == ESP_OK ? "true" : "false", count);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, resp);
     return ESP_OK;
 }
 
@@ -857,25 +1807,292 @@ static esp_err_t api_cat_send_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-// ----- Static file serving from SPIFFS -----
+// ----- REST API: /api/trace (USB packet trace recorder) -----
 
-static const char *get_mime_type(const char *path)
+static esp_err_t api_trace_get_handler(httpd_req_t *req)
 {
-    const char *ext = strrchr(path, '.');
-    if (!ext) return "application/octet-stream";
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "recording", usb_trace_is_recording());
+    cJSON_AddBoolToObject(root, "replaying", usb_trace_is_replaying());
+    cJSON_AddNumberToObject(root, "packets", usb_trace_get_count());
+    cJSON_AddNumberToObject(root, "dropped", usb_trace_get_dropped());
+    cJSON_AddNumberToObject(root, "bytes", usb_trace_get_size());
 
-    if (strcmp(ext, ".html") == 0) return "text/html";
-    if (strcmp(ext, ".js") == 0)   return "application/javascript";
-    if (strcmp(ext, ".css") == 0)  return "text/css";
-    if (strcmp(ext, ".json") == 0) return "application/json";
-    if (strcmp(ext, ".png") == 0)  return "image/png";
-    if (strcmp(ext, ".svg") == 0)  return "image/svg+xml";
-    if (strcmp(ext, ".ico") == 0)  return "image/x-icon";
-    if (strcmp(ext, ".woff") == 0) return "font/woff";
-    if (strcmp(ext, ".woff2") == 0) return "font/woff2";
-    return "application/octet-stream";
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    free(json);
+    return ESP_OK;
 }
 
+// Body: {"action":"start"|"stop"|"replay", "speed":N}  (speed 0 = max, 1 = real time)
+static esp_err_t api_trace_post_handler(httpd_req_t *req)
+{
+    char body[96];
+    int len = httpd_req_recv(req, body, sizeof(body) - 1);
+    if (len <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Empty body");
+        return ESP_FAIL;
+    }
+    body[len] = '\0';
+
+    cJSON *j = cJSON_Parse(body);
+    if (!j) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    const char *action = cJSON_GetStringValue(cJSON_GetObjectItem(j, "action"));
+    cJSON *speed = cJSON_GetObjectItem(j, "speed");
+    esp_err_t ret;
+    if (action && strcmp(action, "start") == 0) {
+        ret = usb_trace_start();
+    } else if (action && strcmp(action, "stop") == 0) {
+        usb_trace_stop();
+        ret = ESP_OK;
+    } else if (action && strcmp(action, "replay") == 0) {
+        ret = usb_trace_replay_start(cJSON_IsNumber(speed) ? speed->valueint : 1);
+    } else {
+        cJSON_Delete(j);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown action");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Trace %s: %s", action, esp_err_to_name(ret));
+    cJSON_Delete(j);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, ret == ESP_OK ? "{\"ok\":true}" : "{\"ok\":false}");
+    return ESP_OK;
+}
+
+static esp_err_t api_trace_download_handler(httpd_req_t *req)
+{
+    size_t size = usb_trace_get_size();
+    if (size == 0 || usb_trace_is_recording()) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No trace (or still recording)");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"djtrace.bin\"");
+
+    char buf[1024];
+    for (size_t off = 0; off < size; off += sizeof(buf)) {
+        size_t n = (size - off < sizeof(buf)) ? size - off : sizeof(buf);
+        if (usb_trace_read(off, buf, n) != ESP_OK ||
+            httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+            httpd_resp_send_chunk(req, NULL, 0);
+            return ESP_FAIL;
+        }
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+// ----- Latency histograms: GET /api/latency, POST /api/latency/reset -----
+
+#define LATENCY_PUSH_MS 2000   // WS "latency" message period (only if changed)
+
+static cJSON *latency_json(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *floors = cJSON_AddArrayToObject(root, "bucket_floor_us");
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        cJSON_AddItemToArray(floors, cJSON_CreateNumber(latency_bucket_floor_us(b)));
+    }
+
+    cJSON *stages = cJSON_AddArrayToObject(root, "stages");
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+        latency_hist_t h;
+        latency_get(s, &h);
+        cJSON *st = cJSON_CreateObject();
+        cJSON_AddStringToObject(st, "name", latency_stage_name(s));
+        cJSON_AddNumberToObject(st, "count", h.count);
+        cJSON_AddNumberToObject(st, "p50_us", latency_percentile_us(&h, 50));
+        cJSON_AddNumberToObject(st, "p90_us", latency_percentile_us(&h, 90));
+        cJSON_AddNumberToObject(st, "p99_us", latency_percentile_us(&h, 99));
+        cJSON_AddNumberToObject(st, "max_us", h.max_us);
+        cJSON *buckets = cJSON_AddArrayToObject(st, "buckets");
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            cJSON_AddItemToArray(buckets, cJSON_CreateNumber(h.buckets[b]));
+        }
+        cJSON_AddItemToArray(stages, st);
+    }
+    return root;
+}
+
+static esp_err_t api_latency_get_handler(httpd_req_t *req)
+{
+    cJSON *root = latency_json();
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    free(json);
+    return ESP_OK;
+}
+
+static esp_err_t api_latency_reset_handler(httpd_req_t *req)
+{
+    latency_reset();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"ok\":true}");
+    return ESP_OK;
+}
+
+// Push the histograms to WS clients every LATENCY_PUSH_MS while they change
+static void latency_push_task(void *arg)
+{
+    uint32_t last_total = 0;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(LATENCY_PUSH_MS));
+        if (s_ws_count == 0) continue;
+
+        uint32_t total = 0;
+        for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+            latency_hist_t h;
+            latency_get(s, &h);
+            total += h.count;
+        }
+        if (total == last_total) continue;   // Also catches a reset (total drops)
+        last_total = total;
+
+        cJSON *root = latency_json();
+        cJSON_AddStringToObject(root, "type", "latency");
+        char *json = cJSON_PrintUnformatted(root);
+        cJSON_Delete(root);
+        if (json) {
+            ws_send_json(json, -1, true);
+            free(json);
+        }
+    }
+}
+
+// ----- Pipeline counters: GET /api/metrics[?format=json] -----
+
+#define METRICS_PREFIX "djconsole_"
+
+static esp_err_t api_metrics_json(httpd_req_t *req)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *counters = cJSON_AddObjectToObject(root, "counters");
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        const metric_info_t *info = metrics_info(m);
+        char key[64];
+        if (info->labels) {
+            snprintf(key, sizeof(key), "%s{%s}", info->name, info->labels);
+        } else {
+            snprintf(key, sizeof(key), "%s", info->name);
+        }
+        cJSON_AddNumberToObject(counters, key, metrics_get(m));
+    }
+
+    cJSON *clients = cJSON_AddArrayToObject(root, "ws_clients");
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    for (int i = 0; i < s_ws_count; i++) {
+        cJSON *c = cJSON_CreateObject();
+        cJSON_AddNumberToObject(c, "fd", s_clients[i].fd);
+        cJSON_AddNumberToObject(c, "frames_sent", s_clients[i].sent);
+        cJSON_AddNumberToObject(c, "frames_dropped", s_clients[i].dropped);
+        cJSON_AddNumberToObject(c, "resyncs", s_clients[i].resyncs);
+        cJSON_AddNumberToObject(c, "queued", s_clients[i].len);
+        cJSON *topics = cJSON_AddArrayToObject(c, "topics");
+        for (int t = 0; t < WS_TOPIC_COUNT; t++) {
+            if (s_clients[i].filter.topics & TOPIC_BIT(t)) {
+                cJSON_AddItemToArray(topics, cJSON_CreateString(s_topic_names[t]));
+            }
+        }
+        cJSON_AddItemToArray(clients, c);
+    }
+    xSemaphoreGive(s_ws_lock);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    free(json);
+    return ESP_OK;
+}
+
+// Prometheus text exposition format, one chunk per line
+static esp_err_t api_metrics_get_handler(httpd_req_t *req)
+{
+    char query[32];
+    char format[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "format", format, sizeof(format)) == ESP_OK &&
+        strcmp(format, "json") == 0) {
+        return api_metrics_json(req);
+    }
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    char line[160];
+    const char *last_name = NULL;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        const metric_info_t *info = metrics_info(m);
+        // Labelled series of one metric are adjacent: HELP/TYPE once per name
+        if (!last_name || strcmp(last_name, info->name) != 0) {
+            snprintf(line, sizeof(line),
+                "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s counter\n",
+                info->name, info->help, info->name);
+            httpd_resp_sendstr_chunk(req, line);
+            last_name = info->name;
+        }
+        snprintf(line, sizeof(line), METRICS_PREFIX "%s%s%s%s %lu\n",
+            info->name, info->labels ? "{" : "", info->labels ? info->labels : "",
+            info->labels ? "}" : "", (unsigned long)metrics_get(m));
+        httpd_resp_sendstr_chunk(req, line);
+    }
+
+    // Per-client series; copy under the lock, send without it
+    struct { int fd; uint32_t v[3]; } clients[MAX_WS_CLIENTS];
+    xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+    int n = s_ws_count;
+    for (int i = 0; i < n; i++) {
+        clients[i].fd = s_clients[i].fd;
+        clients[i].v[0] = s_clients[i].sent;
+        clients[i].v[1] = s_clients[i].dropped;
+        clients[i].v[2] = s_clients[i].resyncs;
+    }
+    xSemaphoreGive(s_ws_lock);
+
+    static const char *const client_metrics[3][2] = {
+        { "ws_client_frames_sent_total",    "WebSocket frames sent per client" },
+        { "ws_client_frames_dropped_total", "WebSocket frames dropped per client" },
+        { "ws_client_resyncs_total",        "Slow-client resync snapshots per client" },
+    };
+    for (int m = 0; m < 3; m++) {
+        snprintf(line, sizeof(line),
+            "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s counter\n",
+            client_metrics[m][0], client_metrics[m][1], client_metrics[m][0]);
+        httpd_resp_sendstr_chunk(req, line);
+        for (int i = 0; i < n; i++) {
+            snprintf(line, sizeof(line), METRICS_PREFIX "%s{fd=\"%d\"} %lu\n",
+                client_metrics[m][0], clients[i].fd, (unsigned long)clients[i].v[m]);
+            httpd_resp_sendstr_chunk(req, line);
+        }
+    }
+
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+// ----- Static file serving from the asset bundle -----
+
+static www_bundle_t                s_www;
+static esp_partition_mmap_handle_t s_www_map;
+
 static esp_err_t static_file_handler_internal(httpd_req_t *req);
 
 // Captive portal detection
@@ -906,69 +2123,48 @@ static bool client_accepts_gzip(httpd_req_t *req)
     return false;
 }
 
+// Served from the memory-mapped asset bundle: one binary search, then one
+// httpd_resp_send() straight from flash. Unknown paths get index.html (SPA).
 static esp_err_t static_file_handler_internal(httpd_req_t *req)
 {
-    char filepath[128];
     const char *uri = req->uri;
 
     // Strip query string
     const char *query = strchr(uri, '?');
     size_t uri_len = query ? (size_t)(query - uri) : strlen(uri);
 
-    if (uri_len == 1 && uri[0] == '/') {
-        snprintf(filepath, sizeof(filepath), "/www/index.html");
-    } else {
-        snprintf(filepath, sizeof(filepath), "/www%.*s", (int)uri_len, uri);
-    }
-
-    struct stat st;
-    if (stat(filepath, &st) != 0) {
-        // SPA fallback
-        snprintf(filepath, sizeof(filepath), "/www/index.html");
-        if (stat(filepath, &st) != 0) {
-            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
-            return ESP_FAIL;
-        }
-    }
-
-    // Try gzip version
-    bool serving_gzip = false;
-    char gzpath[132];
-    if (client_accepts_gzip(req)) {
-        snprintf(gzpath, sizeof(gzpath), "%s.gz", filepath);
-        if (stat(gzpath, &st) == 0) {
-            serving_gzip = true;
-        }
-    }
-
-    FILE *f = fopen(serving_gzip ? gzpath : filepath, "r");
-    if (!f) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to open file");
+    www_asset_t asset;
+    bool is_root = uri_len == 1 && uri[0] == '/';
+    if ((is_root || !www_bundle_find(&s_www, uri, uri_len, &asset)) &&
+        !www_bundle_find(&s_www, "/index.html", 11, &asset)) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
         return ESP_FAIL;
     }
 
-    httpd_resp_set_type(req, get_mime_type(filepath));
-
-    if (serving_gzip) {
-        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-    }
+    // Gzipped entries keep a plain copy for clients that do not accept gzip
+    // (captive-portal mini-browsers, curl without --compressed)
+    bool send_gzip = asset.gzip && client_accepts_gzip(req);
+    if (asset.gzip) httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
 
-    if (strstr(filepath, "index.html") == NULL) {
+    // Hashed asset names change with their content; index.html is revalidated
+    httpd_resp_set_hdr(req, "ETag", asset.etag);
+    if (strcmp(asset.path, "/index.html") == 0) {
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    } else {
         httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=86400");
     }
 
-    char buf[512];
-    size_t read_bytes;
-    while ((read_bytes = fread(buf, 1, sizeof(buf), f)) > 0) {
-        if (httpd_resp_send_chunk(req, buf, read_bytes) != ESP_OK) {
-            fclose(f);
-            httpd_resp_send_chunk(req, NULL, 0);
-            return ESP_FAIL;
-        }
+    char match[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK &&
+        strstr(match, asset.etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
     }
-    fclose(f);
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+
+    httpd_resp_set_type(req, asset.mime);
+    if (!send_gzip) return httpd_resp_send(req, (const char *)asset.plain, asset.plain_len);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset.body, asset.len);
 }
 
 // ----- Socket close handler -----
@@ -979,30 +2175,40 @@ static void on_sock_close(httpd_handle_t hd, int sockfd)
     close(sockfd);  // MUST close — custom close_fn replaces default close behavior
 }
 
-// ----- SPIFFS mount -----
+// ----- Web asset bundle -----
 
-static esp_err_t mount_spiffs(void)
+// Map the 'www' partition (only as much as the image needs) and check it
+static esp_err_t mount_www(void)
 {
-    esp_vfs_spiffs_conf_t conf = {
-        .base_path = "/www",
-        .partition_label = "www",
-        .max_files = 8,
-        .format_if_mount_failed = true,
-    };
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, "www");
+    if (!part) {
+        ESP_LOGW(TAG, "No 'www' partition");
+        return ESP_ERR_NOT_FOUND;
+    }
 
-    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    www_bundle_header_t hdr;
+    esp_err_t ret = esp_partition_read(part, 0, &hdr, sizeof(hdr));
+    if (ret != ESP_OK) return ret;
+    if (hdr.magic != WWW_BUNDLE_MAGIC || hdr.image_size > part->size) {
+        ESP_LOGW(TAG, "No asset bundle in 'www' (flash build/www.bin)");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void *ptr;
+    ret = esp_partition_mmap(part, 0, hdr.image_size, ESP_PARTITION_MMAP_DATA, &ptr, &s_www_map);
     if (ret != ESP_OK) {
-        if (ret == ESP_ERR_NOT_FOUND) {
-            ESP_LOGW(TAG, "SPIFFS partition 'www' not found");
-        } else {
-            ESP_LOGE(TAG, "SPIFFS mount failed: %s", esp_err_to_name(ret));
-        }
+        ESP_LOGE(TAG, "www mmap failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ret = www_bundle_open(&s_www, ptr, hdr.image_size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Asset bundle damaged: %s", esp_err_to_name(ret));
+        esp_partition_munmap(s_www_map);
         return ret;
     }
 
-    size_t total = 0, used = 0;
-    esp_spiffs_info("www", &total, &used);
-    ESP_LOGI(TAG, "SPIFFS mounted: %d/%d bytes used", used, total);
+    ESP_LOGI(TAG, "Web assets: %d files, %lu bytes mapped", s_www.count, (unsigned long)s_www.size);
     return ESP_OK;
 }
 
@@ -1010,17 +2216,19 @@ static esp_err_t mount_spiffs(void)
 
 esp_err_t http_server_init(void)
 {
-    esp_err_t spiffs_ret = mount_spiffs();
-    if (spiffs_ret != ESP_OK) {
-        ESP_LOGW(TAG, "SPIFFS not available - static file serving disabled");
+    esp_err_t www_ret = mount_www();
+    if (www_ret != ESP_OK) {
+        ESP_LOGW(TAG, "Web assets not available - static file serving disabled");
     }
 
     // Register mapping engine callbacks
     mapping_engine_set_learn_callback(on_learn_complete);
     mapping_engine_set_cat_callback(on_cat_dispatch);
 
+    if (!s_ws_lock) s_ws_lock = xSemaphoreCreateMutex();
+
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 20;
+    config.max_uri_handlers = 28;
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.close_fn = on_sock_close;
     config.stack_size = 12288;
@@ -1056,14 +2264,22 @@ esp_err_t http_server_init(void)
         { .uri = "/api/leds",              .method = HTTP_POST, .handler = api_leds_post_handler },
         { .uri = "/api/leds/all-off",      .method = HTTP_POST, .handler = api_leds_alloff_handler },
         { .uri = "/api/leds/test",         .method = HTTP_POST, .handler = api_leds_test_handler },
+        { .uri = "/api/meters",            .method = HTTP_GET,  .handler = api_meters_get_handler },
+        { .uri = "/api/meters",            .method = HTTP_PUT,  .handler = api_meters_put_handler },
         { .uri = "/api/cat/send",          .method = HTTP_POST, .handler = api_cat_send_handler },
+        { .uri = "/api/trace",             .method = HTTP_GET,  .handler = api_trace_get_handler },
+        { .uri = "/api/trace",             .method = HTTP_POST, .handler = api_trace_post_handler },
+        { .uri = "/api/trace/download",    .method = HTTP_GET,  .handler = api_trace_download_handler },
+        { .uri = "/api/latency",           .method = HTTP_GET,  .handler = api_latency_get_handler },
+        { .uri = "/api/latency/reset",     .method = HTTP_POST, .handler = api_latency_reset_handler },
+        { .uri = "/api/metrics",           .method = HTTP_GET,  .handler = api_metrics_get_handler },
     };
     for (int i = 0; i < sizeof(api_uris) / sizeof(api_uris[0]); i++) {
         httpd_register_uri_handler(s_server, &api_uris[i]);
     }
 
     // Static file catch-all (must be last)
-    if (spiffs_ret == ESP_OK) {
+    if (www_ret == ESP_OK) {
         httpd_uri_t static_uri = {
             .uri = "/*",
             .method = HTTP_GET,
@@ -1072,6 +2288,15 @@ esp_err_t http_server_init(void)
         httpd_register_uri_handler(s_server, &static_uri);
     }
 
+    xTaskCreatePinnedToCore(latency_push_task, "ws_latency", 4096, NULL, 1, NULL, 0);
+
+    uint8_t tick_hz = WS_TICK_HZ_DEFAULT;
+    config_get_u8(CFG_KEY_WS_TICK_HZ, &tick_hz);
+    http_server_set_ws_tick_hz(tick_hz);
+    ws_proto_init();
+    s_batch_lock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(ws_tick_task, "ws_tick", 4096, NULL, 1, &s_tick_task, 0);
+
     ESP_LOGI(TAG, "HTTP server started on port %d", config.server_port);
     return ESP_OK;
 }
@@ -1081,8 +2306,11 @@ void http_server_stop(void)
     if (s_server) {
         httpd_stop(s_server);
         s_server = NULL;
+        xSemaphoreTake(s_ws_lock, portMAX_DELAY);
+        for (int i = 0; i < s_ws_count; i++) client_clear(&s_clients[i]);
         s_ws_count = 0;
+        s_ws_binary_count = 0;
+        xSemaphoreGive(s_ws_lock);
     }
-    esp_vfs_spiffs_unregister("www");
     ESP_LOGI(TAG, "HTTP server stopped");
 }
@@ -3,52 +3,107 @@
 #include <stdbool.h>
 #include "esp_err.h"
 #include "usb_dj_host.h"
+#include "dj_led.h"
 
 /**
- * HTTP Server - serves Svelte SPA from SPIFFS, REST API, and WebSocket live updates.
+ * HTTP Server - serves Svelte SPA from flash, REST API, and WebSocket live updates.
  *
  * REST API:
  *   GET  /api/status              - System status (USB, CAT, heap)
- *   GET  /api/config              - Current configuration (WiFi, CAT host/port)
+ *   GET  /api/config              - Current configuration (WiFi, CAT host/port, ws_tick_hz)
  *   PUT  /api/config              - Update configuration (JSON body)
  *   GET  /api/commands            - Thetis command database (for UI command browser)
  *   GET  /api/mappings            - Current mapping table (JSON array)
  *   PUT  /api/mappings            - Replace entire mapping table (JSON array)
  *   POST /api/mappings/reset      - Reset mappings to defaults
- *   GET  /api/mappings/download   - Download mappings.json as file attachment
+ *   GET  /api/mappings/download   - Download mappings.json (with the LED meters) as file attachment
  *   POST /api/mappings/upload     - Upload mappings.json, validate and reload
  *   POST /api/mappings/clear?c=X  - Remove mapping for control X
- *   GET  /api/leds                - Current LED states (JSON array)
+ *   GET  /api/leds                - LED states (JSON array): lit notes, with the
+ *                                   state the console confirmed in "hw"
  *   POST /api/leds                - Set LED: {"note":N,"state":"on"|"off"|"blink"}
  *   POST /api/leds/all-off        - Turn all LEDs off
- *   POST /api/leds/test           - Run LED test sweep
+ *   POST /api/leds/test           - Queue the LED test sweep (returns at once);
+ *                                   ?anim=chase|flash|pulse plays another, ?anim=stop ends it
+ *   GET  /api/meters              - LED bar-graph meters (JSON array, led_meter.h form)
+ *   PUT  /api/meters              - Replace the meters and save; [] removes them
+ *   GET  /api/latency             - Latency histograms: USB->dispatch, dispatch->wire, wire->echo
+ *   POST /api/latency/reset       - Clear the latency histograms
+ *   GET  /api/metrics             - Pipeline counters, Prometheus text (?format=json for JSON)
  *
  * WebSocket:
  *   /ws  - Bidirectional:
  *     Server->Client:
- *       {"type":"control","name":"Play_A","ctrl":0,"old":0,"new":1}
+ *       Control, CAT and CAT reply events arrive batched, one JSON array per
+ *       tick (ws_tick_hz, default 25 Hz); a dial/encoder moved several times
+ *       in one tick appears once, with "n" = number of changes folded in:
+ *       [{"type":"control","name":"Jog_A","id":55,"ctrl":2,"old":3,"new":9,"n":6},
+ *        {"type":"cat","control":"Jog_A","cmd":"VFO A Tune","exec":"FRQ","cat":"ZZFA00014074100;"},
+ *        {"type":"cat_rx","cmd":"ZZFA","value":"00014074100"}]
+ *       With /ws?bin=1 the batch is one binary frame instead (ws_proto.h).
+       Subscribers to "raw" also get the latest USB packet of each tick:
+        {"type":"raw","t":123456,"hex":"0000..."}
+ *     Other messages are single objects:
  *       {"type":"status","usb":true,"cat":"connected","heap":123456}
+ *       {"type":"leds","on":[1,15],"blink":[20]}    (confirmed hardware frame)
  *       {"type":"learned","control":"Jog_A","command_id":100,"command_name":"VFO A Tune"}
  *       {"type":"learn_timeout"}
+ *       {"type":"latency","stages":[...],...}   (every 2 s while changing)
+ *       {"type":"resync","dropped":12,"status":{...},"leds":[[note,state],...]}
+ *     Each client has a bounded send queue drained by the httpd task.
+ *     Telemetry (batches, latency) is dropped for a client that falls
+ *     behind, which then gets a "resync" snapshot (a binary client gets
+ *     its hello string table again first); the other messages are always
+ *     delivered.
  *     Client->Server:
  *       {"type":"learn","command_id":100}
  *       {"type":"learn_cancel"}
+ *       {"type":"latency_reset"}
+ *       {"type":"led_anim","anim":"chase"}     (or "stop"; "led_test" = test sweep)
+       {"type":"subscribe","topics":["control","cat_tx","cat_rx","status","led","raw"],
+        "cat_rx_prefixes":["ZZFA"],"cat_rx_exclude":["ZZSM"],"rates":{"cat_rx":5}}
+         Replaces the client's topics (default: all but raw). Prefixes filter
+         cat_rx replies; rates cap batched topics in events/s. Nothing is
+         formatted for a topic no client wants. learned, latency and resync
+         always arrive.
  *
  * Static files:
- *   All other paths - Served from SPIFFS /www partition, SPA fallback to index.html
+ *   All other paths - Served from the memory-mapped "www" asset bundle
+ *                     (www_bundle.h), gzipped, with ETag / 304; unknown
+ *                     paths get index.html (SPA fallback)
  */
 
 esp_err_t http_server_init(void);
 void http_server_stop(void);
 
+/** Queue a must-deliver JSON message for every client. Never blocks on the network. */
 void http_server_ws_broadcast(const char *json);
 
+/**
+ * Queue a control change for the next WS batch. Never blocks on the network.
+ */
 void http_server_notify_control(
-    const char *name,
+    uint8_t control_id,
     dj_control_type_t control_type,
     uint8_t old_value,
     uint8_t new_value);
 
 void http_server_notify_status(void);
 
+/** Queue a CAT reply for the next WS batch. */
 void http_server_notify_cat_rx(const char *cmd, const char *value);
+
+/**
+ * Offer a raw USB state packet to clients subscribed to "raw". Only the
+ * latest packet of each WS batch is sent. Cheap no-op when nobody is.
+ */
+void http_server_notify_raw(const uint8_t *data, int length);
+
+/**
+ * Send the LED frame the console confirmed to "led" subscribers (the
+ * dj_led frame callback).
+ */
+void http_server_notify_leds(const dj_led_frame_t *device);
+
+/** WS batch rate in Hz, clamped to 10-50. */
+void http_server_set_ws_tick_hz(uint8_t hz);
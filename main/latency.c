@@ -0,0 +1,103 @@
+#include "latency.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+// Histograms
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    atomic_uint max_us;
+    atomic_uint buckets[LATENCY_BUCKETS];
+} stage_hist_t;
+
+static stage_hist_t s_hist[LATENCY_STAGE_COUNT];
+static int64_t      s_usb_rx_us = 0;   // Written and read on the USB task
+
+static const char *const s_stage_names[LATENCY_STAGE_COUNT] = {
+    "usb_to_dispatch", "dispatch_to_wire", "wire_to_echo",
+};
+
+static int bucket_of(uint32_t us)
+{
+    if (us < 2) return 0;
+    int b = 31 - __builtin_clz(us);
+    return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+}
+
+void latency_record(latency_stage_t stage, int64_t us)
+{
+    if (stage >= LATENCY_STAGE_COUNT) return;
+    uint32_t v = us <= 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    stage_hist_t *h = &s_hist[stage];
+
+    atomic_fetch_add_explicit(&h->buckets[bucket_of(v)], 1, memory_order_relaxed);
+    unsigned max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    while (v > max &&
+           !atomic_compare_exchange_weak_explicit(&h->max_us, &max, v,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void latency_get(latency_stage_t stage, latency_hist_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (stage >= LATENCY_STAGE_COUNT) return;
+    stage_hist_t *h = &s_hist[stage];
+
+    // count is the bucket sum, so it always agrees with the copied buckets
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        out->buckets[b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+        out->count += out->buckets[b];
+    }
+    out->max_us = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+}
+
+void latency_reset(void)
+{
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            atomic_store_explicit(&s_hist[s].buckets[b], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&s_hist[s].max_us, 0, memory_order_relaxed);
+    }
+}
+
+const char *latency_stage_name(latency_stage_t stage)
+{
+    return stage < LATENCY_STAGE_COUNT ? s_stage_names[stage] : "?";
+}
+
+uint32_t latency_percentile_us(const latency_hist_t *h, int pct)
+{
+    if (h->count == 0) return 0;
+    // Rank of the sample we want, 1-based, rounded up
+    uint64_t rank = ((uint64_t)h->count * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            // The open last bucket (and any bucket above the max) reports the max
+            if (b == LATENCY_BUCKETS - 1) return h->max_us;
+            uint32_t edge = 1u << (b + 1);
+            return edge < h->max_us ? edge : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+// ---------------------------------------------------------------------------
+// USB packet stamp
+// ---------------------------------------------------------------------------
+
+void latency_mark_usb_rx(int64_t us)
+{
+    s_usb_rx_us = us;
+}
+
+int64_t latency_usb_rx_us(void)
+{
+    return s_usb_rx_us;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * End-to-end latency histograms for the tuning path.
+ *
+ *   USB packet (bulk_in_cb) -> engine dispatch -> CAT send() -> Thetis reply
+ *
+ * Each stage is a fixed log2 histogram in microseconds: bucket 0 counts
+ * 0-1 us, bucket b counts [2^b, 2^(b+1)) us, and the last bucket is open
+ * ended (>= ~0.5 s). Recording is lock-free and safe from any task.
+ */
+
+typedef enum {
+    LATENCY_USB_TO_DISPATCH = 0,   // bulk IN callback -> mapping engine handles it
+    LATENCY_DISPATCH_TO_WIRE,      // command queued by the engine -> send() done
+    LATENCY_WIRE_TO_ECHO,          // send() -> Thetis response with the same prefix
+    LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+#define LATENCY_BUCKETS 20
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+/** Add one sample (negative values count as 0). */
+void latency_record(latency_stage_t stage, int64_t us);
+
+/** Copy a stage's histogram. */
+void latency_get(latency_stage_t stage, latency_hist_t *out);
+
+/** Clear every histogram. */
+void latency_reset(void);
+
+/** Stage name for APIs and logs: "usb_to_dispatch", ... */
+const char *latency_stage_name(latency_stage_t stage);
+
+/** Upper edge (us) of the bucket holding the pct-th percentile; 0 if empty. */
+uint32_t latency_percentile_us(const latency_hist_t *h, int pct);
+
+/** Lower edge (us) of bucket b. */
+static inline uint32_t latency_bucket_floor_us(int b)
+{
+    return b == 0 ? 0 : (1u << b);
+}
+
+/**
+ * Arrival time of the USB packet being decoded. Set by the bulk IN path
+ * just before dj_state_process(); control callbacks run inside that call,
+ * so they can read it to stamp their events.
+ */
+void latency_mark_usb_rx(int64_t us);
+int64_t latency_usb_rx_us(void);
@@ -0,0 +1,166 @@
+#include "led_anim.h"
+
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+
+static const char *TAG = "led_anim";
+
+#define ANIM_QUEUE_LEN  4
+
+// ----- Animation table -----
+//
+// Each animation is a fixed number of keyframes of step_ms each (the sweep
+// also holds everything on for hold_ms in the middle). Keyframes are
+// computed from the elapsed time, so nothing is stored per frame.
+
+typedef enum { KIND_SWEEP, KIND_CHASE, KIND_FLASH, KIND_PULSE } anim_kind_t;
+
+typedef struct {
+    const char *name;
+    anim_kind_t kind;
+    uint16_t    step_ms;    // Time per keyframe
+    uint16_t    hold_ms;    // Sweep: all on between the two sweeps
+    uint8_t     cycles;     // Chase, flash, pulse: repeats
+} anim_def_t;
+
+static const anim_def_t s_anims[LED_ANIM_COUNT] = {
+    [LED_ANIM_TEST]  = {"test",  KIND_SWEEP,  30, 500, 1},
+    [LED_ANIM_CHASE] = {"chase", KIND_CHASE,  40,   0, 2},
+    [LED_ANIM_FLASH] = {"flash", KIND_FLASH, 200,   0, 4},
+    [LED_ANIM_PULSE] = {"pulse", KIND_PULSE,  60,   0, 3},
+};
+
+// Pulse: bar width (pairs of LEDs out of the middle) per keyframe
+static const uint8_t s_pulse_levels[] = {1, 2, 3, 4, 3, 2, 1, 0};
+#define PULSE_STEPS (sizeof(s_pulse_levels) / sizeof(s_pulse_levels[0]))
+
+#define LED_COUNT   __builtin_popcountll(LED_VALID_MASK)
+
+static QueueHandle_t s_queue = NULL;
+static atomic_bool   s_stop;
+static int           s_current = -1;    // LED task only
+static int64_t       s_start_us;
+
+// The first count notes of a mask, in note order
+static uint64_t first_notes(uint64_t mask, int count)
+{
+    uint64_t out = 0;
+    for (; mask && count > 0; count--) {
+        uint64_t low = mask & -mask;
+        out |= low;
+        mask &= ~low;
+    }
+    return out;
+}
+
+// N1-N8 of one deck, level pairs lit from the middle (N4/N5) outwards
+static uint64_t pulse_bar(uint8_t n1, int level)
+{
+    return ((1ULL << (2 * level)) - 1) << (n1 + 4 - level);
+}
+
+static void frame_at(const anim_def_t *a, uint32_t t_ms, dj_led_frame_t *frame)
+{
+    uint32_t k = t_ms / a->step_ms;
+    uint32_t sweep_ms = LED_COUNT * a->step_ms;
+    frame->blink = 0;
+
+    switch (a->kind) {
+    case KIND_SWEEP:
+        if (t_ms < sweep_ms) {
+            frame->solid = first_notes(LED_VALID_MASK, k + 1);
+        } else if (t_ms < sweep_ms + a->hold_ms) {
+            frame->solid = LED_VALID_MASK;
+        } else {
+            k = (t_ms - sweep_ms - a->hold_ms) / a->step_ms;
+            frame->solid = LED_VALID_MASK & ~first_notes(LED_VALID_MASK, k + 1);
+        }
+        break;
+    case KIND_CHASE:
+        k %= LED_COUNT;
+        frame->solid = first_notes(LED_VALID_MASK, k + 1) & ~first_notes(LED_VALID_MASK, k);
+        break;
+    case KIND_FLASH:
+        frame->solid = (k % 2 == 0) ? LED_VALID_MASK : 0;
+        break;
+    case KIND_PULSE: {
+        int level = s_pulse_levels[k % PULSE_STEPS];
+        frame->solid = pulse_bar(LED_N1_A, level) | pulse_bar(LED_N1_B, level);
+        break;
+    }
+    }
+}
+
+void led_anim_init(void)
+{
+    if (!s_queue) s_queue = xQueueCreate(ANIM_QUEUE_LEN, sizeof(uint8_t));
+}
+
+esp_err_t led_anim_start(led_anim_id_t id)
+{
+    if ((unsigned)id >= LED_ANIM_COUNT) return ESP_ERR_INVALID_ARG;
+    if (!s_queue) return ESP_ERR_INVALID_STATE;
+    uint8_t item = (uint8_t)id;
+    if (xQueueSend(s_queue, &item, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Queue full, '%s' dropped", s_anims[id].name);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void led_anim_stop(void)
+{
+    if (s_queue) xQueueReset(s_queue);
+    atomic_store(&s_stop, true);
+}
+
+const char *led_anim_name(led_anim_id_t id)
+{
+    return (unsigned)id < LED_ANIM_COUNT ? s_anims[id].name : NULL;
+}
+
+int led_anim_find(const char *name)
+{
+    for (int i = 0; i < LED_ANIM_COUNT; i++) {
+        if (strcmp(s_anims[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+uint32_t led_anim_duration_ms(led_anim_id_t id)
+{
+    if ((unsigned)id >= LED_ANIM_COUNT) return 0;
+    const anim_def_t *a = &s_anims[id];
+    switch (a->kind) {
+    case KIND_SWEEP: return 2 * LED_COUNT * a->step_ms + a->hold_ms;
+    case KIND_CHASE: return a->cycles * LED_COUNT * a->step_ms;
+    case KIND_FLASH: return a->cycles * 2 * a->step_ms;
+    case KIND_PULSE: return a->cycles * PULSE_STEPS * a->step_ms;
+    }
+    return 0;
+}
+
+bool led_anim_render(int64_t now_us, dj_led_frame_t *frame)
+{
+    if (atomic_exchange(&s_stop, false) && s_current >= 0) {
+        ESP_LOGI(TAG, "'%s' stopped", s_anims[s_current].name);
+        s_current = -1;
+    }
+    if (s_current >= 0 && now_us - s_start_us >= (int64_t)led_anim_duration_ms(s_current) * 1000) {
+        ESP_LOGD(TAG, "'%s' done", s_anims[s_current].name);
+        s_current = -1;
+    }
+    if (s_current < 0) {
+        uint8_t id;
+        if (!s_queue || xQueueReceive(s_queue, &id, 0) != pdTRUE) return false;
+        s_current = id;
+        s_start_us = now_us;
+        ESP_LOGI(TAG, "Playing '%s' (%lu ms)", s_anims[id].name,
+                 (unsigned long)led_anim_duration_ms(id));
+    }
+    frame_at(&s_anims[s_current], (uint32_t)((now_us - s_start_us) / 1000), frame);
+    return true;
+}
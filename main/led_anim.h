@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "dj_led.h"
+
+/**
+ * LED animations (test sweep, chase, flash, pulse), played by the LED task.
+ *
+ * An animation is a run of timed keyframes computed from its start time.
+ * While one plays, its frame replaces the desired LED frame in the led_out
+ * diff; the desired states themselves are untouched and come back when it
+ * ends. Callers only queue an animation id and return at once; queued
+ * animations play one after another.
+ *
+ * The engine takes the time as an argument, so a host build can drive it
+ * with a fake clock (host/tools/led_anim_tool.c).
+ */
+
+typedef enum {
+    LED_ANIM_TEST,      // Sweep every LED on, hold, sweep off
+    LED_ANIM_CHASE,     // One LED running through all of them
+    LED_ANIM_FLASH,     // Everything on/off together
+    LED_ANIM_PULSE,     // N1-N8 bars growing out of the middle and back
+    LED_ANIM_COUNT
+} led_anim_id_t;
+
+/** Create the animation queue. Called by dj_led_init(). */
+void led_anim_init(void);
+
+/**
+ * Queue an animation; returns at once.
+ * @return ESP_ERR_INVALID_ARG for an unknown id, ESP_ERR_NO_MEM if the
+ *         queue is full
+ */
+esp_err_t led_anim_start(led_anim_id_t id);
+
+/** Drop the queue and end the running animation at the next frame. */
+void led_anim_stop(void);
+
+/** Short name ("test", "chase", ...), or NULL for an unknown id. */
+const char *led_anim_name(led_anim_id_t id);
+
+/** Id for a name, or -1. */
+int led_anim_find(const char *name);
+
+/** Total run time of an animation. */
+uint32_t led_anim_duration_ms(led_anim_id_t id);
+
+/**
+ * Advance to now_us: start the next queued animation when none is running,
+ * end the running one when its time is up. LED task only.
+ * @return true with *frame set while an animation plays
+ */
+bool led_anim_render(int64_t now_us, dj_led_frame_t *frame);
@@ -0,0 +1,210 @@
+#include "led_meter.h"
+#include "dj_led.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "led_meter";
+
+#define DECK_COUNT  2
+#define QUARTERS    32      // 8 segments in quarter-segment steps
+
+// Known telemetry, polled at a rate that suits how fast it moves
+static const led_meter_def_t s_builtin[] = {
+    // S-meter: value = 2 x (dBm + 140); S0 (-127 dBm) .. S9+40 (-33 dBm)
+    { .cat_cmd = "ZZSM", .query = "ZZSM0", .lo = 26, .hi = 214, .poll_ms = 200 },
+    // Drive level and AF gain, 0-100: show for 2 s after they change
+    { .cat_cmd = "ZZPC", .query = "ZZPC", .lo = 0, .hi = 100, .poll_ms = 1000, .hold_ms = 2000 },
+    { .cat_cmd = "ZZAG", .query = "ZZAG", .lo = 0, .hi = 100, .poll_ms = 1000, .hold_ms = 2000 },
+};
+#define BUILTIN_COUNT (sizeof(s_builtin) / sizeof(s_builtin[0]))
+
+typedef struct {
+    bool    valid;          // Got a reply since the definitions were set
+    int     value;
+    int     level;          // Bar, hysteresis applied
+    int64_t changed_us;     // Value last changed (hold)
+    int64_t polled_us;
+} meter_state_t;
+
+typedef struct {
+    int     shown;          // Segments on the LEDs, -1 = released
+    int64_t pushed_us;
+} deck_state_t;
+
+static led_meter_def_t s_defs[LED_METER_MAX];
+static meter_state_t   s_state[LED_METER_MAX];
+static int             s_count = 0;
+static deck_state_t    s_decks[DECK_COUNT] = {{-1, 0}, {-1, 0}};
+
+static const uint8_t s_deck_n1[DECK_COUNT] = {LED_N1_A, LED_N1_B};
+
+bool led_meter_default(const char *cat_cmd, uint8_t deck, led_meter_def_t *def)
+{
+    memset(def, 0, sizeof(*def));
+    for (int i = 0; i < (int)BUILTIN_COUNT; i++) {
+        if (strcmp(s_builtin[i].cat_cmd, cat_cmd) == 0) {
+            *def = s_builtin[i];
+            def->deck = deck;
+            return true;
+        }
+    }
+    snprintf(def->cat_cmd, sizeof(def->cat_cmd), "%s", cat_cmd);
+    def->deck = deck;
+    return false;
+}
+
+cJSON *led_meter_to_json(const led_meter_def_t *def)
+{
+    cJSON *obj = cJSON_CreateObject();
+    if (!obj) return NULL;
+    cJSON_AddStringToObject(obj, "m", def->cat_cmd);
+    cJSON_AddStringToObject(obj, "deck", def->deck ? "B" : "A");
+    cJSON_AddNumberToObject(obj, "lo", def->lo);
+    cJSON_AddNumberToObject(obj, "hi", def->hi);
+    cJSON_AddStringToObject(obj, "q", def->query);
+    cJSON_AddNumberToObject(obj, "poll", def->poll_ms);
+    cJSON_AddNumberToObject(obj, "hold", def->hold_ms);
+    return obj;
+}
+
+bool led_meter_from_json(const cJSON *item, led_meter_def_t *def)
+{
+    cJSON *m = cJSON_GetObjectItem(item, "m");
+    cJSON *deck = cJSON_GetObjectItem(item, "deck");
+    if (!cJSON_IsString(m) || strlen(m->valuestring) < 2 || strlen(m->valuestring) > 4 ||
+        !cJSON_IsString(deck) || (strcmp(deck->valuestring, "A") != 0 &&
+                                  strcmp(deck->valuestring, "B") != 0)) {
+        return false;
+    }
+    led_meter_default(m->valuestring, deck->valuestring[0] == 'B', def);
+
+    cJSON *v;
+    if (cJSON_IsNumber(v = cJSON_GetObjectItem(item, "lo")))   def->lo = (int16_t)v->valueint;
+    if (cJSON_IsNumber(v = cJSON_GetObjectItem(item, "hi")))   def->hi = (int16_t)v->valueint;
+    if (cJSON_IsNumber(v = cJSON_GetObjectItem(item, "poll"))) def->poll_ms = (uint16_t)v->valueint;
+    if (cJSON_IsNumber(v = cJSON_GetObjectItem(item, "hold"))) def->hold_ms = (uint16_t)v->valueint;
+    if (cJSON_IsString(v = cJSON_GetObjectItem(item, "q"))) {
+        snprintf(def->query, sizeof(def->query), "%s", v->valuestring);
+    }
+    return def->hi != def->lo;
+}
+
+esp_err_t led_meter_set_defs(const led_meter_def_t *defs, int count)
+{
+    if (count < 0 || count > LED_METER_MAX) return ESP_ERR_INVALID_SIZE;
+    for (int i = 0; i < count; i++) {
+        if (defs[i].deck >= DECK_COUNT || defs[i].hi == defs[i].lo || defs[i].cat_cmd[0] == '\0') {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    if (count > 0) memcpy(s_defs, defs, count * sizeof(*defs));
+    memset(s_state, 0, sizeof(s_state));
+    s_count = count;
+
+    // Give back the LEDs of a deck left without a meter: no tick will
+    for (int deck = 0; deck < DECK_COUNT; deck++) {
+        bool used = false;
+        for (int i = 0; i < count; i++) {
+            if (defs[i].deck == deck) used = true;
+        }
+        if (!used && s_decks[deck].shown >= 0) {
+            dj_led_set_bar(s_deck_n1[deck], -1);
+            s_decks[deck] = (deck_state_t){-1, 0};
+        }
+    }
+    ESP_LOGI(TAG, "%d LED meters", count);
+    return ESP_OK;
+}
+
+int led_meter_get_defs(led_meter_def_t *out, int max)
+{
+    int n = s_count < max ? s_count : max;
+    if (n > 0) memcpy(out, s_defs, n * sizeof(*out));
+    return s_count;
+}
+
+// Rise as soon as a segment boundary is crossed, fall only HYST below it
+static int bar_level(int level, int pos)
+{
+    if (pos < 0) pos = 0;
+    if (pos > QUARTERS) pos = QUARTERS;
+    int target = pos / 4;
+    if (target < level) {
+        int held = (pos + LED_METER_HYST_Q) / 4;
+        target = held < level ? held : level;
+    }
+    return target;
+}
+
+void led_meter_on_value(int idx, const char *value, int64_t now_us)
+{
+    if (idx < 0 || idx >= s_count) return;
+    const led_meter_def_t *d = &s_defs[idx];
+    meter_state_t *st = &s_state[idx];
+
+    // "ZZSM0" polls receiver 0 and the reply repeats it: "0134"
+    size_t plen = strlen(d->cat_cmd);
+    if (strncmp(d->query, d->cat_cmd, plen) == 0) {
+        const char *param = d->query + plen;
+        size_t n = strlen(param);
+        if (n > 0 && strncmp(value, param, n) == 0) value += n;
+    }
+
+    int v = atoi(value);
+    if (st->valid && v != st->value) st->changed_us = now_us;
+    st->value = v;
+    st->valid = true;
+    st->level = bar_level(st->level, (v - d->lo) * QUARTERS / (d->hi - d->lo));
+}
+
+// Meter a deck shows: the held meter that changed last, else its base meter
+static int deck_meter(int deck, int64_t now_us)
+{
+    int base = -1, held = -1;
+    for (int i = 0; i < s_count; i++) {
+        const led_meter_def_t *d = &s_defs[i];
+        if (d->deck != deck) continue;
+        if (d->hold_ms == 0) {
+            if (base < 0) base = i;
+        } else if (s_state[i].changed_us && now_us - s_state[i].changed_us < d->hold_ms * 1000LL &&
+                   (held < 0 || s_state[i].changed_us > s_state[held].changed_us)) {
+            held = i;
+        }
+    }
+    return held >= 0 ? held : base;
+}
+
+int led_meter_tick(int64_t now_us, const char **queries, int max)
+{
+    int n = 0;
+    for (int i = 0; i < s_count && n < max; i++) {
+        const led_meter_def_t *d = &s_defs[i];
+        if (d->query[0] == '\0' || d->poll_ms == 0) continue;
+        if (s_state[i].polled_us && now_us - s_state[i].polled_us < d->poll_ms * 1000LL) continue;
+        s_state[i].polled_us = now_us;
+        queries[n++] = d->query;
+    }
+
+    for (int deck = 0; deck < DECK_COUNT; deck++) {
+        deck_state_t *ds = &s_decks[deck];
+        int m = deck_meter(deck, now_us);
+        int segments = m < 0 ? -1 : s_state[m].level;
+        if (segments == ds->shown) continue;
+        // Releasing is immediate; bar changes are rate limited
+        if (segments >= 0 && ds->shown >= 0 && now_us - ds->pushed_us < LED_METER_MIN_MS * 1000LL) {
+            continue;
+        }
+        dj_led_set_bar(s_deck_n1[deck], segments);
+        ds->shown = segments;
+        ds->pushed_us = now_us;
+    }
+    return n;
+}
+
+int led_meter_level(int idx)
+{
+    return idx >= 0 && idx < s_count ? s_state[idx].level : 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+/**
+ * LED bar-graph meters: N1-N8 of a deck show a radio value (S-meter, drive,
+ * AF gain) as 0-8 lit segments.
+ *
+ * A meter definition maps a CAT response prefix to a deck and a value
+ * range. The mapping engine routes matching replies here, polls each meter
+ * with its query, and stores the definitions with the mappings. All calls
+ * come from the engine task, so nothing here locks.
+ *
+ * The bar rises as soon as the value crosses a segment but falls only once
+ * it is LED_METER_HYST_Q quarter-segments below, so a value sitting on a
+ * boundary does not flicker. A deck's bar is pushed to the LED driver at
+ * most every LED_METER_MIN_MS; the driver then sends only the segments
+ * that changed.
+ */
+
+#define LED_METER_MAX       4
+#define LED_METER_MIN_MS    100     // Fastest bar update per deck
+#define LED_METER_HYST_Q    1       // Fall hysteresis, quarter-segments
+#define LED_METER_TICK_MS   50      // How often the engine calls led_meter_tick()
+
+typedef struct {
+    char     cat_cmd[5];    // Response prefix: "ZZSM"
+    char     query[8];      // Poll command without ';': "ZZSM0" (its parameter is
+                            // stripped from replies); "" = never poll
+    uint8_t  deck;          // 0 = deck A (notes 1-8), 1 = deck B (20-27)
+    int16_t  lo;            // Value shown as no segments
+    int16_t  hi;            // Value shown as all 8
+    uint16_t poll_ms;       // Query interval
+    uint16_t hold_ms;       // 0: the deck's base meter. Otherwise shown for
+                            // this long after its value changes, then the
+                            // base meter comes back.
+} led_meter_def_t;
+
+/**
+ * Built-in definition for a known prefix (ZZSM, ZZPC, ZZAG) on a deck, to
+ * fill in fields a stored definition leaves out.
+ * @return false for an unknown prefix (*def then has only prefix and deck)
+ */
+bool led_meter_default(const char *cat_cmd, uint8_t deck, led_meter_def_t *def);
+
+/**
+ * JSON form, as stored with the mappings:
+ *   {"m":"ZZSM","deck":"A","lo":26,"hi":214,"q":"ZZSM0","poll":200,"hold":0}
+ * Only "m" and "deck" are required when reading; the rest default to the
+ * built-in definition of the prefix.
+ */
+cJSON *led_meter_to_json(const led_meter_def_t *def);
+bool led_meter_from_json(const cJSON *item, led_meter_def_t *def);
+
+/** Replace all definitions (count 0 removes the meters and frees N1-N8). */
+esp_err_t led_meter_set_defs(const led_meter_def_t *defs, int count);
+
+/** Copy up to max definitions; returns how many there are. */
+int led_meter_get_defs(led_meter_def_t *out, int max);
+
+/** A reply for meter idx (value as received, e.g. "0134" for ZZSM0). */
+void led_meter_on_value(int idx, const char *value, int64_t now_us);
+
+/**
+ * Push due bar changes to the LEDs and collect due poll commands into
+ * queries (at most max). Returns the number of queries.
+ */
+int led_meter_tick(int64_t now_us, const char **queries, int max);
+
+/** Current bar of meter idx (0-8), for tools and the UI. */
+int led_meter_level(int idx);
@@ -10,10 +10,12 @@
 #include "status_led.h"
 #include "usb_dj_host.h"
 #include "usb_debug.h"
+#include "usb_trace.h"
 #include "cat_client.h"
 #include "config_store.h"
 #include "mapping_engine.h"
 #include "http_server.h"
+#include "dj_led.h"
 
 static const char *TAG = "main";
 
@@ -28,15 +30,22 @@ static void init_mdns(void)
 
 // Combined USB callback: debug logging + mapping engine dispatch + WS notify
 static void usb_control_cb(
-    const char *name,
+    uint8_t control_id,
     dj_control_type_t control_type,
-    uint8_t control_index,
     uint8_t old_value,
     uint8_t new_value)
 {
-    usb_debug_control_cb(name, control_type, control_index, old_value, new_value);
-    mapping_engine_on_control(name, control_type, control_index, old_value, new_value);
-    http_server_notify_control(name, control_type, old_value, new_value);
+    usb_debug_control_cb(control_id, control_type, old_value, new_value);
+    mapping_engine_on_control(control_id, control_type, old_value, new_value);
+    http_server_notify_control(control_id, control_type, old_value, new_value);
+}
+
+// Combined raw USB callback: debug counters + trace recorder
+static void usb_raw_cb(const uint8_t *raw_data, int length)
+{
+    usb_debug_raw_state_cb(raw_data, length);
+    usb_trace_record(raw_data, length);
+    http_server_notify_raw(raw_data, length);
 }
 
 // CAT state change callback
@@ -127,6 +136,12 @@ void app_main(void)
     // Start mDNS
     init_mdns();
 
+    // Trace recorder (optional, needs the 'trace' partition)
+    usb_trace_init();
+
+    // LED output task (resets the console's LEDs whenever it connects)
+    dj_led_init();
+
     // Start USB host driver
     usb_debug_set_level(1);
     ret = usb_dj_host_init(usb_control_cb);
@@ -134,17 +149,18 @@ void app_main(void)
         ESP_LOGE(TAG, "USB host init failed: %s", esp_err_to_name(ret));
         status_led_set(LED_RED);
     } else {
-        usb_dj_host_set_raw_callback(usb_debug_raw_state_cb);
+        usb_dj_host_set_raw_callback(usb_raw_cb);
         ESP_LOGI(TAG, "USB host started (debug level %d)", usb_debug_get_level());
     }
 
-    // Start HTTP server (mounts SPIFFS — must happen before mapping_engine_init)
+    // Start HTTP server (maps the web asset bundle; before mapping_engine_init)
     ret = http_server_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "HTTP server init failed: %s", esp_err_to_name(ret));
     }
+    dj_led_set_frame_callback(http_server_notify_leds);   // LED page shows the hardware
 
-    // Initialize mapping engine (loads from SPIFFS or uses defaults)
+    // Initialize mapping engine (loads from NVS or uses defaults)
     mapping_engine_init();
 
     // Start CAT client if WiFi is connected and host configured
@@ -2,12 +2,19 @@
 #include "cat_client.h"
 #include "config_store.h"
 #include "dj_led.h"
+#include "led_meter.h"
+#include "latency.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdatomic.h>
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "cJSON.h"
 
 static const char *TAG = "mapper";
@@ -17,6 +24,7 @@ static const char *TAG = "mapper";
 // ===================================================================
 
 #include "cmd_db_generated.inc"
+#include "cmd_catalog_generated.inc"
 
 #define CMD_DB_COUNT (sizeof(s_cmd_db) / sizeof(s_cmd_db[0]))
 
@@ -42,10 +50,10 @@ const thetis_cmd_t *cmd_db_get_all(int *count)
 
 const thetis_cmd_t *cmd_db_find(uint16_t id)
 {
-    for (int i = 0; i < (int)CMD_DB_COUNT; i++) {
-        if (s_cmd_db[i].id == id) return &s_cmd_db[i];
-    }
-    return NULL;
+    // Dense id -> index table generated alongside s_cmd_db
+    if (id < CMD_ID_MIN || id > CMD_ID_MAX) return NULL;
+    uint16_t idx = s_cmd_index[id - CMD_ID_MIN];
+    return (idx == CMD_INDEX_NONE) ? NULL : &s_cmd_db[idx];
 }
 
 const char *cmd_category_name(cmd_category_t cat)
@@ -54,6 +62,13 @@ const char *cmd_category_name(cmd_category_t cat)
     return "Unknown";
 }
 
+const uint8_t *cmd_db_catalog_gz(size_t *len, const char **etag)
+{
+    *len = sizeof(s_cmd_catalog_gz);
+    *etag = CMD_CATALOG_ETAG;
+    return s_cmd_catalog_gz;
+}
+
 // ===================================================================
 // Mapping state
 // ===================================================================
@@ -61,8 +76,32 @@ const char *cmd_category_name(cmd_category_t cat)
 static mapping_entry_t s_mappings[MAX_MAPPINGS];
 static int s_mapping_count = 0;
 
+// Control ID -> index in s_mappings (-1 = unmapped), rebuilt on every change
+static int8_t s_mapping_by_control[DJ_CONTROL_COUNT];
+
+_Static_assert(MAX_MAPPINGS <= 127, "s_mapping_by_control holds int8_t indices");
+
+// Compiled dispatch table: everything an event needs, resolved when the
+// mapping changes (see compile_slot) so dispatch is one indexed load plus
+// the exec call.
+typedef struct mapping_slot mapping_slot_t;
+
+typedef void (*exec_fn_t)(const mapping_slot_t *slot, uint8_t control_id,
+                          dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val);
+
+struct mapping_slot {
+    const thetis_cmd_t *cmd;    // NULL = control not mapped
+    exec_fn_t exec;
+    int32_t   param;
+    uint8_t   led_note;         // LED mirroring toggle state (0 = none)
+    void     *state;            // bool* toggle, int32_t* encoder SET, vfo_state_t* FREQ
+};
+
+static mapping_slot_t s_slots[DJ_CONTROL_COUNT];
+
 // Toggle state tracker (tracks command ID, state, and CAT command for sync)
 #define TOGGLE_SLOTS 32
+_Static_assert(6 + TOGGLE_SLOTS <= CAT_TX_BATCH_MAX, "sync queries must fit one CAT batch");
 static struct {
     uint16_t id;
     bool state;
@@ -128,15 +167,20 @@ static int32_t *find_set_value(uint16_t cmd_id, int value_min, int value_max)
 #define VELOCITY_FAST_US   50000  // <= 50ms between ticks = 10x (fast turning)
 static int64_t s_last_freq_tick_us = 0;  // timestamp of last encoder tick
 
-// Mappings stored in NVS (survives firmware flash, unlike SPIFFS)
+// When the event being handled was posted (not when the engine task got to
+// it), so velocity and idle gaps measure the user, not queue delay
+static int64_t s_event_us = 0;
+
+// Mappings stored in NVS (survives firmware flash, unlike the www partition)
 
 // ===================================================================
 // Learn mode state
 // ===================================================================
 
-static bool s_learn_active = false;
+// Written only by the engine task; mapping_engine_is_learning() peeks
+static volatile bool s_learn_active = false;
 static uint16_t s_learn_command_id = 0;
-static int64_t s_learn_start_us = 0;
+static volatile int64_t s_learn_start_us = 0;
 #define LEARN_TIMEOUT_US (15 * 1000000LL)  // 15 seconds
 
 static mapping_learn_callback_t s_learn_cb = NULL;
@@ -146,13 +190,19 @@ static mapping_cat_callback_t s_cat_cb = NULL;
 // Helpers
 // ===================================================================
 
-static mapping_entry_t *find_mapping(const char *control_name)
+static void rebuild_mapping_index(void)
 {
+    memset(s_mapping_by_control, -1, sizeof(s_mapping_by_control));
     for (int i = 0; i < s_mapping_count; i++) {
-        if (strcmp(s_mappings[i].control_name, control_name) == 0)
-            return &s_mappings[i];
+        s_mapping_by_control[s_mappings[i].control_id] = (int8_t)i;
     }
-    return NULL;
+}
+
+static mapping_entry_t *find_mapping(uint8_t control_id)
+{
+    if (control_id >= DJ_CONTROL_COUNT) return NULL;
+    int8_t idx = s_mapping_by_control[control_id];
+    return idx >= 0 ? &s_mappings[idx] : NULL;
 }
 
 static int8_t encoder_delta(uint8_t old_val, uint8_t new_val)
@@ -182,7 +232,7 @@ static long snap_tune(long freq, int step, int direction)
 // Fast turning (short interval) = high multiplier, slow = 1x.
 static int velocity_multiplier(void)
 {
-    int64_t now = esp_timer_get_time();
+    int64_t now = s_event_us;
     int64_t interval = now - s_last_freq_tick_us;
     s_last_freq_tick_us = now;
 
@@ -215,9 +265,10 @@ static bool *find_toggle(uint16_t cmd_id, const char *cat_cmd)
 }
 
 // ===================================================================
-// Control name -> LED note lookup
+// Control -> LED note lookup
 // ===================================================================
 
+// Source table by name; resolved once into s_led_note_by_control
 static const struct { const char *control; uint8_t note; } s_led_map[] = {
     // Deck A
     {"Play_A",     LED_PLAY_A},
@@ -251,43 +302,39 @@ static const struct { const char *control; uint8_t note; } s_led_map[] = {
 };
 #define LED_MAP_COUNT (sizeof(s_led_map) / sizeof(s_led_map[0]))
 
-static uint8_t find_led_note(const char *control_name)
+static uint8_t s_led_note_by_control[DJ_CONTROL_COUNT];  // 0 = no LED
+
+static void build_led_index(void)
 {
+    memset(s_led_note_by_control, 0, sizeof(s_led_note_by_control));
     for (int i = 0; i < (int)LED_MAP_COUNT; i++) {
-        if (strcmp(s_led_map[i].control, control_name) == 0)
-            return s_led_map[i].note;
+        uint8_t id = dj_control_find(s_led_map[i].control);
+        if (id == DJ_CONTROL_NONE) {
+            ESP_LOGW(TAG, "LED map: unknown control %s", s_led_map[i].control);
+            continue;
+        }
+        s_led_note_by_control[id] = s_led_map[i].note;
     }
-    return 0;  // 0 = no LED for this control
 }
 
-// ===================================================================
-// Toggle LED sync helper
-// ===================================================================
-
-static void update_toggle_led(uint16_t cmd_id, bool state)
+static uint8_t find_led_note(uint8_t control_id)
 {
-    for (int i = 0; i < s_mapping_count; i++) {
-        if (s_mappings[i].command_id == cmd_id) {
-            uint8_t note = find_led_note(s_mappings[i].control_name);
-            if (note > 0) {
-                dj_led_set(note, state);
-            }
-        }
-    }
+    return control_id < DJ_CONTROL_COUNT ? s_led_note_by_control[control_id] : 0;
 }
 
 // ===================================================================
 // CAT command execution
 // ===================================================================
 
-static void notify_cat(const char *control_name, const thetis_cmd_t *cmd, const char *cat_str)
+static void notify_cat(uint8_t control_id, const thetis_cmd_t *cmd, const char *cat_str)
 {
-    if (s_cat_cb) s_cat_cb(control_name, cmd->name, cmd->exec_type, cat_str);
+    if (s_cat_cb) s_cat_cb(control_id, cmd->name, cmd->exec_type, cat_str);
 }
 
-static void exec_button(const thetis_cmd_t *cmd, const char *control_name,
-                        dj_control_type_t ctrl_type, uint8_t new_val)
+static void exec_button(const mapping_slot_t *slot, uint8_t control_id,
+                        dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val)
 {
+    const thetis_cmd_t *cmd = slot->cmd;
     char buf[32];
     // Only fire on button press (not release), or on any encoder/dial change
     if (ctrl_type == DJ_CTRL_BUTTON && new_val == 0) return;
@@ -298,7 +345,7 @@ static void exec_button(const thetis_cmd_t *cmd, const char *control_name,
         snprintf(buf, sizeof(buf), "%s;", cmd->cat_cmd);
     }
     cat_client_send(buf);
-    notify_cat(control_name, cmd, buf);
+    notify_cat(control_id, cmd, buf);
     ESP_LOGI(TAG, "CMD [%s] -> %s", cmd->name, buf);
     // Re-query step after ZZSU/ZZSD so local step stays in sync
     if (strcmp(cmd->cat_cmd, "ZZSU") == 0 || strcmp(cmd->cat_cmd, "ZZSD") == 0) {
@@ -306,24 +353,32 @@ static void exec_button(const thetis_cmd_t *cmd, const char *control_name,
     }
 }
 
-static void exec_toggle(const thetis_cmd_t *cmd, const char *control_name,
-                         dj_control_type_t ctrl_type, uint8_t new_val)
+static void exec_toggle(const mapping_slot_t *slot, uint8_t control_id,
+                        dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val)
 {
+    const thetis_cmd_t *cmd = slot->cmd;
     char buf[32];
     if (ctrl_type == DJ_CTRL_BUTTON && new_val == 0) return;
-    bool *state = find_toggle(cmd->id, cmd->cat_cmd);
+    bool *state = slot->state;
     if (!state) return;
     *state = !(*state);
     snprintf(buf, sizeof(buf), "%s%0*d;", cmd->cat_cmd,
              cmd->value_digits, *state ? cmd->value_max : cmd->value_min);
     cat_client_send(buf);
-    notify_cat(control_name, cmd, buf);
+    notify_cat(control_id, cmd, buf);
     ESP_LOGI(TAG, "TOGGLE [%s] -> %s (state=%d)", cmd->name, buf, *state);
+
+    // Update LED to reflect toggle state
+    if (slot->led_note > 0) {
+        dj_led_set(slot->led_note, *state);
+    }
 }
 
-static void exec_set(const thetis_cmd_t *cmd, const char *control_name,
-                     dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val, int32_t param)
+static void exec_set(const mapping_slot_t *slot, uint8_t control_id,
+                     dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val)
 {
+    const thetis_cmd_t *cmd = slot->cmd;
+    int32_t param = slot->param;
     char buf[32];
     int val;
     if (ctrl_type == DJ_CTRL_ENCODER) {
@@ -331,7 +386,7 @@ static void exec_set(const thetis_cmd_t *cmd, const char *control_name,
         int8_t delta = encoder_delta(old_val, new_val);
         if (delta == 0) return;
         int step = (param > 0) ? param : 1;
-        int32_t *tracked = find_set_value(cmd->id, cmd->value_min, cmd->value_max);
+        int32_t *tracked = slot->state;
         if (!tracked) return;
         *tracked += delta * step;
         if (*tracked > cmd->value_max) *tracked = cmd->value_max;
@@ -344,14 +399,16 @@ static void exec_set(const thetis_cmd_t *cmd, const char *control_name,
     }
     snprintf(buf, sizeof(buf), "%s%0*d;", cmd->cat_cmd,
              cmd->value_digits, val);
-    cat_client_send(buf);
-    notify_cat(control_name, cmd, buf);
+    cat_client_send_latest(buf);
+    notify_cat(control_id, cmd, buf);
     ESP_LOGD(TAG, "SET [%s] raw=%d -> val=%d -> %s", cmd->name, new_val, val, buf);
 }
 
-static void exec_freq(const thetis_cmd_t *cmd, const char *control_name,
-                      dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val, int32_t param)
+static void exec_freq(const mapping_slot_t *slot, uint8_t control_id,
+                      dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val)
 {
+    const thetis_cmd_t *cmd = slot->cmd;
+    int32_t param = slot->param;
     char buf[32];
     // Read-modify-write VFO frequency (same logic as midi2cat ChangeFreqVfoA/B)
     // Step from Thetis ZZAC, velocity-scaled by wheel speed
@@ -366,25 +423,18 @@ static void exec_freq(const thetis_cmd_t *cmd, const char *control_name,
     }
     if (delta == 0) return;
 
-    vfo_state_t *vfo = NULL;
-    const char *vfo_label = "?";
-    if (strcmp(cmd->cat_cmd, "ZZFA") == 0) {
-        vfo = &s_vfo_a;
-        vfo_label = "A";
-    } else if (strcmp(cmd->cat_cmd, "ZZFB") == 0) {
-        vfo = &s_vfo_b;
-        vfo_label = "B";
-    }
+    vfo_state_t *vfo = slot->state;  // Resolved from ZZFA/ZZFB at compile time
     if (!vfo) return;
+    const char *vfo_label = (vfo == &s_vfo_a) ? "A" : "B";
 
     // Check idle gap BEFORE velocity_multiplier() updates s_last_freq_tick_us
-    int64_t now_us = esp_timer_get_time();
+    int64_t now_us = s_event_us;
     int64_t gap = now_us - s_last_freq_tick_us;
 
     ESP_LOGI(TAG, "VFO_DBG [%s] VFO_%s tick: delta=%d old=%d new=%d synced=%d "
              "cached_freq=%ld gap=%lld ms",
              cmd->name, vfo_label, delta, old_val, new_val,
-             vfo->synced, vfo->freq, gap / 1000);
+             vfo->synced, vfo->freq, (long long)(gap / 1000));
 
     if (!vfo->synced) {
         ESP_LOGW(TAG, "VFO_DBG [%s] SKIPPED — VFO_%s not synced yet", cmd->name, vfo_label);
@@ -396,11 +446,11 @@ static void exec_freq(const thetis_cmd_t *cmd, const char *control_name,
     // response arrives before next tick so subsequent ticks use fresh data.
     if (gap > 1000000) {  // >1 second since last FREQ tick
         vfo->synced = false;
-        const char *query = (strcmp(cmd->cat_cmd, "ZZFA") == 0) ? "ZZFA;" : "ZZFB;";
+        const char *query = (vfo == &s_vfo_a) ? "ZZFA;" : "ZZFB;";
         cat_client_send(query);
         ESP_LOGI(TAG, "VFO_DBG [%s] RE-SYNC: gap=%lld ms > 1s, sent %s "
                  "invalidated VFO_%s (was %ld Hz)",
-                 cmd->name, gap / 1000, query, vfo_label, vfo->freq);
+                 cmd->name, (long long)(gap / 1000), query, vfo_label, vfo->freq);
         // Update timestamp so velocity_multiplier starts fresh after resync
         s_last_freq_tick_us = now_us;
         return;
@@ -417,15 +467,18 @@ static void exec_freq(const thetis_cmd_t *cmd, const char *control_name,
     if (vfo->freq < 100000) vfo->freq = 100000;
     if (vfo->freq > 54000000) vfo->freq = 54000000;
     snprintf(buf, sizeof(buf), "%s%011ld;", cmd->cat_cmd, vfo->freq);
-    cat_client_send(buf);
-    notify_cat(control_name, cmd, buf);
+    cat_client_send_latest(buf);
+    notify_cat(control_id, cmd, buf);
     ESP_LOGI(TAG, "VFO_DBG [%s] TUNE: %ld -> %ld Hz (dir=%d step=%d x%d=%d) cmd='%s'",
              cmd->name, old_freq, vfo->freq, direction, base_step, mult, step_hz, buf);
 }
 
-static void exec_wheel(const thetis_cmd_t *cmd, const char *control_name,
+#define WHEEL_STEP_MAX 10   // Most commands one wheel event sends
+
+static void exec_wheel(const mapping_slot_t *slot, uint8_t control_id,
                        dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val)
 {
+    const thetis_cmd_t *cmd = slot->cmd;
     char buf[32];
     int8_t delta = 0;
     if (ctrl_type == DJ_CTRL_ENCODER) {
@@ -438,25 +491,29 @@ static void exec_wheel(const thetis_cmd_t *cmd, const char *control_name,
     const char *c = (delta > 0) ? cmd->cat_cmd : cmd->cat_cmd2;
     if (!c) return;
     int count = abs(delta);
-    if (count > 10) count = 10;  // Sanity limit
-    for (int i = 0; i < count; i++) {
-        snprintf(buf, sizeof(buf), "%s;", c);
-        cat_client_send(buf);
-    }
-    notify_cat(control_name, cmd, buf);
+    if (count == 0) return;
+    if (count > WHEEL_STEP_MAX) count = WHEEL_STEP_MAX;  // Sanity limit
+    // Format once, queue count copies as one batch (one send())
+    snprintf(buf, sizeof(buf), "%s;", c);
+    const char *cmds[WHEEL_STEP_MAX];
+    for (int i = 0; i < count; i++) cmds[i] = buf;
+    cat_client_send_batch(cmds, count);
+    notify_cat(control_id, cmd, buf);
     ESP_LOGD(TAG, "WHEEL [%s] delta=%d x%d", cmd->name, delta, count);
 }
 
-static void exec_filter_width(const thetis_cmd_t *cmd, const char *control_name,
-                              dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val, int32_t param)
+static void exec_filter_width(const mapping_slot_t *slot, uint8_t control_id,
+                              dj_control_type_t ctrl_type, uint8_t old_val, uint8_t new_val)
 {
+    const thetis_cmd_t *cmd = slot->cmd;
+    int32_t param = slot->param;
     char buf[32];
     ESP_LOGI(TAG, "FW_DBG [%s] tick: ctrl_type=%d old=%d new=%d, synced=%d, lo=%d hi=%d width=%d",
-             control_name, ctrl_type, old_val, new_val, s_filter.synced,
+             dj_control_name(control_id), ctrl_type, old_val, new_val, s_filter.synced,
              s_filter.lo, s_filter.hi, s_filter.width);
     if (!s_filter.synced) {
-        cat_client_send("ZZFH;");
-        cat_client_send("ZZFL;");
+        static const char *const query[] = { "ZZFH;", "ZZFL;" };
+        cat_client_send_batch(query, 2);
         ESP_LOGW(TAG, "FW_DBG [%s] NOT SYNCED — querying ZZFH/ZZFL, skipping tick", cmd->name);
         return;
     }
@@ -492,26 +549,172 @@ static void exec_filter_width(const thetis_cmd_t *cmd, const char *control_name,
     snprintf(buf, sizeof(buf), "ZZSF%04d%04d;", center, width);
     ESP_LOGI(TAG, "FW_DBG [%s] result: center=%d width=%d CAT_CMD='%s'",
              cmd->name, center, width, buf);
-    cat_client_send(buf);
+    cat_client_send_latest(buf);
     // Update local tracking to reflect what Thetis will set
     s_filter.lo = center - width / 2;
     s_filter.hi = center + width / 2;
     if (s_filter.lo < 0) s_filter.lo = 0;
-    notify_cat(control_name, cmd, buf);
+    notify_cat(control_id, cmd, buf);
+}
+
+// ===================================================================
+// Compiled dispatch table
+// ===================================================================
+
+static const exec_fn_t s_exec_fns[] = {
+    [CMD_CAT_BUTTON]       = exec_button,
+    [CMD_CAT_TOGGLE]       = exec_toggle,
+    [CMD_CAT_SET]          = exec_set,
+    [CMD_CAT_FREQ]         = exec_freq,
+    [CMD_CAT_WHEEL]        = exec_wheel,
+    [CMD_CAT_FILTER_WIDTH] = exec_filter_width,
+};
+#define EXEC_FN_COUNT (sizeof(s_exec_fns) / sizeof(s_exec_fns[0]))
+
+// Resolve one control's mapping (or clear the slot if unmapped / unknown)
+static void compile_slot(uint8_t control_id)
+{
+    mapping_slot_t slot = {0};
+    const mapping_entry_t *m = find_mapping(control_id);
+    const thetis_cmd_t *cmd = m ? cmd_db_find(m->command_id) : NULL;
+
+    if (cmd && (unsigned)cmd->exec_type < EXEC_FN_COUNT) {
+        slot.cmd = cmd;
+        slot.exec = s_exec_fns[cmd->exec_type];
+        slot.param = m->param;
+
+        switch (cmd->exec_type) {
+        case CMD_CAT_TOGGLE:
+            slot.state = find_toggle(cmd->id, cmd->cat_cmd);
+            slot.led_note = find_led_note(control_id);
+            break;
+        case CMD_CAT_SET:
+            // Only encoders track the value (relative inc/dec)
+            if (dj_control_type(control_id) == DJ_CTRL_ENCODER) {
+                slot.state = find_set_value(cmd->id, cmd->value_min, cmd->value_max);
+            }
+            break;
+        case CMD_CAT_FREQ:
+            if (strcmp(cmd->cat_cmd, "ZZFA") == 0) slot.state = &s_vfo_a;
+            else if (strcmp(cmd->cat_cmd, "ZZFB") == 0) slot.state = &s_vfo_b;
+            break;
+        default:
+            break;
+        }
+    }
+    s_slots[control_id] = slot;
+}
+
+// ===================================================================
+// CAT response router
+// ===================================================================
+
+// Response prefix (packed by cat_cmd_key) -> everything that tracks it.
+// Rebuilt with the dispatch table, since toggle/SET slots and LEDs follow
+// the mappings, and whenever the LED meters change.
+#define ROUTE_TABLE_SIZE 128    // Power of two, > 2x worst case (5 + toggles + SETs + meters)
+#define ROUTE_MAX_LEDS   4
+
+enum {
+    ROUTE_VFO_A     = 1 << 0,
+    ROUTE_VFO_B     = 1 << 1,
+    ROUTE_STEP      = 1 << 2,
+    ROUTE_FILTER_HI = 1 << 3,
+    ROUTE_FILTER_LO = 1 << 4,
+};
+
+typedef struct {
+    uint32_t key;               // 0 = empty
+    uint8_t  flags;             // ROUTE_* fixed trackers
+    int8_t   toggle;            // s_toggles index, -1 = none
+    int8_t   set_slot;          // s_set_state index, -1 = none
+    int8_t   meter;             // LED meter index, -1 = none
+    uint8_t  led_count;
+    uint8_t  leds[ROUTE_MAX_LEDS];  // LED notes mirroring the toggle
+} cat_route_t;
+
+_Static_assert(TOGGLE_SLOTS <= 127 && SET_SLOTS <= 127, "route slot indices are int8_t");
+
+static cat_route_t s_routes[ROUTE_TABLE_SIZE];
+
+static inline uint32_t route_hash(uint32_t key)
+{
+    return (key * 2654435761u) >> 25;   // Top 7 bits -> 0..127
+}
+
+static cat_route_t *route_find(uint32_t key)
+{
+    for (uint32_t i = route_hash(key), n = 0; n < ROUTE_TABLE_SIZE; i = (i + 1) & (ROUTE_TABLE_SIZE - 1), n++) {
+        if (s_routes[i].key == key) return &s_routes[i];
+        if (s_routes[i].key == 0) return NULL;
+    }
+    return NULL;
+}
+
+static cat_route_t *route_add(const char *cat_cmd)
+{
+    uint32_t key = cat_cmd_key(cat_cmd);
+    if (key == 0) return NULL;
+    for (uint32_t i = route_hash(key), n = 0; n < ROUTE_TABLE_SIZE; i = (i + 1) & (ROUTE_TABLE_SIZE - 1), n++) {
+        if (s_routes[i].key == key) return &s_routes[i];
+        if (s_routes[i].key == 0) {
+            s_routes[i].key = key;
+            return &s_routes[i];
+        }
+    }
+    return NULL;
+}
+
+static void build_routes(void)
+{
+    memset(s_routes, 0, sizeof(s_routes));
+    for (int i = 0; i < ROUTE_TABLE_SIZE; i++) {
+        s_routes[i].toggle = -1;
+        s_routes[i].set_slot = -1;
+        s_routes[i].meter = -1;
+    }
+
+    route_add("ZZFA")->flags |= ROUTE_VFO_A;
+    route_add("ZZFB")->flags |= ROUTE_VFO_B;
+    route_add("ZZAC")->flags |= ROUTE_STEP;
+    route_add("ZZFH")->flags |= ROUTE_FILTER_HI;
+    route_add("ZZFL")->flags |= ROUTE_FILTER_LO;
+
+    // First toggle per prefix wins, as does the first SET slot
+    for (int t = 0; t < s_toggle_count; t++) {
+        if (s_toggles[t].cat_cmd[0] == '\0') continue;
+        cat_route_t *r = route_add(s_toggles[t].cat_cmd);
+        if (!r || r->toggle >= 0) continue;
+        r->toggle = t;
+        for (int c = 0; c < DJ_CONTROL_COUNT; c++) {
+            if (s_slots[c].state == &s_toggles[t].state && s_slots[c].led_note > 0 &&
+                r->led_count < ROUTE_MAX_LEDS) {
+                r->leds[r->led_count++] = s_slots[c].led_note;
+            }
+        }
+    }
+
+    for (int i = 0; i < s_set_count; i++) {
+        const thetis_cmd_t *sc = cmd_db_find(s_set_state[i].cmd_id);
+        if (!sc) continue;
+        cat_route_t *r = route_add(sc->cat_cmd);
+        if (r && r->set_slot < 0) r->set_slot = i;
+    }
+
+    led_meter_def_t meters[LED_METER_MAX];
+    int meter_count = led_meter_get_defs(meters, LED_METER_MAX);
+    for (int i = 0; i < meter_count; i++) {
+        cat_route_t *r = route_add(meters[i].cat_cmd);
+        if (r && r->meter < 0) r->meter = i;
+    }
 }
 
-static void execute_command(const thetis_cmd_t *cmd, const char *control_name,
-                            dj_control_type_t ctrl_type,
-                            uint8_t old_val, uint8_t new_val, int32_t param)
+static void compile_all(void)
 {
-    switch (cmd->exec_type) {
-    case CMD_CAT_BUTTON:       exec_button(cmd, control_name, ctrl_type, new_val); break;
-    case CMD_CAT_TOGGLE:       exec_toggle(cmd, control_name, ctrl_type, new_val); break;
-    case CMD_CAT_SET:          exec_set(cmd, control_name, ctrl_type, old_val, new_val, param); break;
-    case CMD_CAT_FREQ:         exec_freq(cmd, control_name, ctrl_type, old_val, new_val, param); break;
-    case CMD_CAT_WHEEL:        exec_wheel(cmd, control_name, ctrl_type, old_val, new_val); break;
-    case CMD_CAT_FILTER_WIDTH: exec_filter_width(cmd, control_name, ctrl_type, old_val, new_val, param); break;
+    for (int i = 0; i < DJ_CONTROL_COUNT; i++) {
+        compile_slot(i);
     }
+    build_routes();
 }
 
 // ===================================================================
@@ -521,17 +724,22 @@ static void execute_command(const thetis_cmd_t *cmd, const char *control_name,
 static void add_default(const char *name, uint16_t cmd_id, int32_t param)
 {
     if (s_mapping_count >= MAX_MAPPINGS) return;
+    uint8_t id = dj_control_find(name);
+    if (id == DJ_CONTROL_NONE) {
+        ESP_LOGW(TAG, "Default mapping: unknown control %s", name);
+        return;
+    }
     mapping_entry_t *e = &s_mappings[s_mapping_count++];
-    strncpy(e->control_name, name, sizeof(e->control_name) - 1);
-    e->control_name[sizeof(e->control_name) - 1] = '\0';
+    e->control_id = id;
     e->command_id = cmd_id;
     e->param = param;
 }
 
-void mapping_engine_reset_defaults(void)
+static void engine_reset_defaults(void)
 {
     s_mapping_count = 0;
     memset(s_mappings, 0, sizeof(s_mappings));
+    led_meter_set_defs(NULL, 0);   // No meters unless the user defines them
 
     // -- Deck A --  (CMD_CAT_FREQ: param = Hz per encoder tick)
     add_default("Jog_A",    100, 10);      // VFO A Tune (ZZFA), 10 Hz/tick
@@ -570,14 +778,16 @@ void mapping_engine_reset_defaults(void)
     add_default("FWD_B",    219, 0);       // Band Up (ZZBU)
     add_default("RWD_B",    216, 0);       // Band Down (ZZBD)
 
+    rebuild_mapping_index();
+    compile_all();
     ESP_LOGI(TAG, "Default mappings loaded (%d entries)", s_mapping_count);
 }
 
 // ===================================================================
-// NVS persistence (survives firmware flash, unlike SPIFFS www partition)
+// NVS persistence (survives firmware flash, unlike the www partition)
 // ===================================================================
 
-esp_err_t mapping_engine_save(void)
+static esp_err_t engine_save(void)
 {
     cJSON *arr = cJSON_CreateArray();
     if (!arr) return ESP_ERR_NO_MEM;
@@ -585,7 +795,7 @@ esp_err_t mapping_engine_save(void)
     for (int i = 0; i < s_mapping_count; i++) {
         const mapping_entry_t *e = &s_mappings[i];
         cJSON *obj = cJSON_CreateObject();
-        cJSON_AddStringToObject(obj, "c", e->control_name);
+        cJSON_AddStringToObject(obj, "c", dj_control_name(e->control_id));
         cJSON_AddNumberToObject(obj, "id", e->command_id);
         if (e->param != 0) {
             cJSON_AddNumberToObject(obj, "p", e->param);
@@ -593,6 +803,13 @@ esp_err_t mapping_engine_save(void)
         cJSON_AddItemToArray(arr, obj);
     }
 
+    // LED meters go in the same array ({"m":...} entries; older firmware skips them)
+    led_meter_def_t meters[LED_METER_MAX];
+    int meter_count = led_meter_get_defs(meters, LED_METER_MAX);
+    for (int i = 0; i < meter_count; i++) {
+        cJSON_AddItemToArray(arr, led_meter_to_json(&meters[i]));
+    }
+
     char *json = cJSON_PrintUnformatted(arr);
     cJSON_Delete(arr);
     if (!json) return ESP_ERR_NO_MEM;
@@ -609,7 +826,9 @@ esp_err_t mapping_engine_save(void)
     return ret;
 }
 
-esp_err_t mapping_engine_load(void)
+static esp_err_t engine_set(const mapping_entry_t *entry);
+
+static esp_err_t engine_load(void)
 {
     size_t len = 0;
     char *json = config_get_blob(CFG_KEY_MAPPINGS, &len);
@@ -629,8 +848,19 @@ esp_err_t mapping_engine_load(void)
 
     // Overlay user mappings on top of defaults (don't clear — defaults already loaded)
     int user_count = 0;
+    led_meter_def_t meters[LED_METER_MAX];
+    int meter_count = 0;
     cJSON *item;
     cJSON_ArrayForEach(item, arr) {
+        if (cJSON_GetObjectItem(item, "m")) {
+            if (meter_count < LED_METER_MAX && led_meter_from_json(item, &meters[meter_count])) {
+                meter_count++;
+            } else {
+                ESP_LOGW(TAG, "Invalid or extra LED meter, skipping");
+            }
+            continue;
+        }
+
         cJSON *c = cJSON_GetObjectItem(item, "c");
         cJSON *id = cJSON_GetObjectItem(item, "id");
         cJSON *p = cJSON_GetObjectItem(item, "p");
@@ -645,47 +875,42 @@ esp_err_t mapping_engine_load(void)
                 continue;
             }
 
+            uint8_t control_id = dj_control_find(c->valuestring);
+            if (control_id == DJ_CONTROL_NONE) {
+                ESP_LOGW(TAG, "Unknown control %s, skipping", c->valuestring);
+                continue;
+            }
+
             mapping_entry_t entry = {0};
-            strncpy(entry.control_name, c->valuestring, sizeof(entry.control_name) - 1);
+            entry.control_id = control_id;
             entry.command_id = cmd_id;
             entry.param = (p && cJSON_IsNumber(p)) ? (int32_t)p->valuedouble : 0;
-            mapping_engine_set(&entry);  // Overwrites existing or appends
+            engine_set(&entry);  // Overwrites existing or appends
             user_count++;
         }
     }
 
     cJSON_Delete(arr);
-    ESP_LOGI(TAG, "Overlaid %d user mappings from NVS (total %d)", user_count, s_mapping_count);
+    if (meter_count > 0 && led_meter_set_defs(meters, meter_count) == ESP_OK) build_routes();
+    ESP_LOGI(TAG, "Overlaid %d user mappings from NVS (total %d), %d LED meters",
+             user_count, s_mapping_count, meter_count);
     return ESP_OK;
 }
 
 // ===================================================================
-// Public API
+// Event handlers — run only on the engine task
 // ===================================================================
 
-esp_err_t mapping_engine_init(void)
-{
-    // Always start from defaults, then overlay user mappings on top
-    mapping_engine_reset_defaults();
-    mapping_engine_load();  // Overlays user customizations (no-op if no file)
-
-    ESP_LOGI(TAG, "Mapping engine initialized (%d mappings, %d commands in DB)",
-             s_mapping_count, (int)CMD_DB_COUNT);
-    return ESP_OK;
-}
-
-void mapping_engine_on_control(
-    const char *name,
+static void handle_control(
+    uint8_t control_id,
     dj_control_type_t control_type,
-    uint8_t control_index,
     uint8_t old_value,
     uint8_t new_value)
 {
     // --- Learn mode: capture the first control that changes ---
     if (s_learn_active) {
         // Check timeout
-        int64_t now = esp_timer_get_time();
-        if ((now - s_learn_start_us) > LEARN_TIMEOUT_US) {
+        if ((s_event_us - s_learn_start_us) > LEARN_TIMEOUT_US) {
             s_learn_active = false;
             ESP_LOGI(TAG, "Learn mode timed out");
             return;
@@ -704,22 +929,22 @@ void mapping_engine_on_control(
         const thetis_cmd_t *cmd = cmd_db_find(s_learn_command_id);
         if (cmd) {
             mapping_entry_t entry = {0};
-            strncpy(entry.control_name, name, sizeof(entry.control_name) - 1);
+            entry.control_id = control_id;
             entry.command_id = s_learn_command_id;
             // Set sensible default param for freq commands
             if (cmd->exec_type == CMD_CAT_FREQ) {
                 if (control_type == DJ_CTRL_ENCODER) entry.param = 10;
                 else entry.param = 100;
             }
-            mapping_engine_set(&entry);
-            esp_err_t save_ret = mapping_engine_save();
+            engine_set(&entry);
+            esp_err_t save_ret = engine_save();
 
             ESP_LOGI(TAG, "Learned: %s -> [%d] %s (exec_type=%d, save=%s)",
-                     name, cmd->id, cmd->name, cmd->exec_type,
+                     dj_control_name(control_id), cmd->id, cmd->name, cmd->exec_type,
                      save_ret == ESP_OK ? "OK" : "FAIL");
 
             if (s_learn_cb) {
-                s_learn_cb(name, cmd->id, cmd->name);
+                s_learn_cb(control_id, cmd->id, cmd->name);
             }
         }
 
@@ -728,61 +953,47 @@ void mapping_engine_on_control(
     }
 
     // --- Normal dispatch ---
-    mapping_entry_t *m = find_mapping(name);
-    if (!m) return;
-
-    const thetis_cmd_t *cmd = cmd_db_find(m->command_id);
-    if (!cmd) return;
+    if (control_id >= DJ_CONTROL_COUNT) return;
+    const mapping_slot_t *slot = &s_slots[control_id];
+    if (!slot->cmd) return;
 
-    execute_command(cmd, name, control_type, old_value, new_value, m->param);
-
-    // Update LED to reflect toggle state
-    uint8_t led_note = find_led_note(name);
-    if (led_note > 0 && cmd->exec_type == CMD_CAT_TOGGLE) {
-        bool *state = find_toggle(cmd->id, cmd->cat_cmd);
-        if (state) {
-            dj_led_set(led_note, *state);
-        }
-    }
+    slot->exec(slot, control_id, control_type, old_value, new_value);
 }
 
-const mapping_entry_t *mapping_engine_get_table(int *count)
+static esp_err_t engine_set(const mapping_entry_t *entry)
 {
-    if (count) *count = s_mapping_count;
-    return s_mappings;
-}
+    if (entry->control_id >= DJ_CONTROL_COUNT) return ESP_ERR_INVALID_ARG;
 
-esp_err_t mapping_engine_set(const mapping_entry_t *entry)
-{
-    mapping_entry_t *existing = find_mapping(entry->control_name);
+    mapping_entry_t *existing = find_mapping(entry->control_id);
     if (existing) {
         memcpy(existing, entry, sizeof(mapping_entry_t));
-        return ESP_OK;
+    } else {
+        if (s_mapping_count >= MAX_MAPPINGS) return ESP_ERR_NO_MEM;
+        s_mapping_by_control[entry->control_id] = (int8_t)s_mapping_count;
+        memcpy(&s_mappings[s_mapping_count++], entry, sizeof(mapping_entry_t));
     }
-    if (s_mapping_count >= MAX_MAPPINGS) return ESP_ERR_NO_MEM;
-    memcpy(&s_mappings[s_mapping_count++], entry, sizeof(mapping_entry_t));
+    compile_slot(entry->control_id);
+    build_routes();
     return ESP_OK;
 }
 
-esp_err_t mapping_engine_remove(const char *control_name)
+static esp_err_t engine_remove(uint8_t control_id)
 {
-    for (int i = 0; i < s_mapping_count; i++) {
-        if (strcmp(s_mappings[i].control_name, control_name) == 0) {
-            for (int j = i; j < s_mapping_count - 1; j++) {
-                s_mappings[j] = s_mappings[j + 1];
-            }
-            s_mapping_count--;
-            return ESP_OK;
-        }
+    mapping_entry_t *m = find_mapping(control_id);
+    if (!m) return ESP_ERR_NOT_FOUND;
+
+    int i = (int)(m - s_mappings);
+    for (int j = i; j < s_mapping_count - 1; j++) {
+        s_mappings[j] = s_mappings[j + 1];
     }
-    return ESP_ERR_NOT_FOUND;
+    s_mapping_count--;
+    rebuild_mapping_index();
+    compile_slot(control_id);
+    build_routes();
+    return ESP_OK;
 }
 
-// ===================================================================
-// Learn mode
-// ===================================================================
-
-void mapping_engine_start_learn(uint16_t command_id)
+static void handle_learn_start(uint16_t command_id)
 {
     const thetis_cmd_t *cmd = cmd_db_find(command_id);
     if (!cmd) {
@@ -790,47 +1001,20 @@ void mapping_engine_start_learn(uint16_t command_id)
         return;
     }
     s_learn_command_id = command_id;
-    s_learn_start_us = esp_timer_get_time();
+    s_learn_start_us = s_event_us;
     s_learn_active = true;
     ESP_LOGI(TAG, "Learn mode started for [%d] %s", cmd->id, cmd->name);
 }
 
-bool mapping_engine_is_learning(void)
-{
-    if (!s_learn_active) return false;
-    // Auto-expire
-    if ((esp_timer_get_time() - s_learn_start_us) > LEARN_TIMEOUT_US) {
-        s_learn_active = false;
-        return false;
-    }
-    return true;
-}
-
-void mapping_engine_cancel_learn(void)
-{
-    s_learn_active = false;
-    ESP_LOGI(TAG, "Learn mode cancelled");
-}
-
-void mapping_engine_set_learn_callback(mapping_learn_callback_t cb)
-{
-    s_learn_cb = cb;
-}
-
-void mapping_engine_set_cat_callback(mapping_cat_callback_t cb)
-{
-    s_cat_cb = cb;
-}
-
-// ===================================================================
 // CAT response handler — sync VFO freq and tuning step from Thetis
-// ===================================================================
-
-void mapping_engine_on_cat_response(const char *cmd, const char *value)
+static void handle_cat_response(const char *cmd, const char *value)
 {
     if (!value || value[0] == '\0') return;
 
-    if (strcmp(cmd, "ZZFA") == 0) {
+    const cat_route_t *r = route_find(cat_cmd_key(cmd));
+    if (!r) return;
+
+    if (r->flags & ROUTE_VFO_A) {
         long f = atol(value);
         ESP_LOGI(TAG, "VFO_DBG RESPONSE ZZFA: raw='%s' parsed=%ld (prev=%ld synced=%d)",
                  value, f, s_vfo_a.freq, s_vfo_a.synced);
@@ -838,7 +1022,7 @@ void mapping_engine_on_cat_response(const char *cmd, const char *value)
             s_vfo_a.freq = f;
             s_vfo_a.synced = true;
         }
-    } else if (strcmp(cmd, "ZZFB") == 0) {
+    } else if (r->flags & ROUTE_VFO_B) {
         long f = atol(value);
         ESP_LOGI(TAG, "VFO_DBG RESPONSE ZZFB: raw='%s' parsed=%ld (prev=%ld synced=%d)",
                  value, f, s_vfo_b.freq, s_vfo_b.synced);
@@ -846,19 +1030,19 @@ void mapping_engine_on_cat_response(const char *cmd, const char *value)
             s_vfo_b.freq = f;
             s_vfo_b.synced = true;
         }
-    } else if (strcmp(cmd, "ZZAC") == 0) {
+    } else if (r->flags & ROUTE_STEP) {
         int idx = atoi(value);
         if (idx >= 0 && idx < (int)STEP_TABLE_SIZE) {
             s_tune_step_hz = s_step_table[idx];
             ESP_LOGI(TAG, "Sync tune step = %d Hz (index %d)", s_tune_step_hz, idx);
         }
-    } else if (strcmp(cmd, "ZZFH") == 0) {
+    } else if (r->flags & ROUTE_FILTER_HI) {
         s_filter.hi = atoi(value);
         s_filter.synced = true;
         s_filter.width = 0;  // reset so next tick re-derives from actual edges
         ESP_LOGI(TAG, "FW_DBG Sync ZZFH: filter_hi=%d raw='%s' (synced=%d, lo=%d)",
                  s_filter.hi, value, s_filter.synced, s_filter.lo);
-    } else if (strcmp(cmd, "ZZFL") == 0) {
+    } else if (r->flags & ROUTE_FILTER_LO) {
         s_filter.lo = atoi(value);
         s_filter.synced = true;
         s_filter.width = 0;  // reset so next tick re-derives from actual edges
@@ -866,51 +1050,516 @@ void mapping_engine_on_cat_response(const char *cmd, const char *value)
                  s_filter.lo, value, s_filter.synced, s_filter.hi);
     }
 
-    // Generic toggle sync: if response matches a tracked toggle, update state + LED
-    for (int i = 0; i < s_toggle_count; i++) {
-        if (s_toggles[i].cat_cmd[0] != '\0' && strcmp(cmd, s_toggles[i].cat_cmd) == 0) {
-            bool new_state = (atoi(value) != 0);
-            if (s_toggles[i].state != new_state) {
-                s_toggles[i].state = new_state;
-                update_toggle_led(s_toggles[i].id, new_state);
-                ESP_LOGI(TAG, "Sync toggle %s = %d", cmd, new_state);
+    // Toggle sync: update state + the LEDs of every control mapped to it
+    if (r->toggle >= 0) {
+        bool new_state = (atoi(value) != 0);
+        if (s_toggles[r->toggle].state != new_state) {
+            s_toggles[r->toggle].state = new_state;
+            for (int i = 0; i < r->led_count; i++) {
+                dj_led_set(r->leds[i], new_state);
             }
-            break;
+            ESP_LOGI(TAG, "Sync toggle %s = %d", cmd, new_state);
         }
     }
 
-    // Generic SET value sync: update tracked encoder-set values from Thetis responses
-    for (int i = 0; i < s_set_count; i++) {
-        const thetis_cmd_t *sc = cmd_db_find(s_set_state[i].cmd_id);
-        if (sc && strcmp(cmd, sc->cat_cmd) == 0) {
-            s_set_state[i].value = atoi(value);
-            ESP_LOGI(TAG, "Sync SET %s = %d", cmd, s_set_state[i].value);
-            break;
-        }
+    // SET value sync: update tracked encoder-set value from Thetis
+    if (r->set_slot >= 0) {
+        s_set_state[r->set_slot].value = atoi(value);
+        ESP_LOGI(TAG, "Sync SET %s = %d", cmd, s_set_state[r->set_slot].value);
+    }
+
+    if (r->meter >= 0) {
+        led_meter_on_value(r->meter, value, s_event_us);
     }
 }
 
-void mapping_engine_request_sync(void)
+// LED meters: push rate-limited bar changes, send the polls that are due
+static void handle_meter_tick(void)
+{
+    const char *queries[LED_METER_MAX];
+    int n = led_meter_tick(esp_timer_get_time(), queries, LED_METER_MAX);
+    if (n > 0) cat_client_send_batch(queries, n);
+}
+
+static void handle_sync(void)
 {
     ESP_LOGI(TAG, "Requesting VFO/step/filter/toggle sync from Thetis");
     s_vfo_a.synced = false;
     s_vfo_b.synced = false;
     s_filter.synced = false;
-    cat_client_send("ZZFA;");
-    cat_client_send("ZZFB;");
+
+    // Everything goes out as one batch
+    const char *cmds[6 + TOGGLE_SLOTS];
+    int n = 0;
+    cmds[n++] = "ZZFA;";
+    cmds[n++] = "ZZFB;";
     // Set tuning step to 10 Hz (index 2), then query back to confirm
-    cat_client_send("ZZAC02;");
-    cat_client_send("ZZAC;");
+    cmds[n++] = "ZZAC02;";
+    cmds[n++] = "ZZAC;";
     // Query filter edges for FILTER_WIDTH exec type
-    cat_client_send("ZZFH;");
-    cat_client_send("ZZFL;");
+    cmds[n++] = "ZZFH;";
+    cmds[n++] = "ZZFL;";
 
-    // Query all tracked toggle states
+    // Query all tracked toggle states (prefix only: ';' is appended)
     for (int i = 0; i < s_toggle_count; i++) {
         if (s_toggles[i].cat_cmd[0] != '\0') {
-            char buf[8];
-            snprintf(buf, sizeof(buf), "%s;", s_toggles[i].cat_cmd);
-            cat_client_send(buf);
+            cmds[n++] = s_toggles[i].cat_cmd;
         }
     }
+    cat_client_send_batch(cmds, n);
+}
+
+// ===================================================================
+// Engine task — sole owner of every piece of state above. USB, CAT and
+// HTTP callers only post events; nothing here needs a lock.
+// ===================================================================
+
+#define ENGINE_QUEUE_DEPTH  64
+#define ENGINE_POST_WAIT_MS 10   // How long a full queue may hold up a poster
+#define ENGINE_VALUE_MAX    16   // Longest tracked CAT value: ZZFA/ZZFB, 11 digits
+
+typedef enum {
+    EV_CONTROL = 0,
+    EV_CAT_RESPONSE,
+    EV_SYNC,
+    EV_LEARN_START,
+    EV_LEARN_CANCEL,
+    EV_SET,             // Calls: the poster waits for the result
+    EV_REMOVE,
+    EV_RESET_DEFAULTS,
+    EV_SAVE,
+    EV_GET_TABLE,
+    EV_FLUSH,
+    EV_GET_METERS,
+    EV_SET_METERS,
+} engine_event_type_t;
+
+typedef struct {
+    uint8_t    type;            // engine_event_type_t
+    int64_t    posted_us;
+    esp_err_t *result;          // Calls only: where to store the result
+    union {
+        struct {
+            uint8_t id;
+            uint8_t type;       // dj_control_type_t
+            uint8_t old_value;
+            uint8_t new_value;
+            bool    merged;     // Values are in s_ctrl_slots[id] (dials, encoders)
+            int64_t usb_us;     // Arrival of the USB packet that carried it
+        } control;
+        struct {
+            char cmd[5];
+            char value[ENGINE_VALUE_MAX];
+        } cat;
+        uint16_t        command_id;
+        uint8_t         control_id;
+        mapping_entry_t entry;
+        struct {
+            mapping_entry_t *out;
+            int              max;
+            int             *count;
+        } table;
+        struct {
+            led_meter_def_t *defs;  // Get: filled; set: read (the caller waits)
+            int              max;   // Get: room in defs; set: how many
+            int             *count;
+        } meters;
+    };
+} engine_event_t;
+
+static QueueHandle_t     s_queue = NULL;
+static SemaphoreHandle_t s_call_lock = NULL;   // One call in flight at a time
+static SemaphoreHandle_t s_call_done = NULL;   // Given by the task when a call is done
+
+// Queue counters: dropped and coalesced are bumped by posters, the rest
+// only by the task
+static atomic_uint s_ev_dropped;
+static atomic_uint s_ev_coalesced;
+static uint32_t    s_ev_handled = 0;
+static uint32_t    s_ev_high_water = 0;
+static uint32_t    s_ev_latency_max_us = 0;
+static uint32_t    s_ev_latency_avg_us = 0;
+static uint64_t    s_ev_latency_sum_us = 0;
+
+// ----- Dial / encoder coalescing -----
+//
+// While a dial or encoder event is still queued, further changes of that
+// control only update its slot (like the CAT client's latest-value slots),
+// so a busy queue never loses wheel steps. One word, swapped with CAS by
+// the poster and taken whole by the task:
+//   bits  0-7   newest raw value
+//   bits  8-15  packets merged (0 = nothing pending, saturates)
+//   bits 16-31  encoder: sum of the deltas (int16); dial: raw value before
+//               the first merged change
+//   bits 32-63  low 32 bits of the newest packet's post time
+// An encoder's merged steps are replayed one per packet with their times
+// spread out, so per-tick handlers (VFO tuning) and the velocity scaling
+// see the same steps as without coalescing.
+
+#define SLOT_TICKS_MAX  255
+
+static _Atomic uint64_t s_ctrl_slots[DJ_CONTROL_COUNT];
+
+static uint64_t slot_pack(uint8_t new_value, unsigned ticks, uint16_t aux, int64_t now_us)
+{
+    return new_value | (uint64_t)ticks << 8 | (uint64_t)aux << 16 |
+           (uint64_t)(uint32_t)now_us << 32;
+}
+
+// Merge a change into the control's slot. Returns true if an event for it
+// is already queued (nothing to post).
+static bool slot_merge(uint8_t id, dj_control_type_t type, uint8_t old_value,
+                       uint8_t new_value, int64_t now_us)
+{
+    _Atomic uint64_t *slot = &s_ctrl_slots[id];
+    uint64_t cur = atomic_load_explicit(slot, memory_order_acquire);
+    for (;;) {
+        unsigned ticks = (cur >> 8) & 0xFF;
+        uint64_t next;
+        if (ticks == 0) {
+            uint16_t aux = type == DJ_CTRL_ENCODER ? (uint16_t)encoder_delta(old_value, new_value)
+                                                   : old_value;
+            next = slot_pack(new_value, 1, aux, now_us);
+        } else if (type == DJ_CTRL_ENCODER) {
+            // Cap the sum at what the merged packets could carry (127 each)
+            int sum = (int16_t)(cur >> 16) + encoder_delta(old_value, new_value);
+            if (ticks < SLOT_TICKS_MAX) ticks++;
+            if (sum > 127 * (int)ticks) sum = 127 * (int)ticks;
+            if (sum < -127 * (int)ticks) sum = -127 * (int)ticks;
+            next = slot_pack(new_value, ticks, (uint16_t)sum, now_us);
+        } else {
+            if (ticks < SLOT_TICKS_MAX) ticks++;
+            next = slot_pack(new_value, ticks, (uint16_t)(cur >> 16), now_us);
+        }
+        if (atomic_compare_exchange_weak_explicit(slot, &cur, next, memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            return ((cur >> 8) & 0xFF) != 0;
+        }
+    }
+}
+
+// Task side: take the slot and dispatch what was merged since the post
+static void handle_merged_control(uint8_t id, dj_control_type_t type, int64_t first_us)
+{
+    uint64_t w = atomic_exchange_explicit(&s_ctrl_slots[id], 0, memory_order_acq_rel);
+    unsigned ticks = (w >> 8) & 0xFF;
+    if (ticks == 0) return;
+    uint8_t new_value = w & 0xFF;
+    int64_t last_us = first_us + (uint32_t)((uint32_t)(w >> 32) - (uint32_t)first_us);
+
+    if (type != DJ_CTRL_ENCODER) {
+        handle_control(id, type, (uint8_t)(w >> 16), new_value);
+        return;
+    }
+    int sum = (int16_t)(w >> 16);
+    uint8_t raw = (uint8_t)(new_value - sum);
+    for (unsigned i = 0; i < ticks; i++) {
+        // Spread the sum evenly, the remainder on the first steps. Steps
+        // that cancelled out (+1/-1 jitter) are not replayed.
+        int step = sum / (int)ticks + ((int)i < abs(sum % (int)ticks) ? (sum < 0 ? -1 : 1) : 0);
+        if (ticks > 1) s_event_us = first_us + (last_us - first_us) * i / (ticks - 1);
+        // A saturated count stands for more packets than ticks: split its
+        // large steps so exec_wheel's per-event cap does not eat them
+        int chunk = ticks == SLOT_TICKS_MAX ? WHEEL_STEP_MAX : abs(step);
+        while (step != 0) {
+            int part = step > chunk ? chunk : step < -chunk ? -chunk : step;
+            handle_control(id, type, raw, (uint8_t)(raw + part));
+            raw = (uint8_t)(raw + part);
+            step -= part;
+        }
+    }
+}
+
+static esp_err_t handle_event(const engine_event_t *ev)
+{
+    switch (ev->type) {
+    case EV_CONTROL:
+        if (ev->control.merged) {
+            handle_merged_control(ev->control.id, (dj_control_type_t)ev->control.type,
+                                  ev->posted_us);
+        } else {
+            handle_control(ev->control.id, (dj_control_type_t)ev->control.type,
+                           ev->control.old_value, ev->control.new_value);
+        }
+        return ESP_OK;
+    case EV_CAT_RESPONSE:
+        handle_cat_response(ev->cat.cmd, ev->cat.value);
+        return ESP_OK;
+    case EV_SYNC:
+        handle_sync();
+        return ESP_OK;
+    case EV_LEARN_START:
+        handle_learn_start(ev->command_id);
+        return ESP_OK;
+    case EV_LEARN_CANCEL:
+        s_learn_active = false;
+        ESP_LOGI(TAG, "Learn mode cancelled");
+        return ESP_OK;
+    case EV_SET:
+        return engine_set(&ev->entry);
+    case EV_REMOVE:
+        return engine_remove(ev->control_id);
+    case EV_RESET_DEFAULTS:
+        engine_reset_defaults();
+        return ESP_OK;
+    case EV_SAVE:
+        return engine_save();
+    case EV_GET_TABLE: {
+        int n = s_mapping_count < ev->table.max ? s_mapping_count : ev->table.max;
+        if (n > 0) memcpy(ev->table.out, s_mappings, n * sizeof(mapping_entry_t));
+        *ev->table.count = s_mapping_count;
+        return ESP_OK;
+    }
+    case EV_FLUSH:
+        return ESP_OK;
+    case EV_GET_METERS:
+        *ev->meters.count = led_meter_get_defs(ev->meters.defs, ev->meters.max);
+        return ESP_OK;
+    case EV_SET_METERS: {
+        esp_err_t err = led_meter_set_defs(ev->meters.defs, ev->meters.max);
+        if (err == ESP_OK) build_routes();
+        return err;
+    }
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static void engine_task(void *arg)
+{
+    engine_event_t ev;
+    while (1) {
+        // With LED meters, wake up at least every meter tick
+        bool meters = led_meter_get_defs(NULL, 0) > 0;
+        if (meters) handle_meter_tick();
+        TickType_t wait = meters ? pdMS_TO_TICKS(LED_METER_TICK_MS) : portMAX_DELAY;
+        if (xQueueReceive(s_queue, &ev, wait) != pdTRUE) continue;
+
+        int64_t now = esp_timer_get_time();
+        uint32_t latency = (uint32_t)(now - ev.posted_us);
+        uint32_t depth = uxQueueMessagesWaiting(s_queue) + 1;
+        if (depth > s_ev_high_water) s_ev_high_water = depth;
+        if (latency > s_ev_latency_max_us) s_ev_latency_max_us = latency;
+        s_ev_latency_sum_us += latency;
+        s_ev_handled++;
+        s_ev_latency_avg_us = (uint32_t)(s_ev_latency_sum_us / s_ev_handled);
+        if (ev.type == EV_CONTROL && ev.control.usb_us) {
+            latency_record(LATENCY_USB_TO_DISPATCH, now - ev.control.usb_us);
+        }
+
+        s_event_us = ev.posted_us;
+        esp_err_t ret = handle_event(&ev);
+        if (ev.result) {
+            *ev.result = ret;
+            xSemaphoreGive(s_call_done);
+        }
+    }
+}
+
+// Fire-and-forget post (USB and CAT tasks call this). A full queue holds
+// the poster up to ENGINE_POST_WAIT_MS before the event is dropped.
+static bool engine_post(engine_event_t *ev)
+{
+    if (!s_queue) return false;
+    if (!ev->posted_us) ev->posted_us = esp_timer_get_time();
+    ev->result = NULL;
+    if (xQueueSend(s_queue, ev, pdMS_TO_TICKS(ENGINE_POST_WAIT_MS)) != pdTRUE) {
+        atomic_fetch_add_explicit(&s_ev_dropped, 1, memory_order_relaxed);
+        ESP_LOGW(TAG, "Event queue full, dropped event type %d", ev->type);
+        return false;
+    }
+    return true;
+}
+
+// Post and wait for the engine task to handle it. Must not be called from
+// the engine task itself (learn / CAT callbacks).
+static esp_err_t engine_call(engine_event_t *ev)
+{
+    if (!s_queue) return ESP_ERR_INVALID_STATE;
+    esp_err_t result = ESP_FAIL;
+    xSemaphoreTake(s_call_lock, portMAX_DELAY);
+    ev->posted_us = esp_timer_get_time();
+    ev->result = &result;
+    xQueueSend(s_queue, ev, portMAX_DELAY);
+    xSemaphoreTake(s_call_done, portMAX_DELAY);
+    xSemaphoreGive(s_call_lock);
+    return result;
+}
+
+// ===================================================================
+// Public API
+// ===================================================================
+
+esp_err_t mapping_engine_init(void)
+{
+    build_led_index();
+
+    // The task is not running yet, so set up its state directly.
+    // Always start from defaults, then overlay user mappings on top.
+    s_event_us = esp_timer_get_time();
+    engine_reset_defaults();
+    engine_load();  // Overlays user customizations (no-op if no file)
+
+    s_call_lock = xSemaphoreCreateMutex();
+    s_call_done = xSemaphoreCreateBinary();
+    s_queue = xQueueCreate(ENGINE_QUEUE_DEPTH, sizeof(engine_event_t));
+    if (!s_call_lock || !s_call_done || !s_queue) return ESP_ERR_NO_MEM;
+
+    if (xTaskCreatePinnedToCore(engine_task, "mapper", 6144, NULL, 3, NULL, 1) != pdPASS) {
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Mapping engine initialized (%d mappings, %d commands in DB)",
+             s_mapping_count, (int)CMD_DB_COUNT);
+    return ESP_OK;
+}
+
+void mapping_engine_on_control(
+    uint8_t control_id,
+    dj_control_type_t control_type,
+    uint8_t old_value,
+    uint8_t new_value)
+{
+    engine_event_t ev = {
+        .type = EV_CONTROL,
+        .control = { control_id, (uint8_t)control_type, old_value, new_value, false,
+                     latency_usb_rx_us() },
+    };
+    if (control_type == DJ_CTRL_BUTTON || control_id >= DJ_CONTROL_COUNT) {
+        engine_post(&ev);
+        return;
+    }
+
+    // Dials and encoders: merge into the event already queued, if any
+    ev.posted_us = esp_timer_get_time();
+    if (slot_merge(control_id, control_type, old_value, new_value, ev.posted_us)) {
+        atomic_fetch_add_explicit(&s_ev_coalesced, 1, memory_order_relaxed);
+        return;
+    }
+    ev.control.merged = true;
+    if (!engine_post(&ev)) {
+        // Nothing queued will take the slot: clear it so the next change posts
+        atomic_store_explicit(&s_ctrl_slots[control_id], 0, memory_order_release);
+    }
+}
+
+int mapping_engine_get_table(mapping_entry_t *out, int max)
+{
+    int count = 0;
+    engine_event_t ev = { .type = EV_GET_TABLE, .table = { out, out ? max : 0, &count } };
+    engine_call(&ev);
+    return count;
+}
+
+esp_err_t mapping_engine_set(const mapping_entry_t *entry)
+{
+    engine_event_t ev = { .type = EV_SET, .entry = *entry };
+    return engine_call(&ev);
+}
+
+esp_err_t mapping_engine_remove(uint8_t control_id)
+{
+    engine_event_t ev = { .type = EV_REMOVE, .control_id = control_id };
+    return engine_call(&ev);
+}
+
+void mapping_engine_reset_defaults(void)
+{
+    engine_event_t ev = { .type = EV_RESET_DEFAULTS };
+    engine_call(&ev);
+}
+
+esp_err_t mapping_engine_save(void)
+{
+    engine_event_t ev = { .type = EV_SAVE };
+    return engine_call(&ev);
+}
+
+void mapping_engine_flush(void)
+{
+    engine_event_t ev = { .type = EV_FLUSH };
+    engine_call(&ev);
+}
+
+int mapping_engine_get_meters(led_meter_def_t *out, int max)
+{
+    int count = 0;
+    engine_event_t ev = { .type = EV_GET_METERS, .meters = { out, out ? max : 0, &count } };
+    engine_call(&ev);
+    return count;
+}
+
+esp_err_t mapping_engine_set_meters(const led_meter_def_t *defs, int count)
+{
+    engine_event_t ev = { .type = EV_SET_METERS,
+                          .meters = { (led_meter_def_t *)defs, count, NULL } };
+    return engine_call(&ev);
+}
+
+void mapping_engine_get_queue_stats(mapping_queue_stats_t *stats)
+{
+    stats->depth = s_queue ? uxQueueMessagesWaiting(s_queue) : 0;
+    stats->high_water = s_ev_high_water;
+    stats->handled = s_ev_handled;
+    stats->dropped = atomic_load_explicit(&s_ev_dropped, memory_order_relaxed);
+    stats->coalesced = atomic_load_explicit(&s_ev_coalesced, memory_order_relaxed);
+    stats->latency_avg_us = s_ev_latency_avg_us;
+    stats->latency_max_us = s_ev_latency_max_us;
+}
+
+// ===================================================================
+// Learn mode
+// ===================================================================
+
+void mapping_engine_start_learn(uint16_t command_id)
+{
+    engine_event_t ev = { .type = EV_LEARN_START, .command_id = command_id };
+    engine_post(&ev);
+}
+
+bool mapping_engine_is_learning(void)
+{
+    // Read-only snapshot; the engine task clears the flag itself on timeout
+    return s_learn_active &&
+           (esp_timer_get_time() - s_learn_start_us) <= LEARN_TIMEOUT_US;
+}
+
+void mapping_engine_cancel_learn(void)
+{
+    engine_event_t ev = { .type = EV_LEARN_CANCEL };
+    engine_post(&ev);
+}
+
+void mapping_engine_set_learn_callback(mapping_learn_callback_t cb)
+{
+    s_learn_cb = cb;
+}
+
+void mapping_engine_set_cat_callback(mapping_cat_callback_t cb)
+{
+    s_cat_cb = cb;
+}
+
+// ===================================================================
+// CAT side
+// ===================================================================
+
+void mapping_engine_on_cat_response(const char *cmd, const char *value)
+{
+    // Nothing the engine tracks has a longer value (VFO: 11 digits)
+    size_t len = strlen(value);
+    if (len == 0 || len >= ENGINE_VALUE_MAX) return;
+
+    engine_event_t ev = { .type = EV_CAT_RESPONSE };
+    snprintf(ev.cat.cmd, sizeof(ev.cat.cmd), "%.4s", cmd);
+    memcpy(ev.cat.value, value, len + 1);
+    engine_post(&ev);
+}
+
+void mapping_engine_request_sync(void)
+{
+    engine_event_t ev = { .type = EV_SYNC };
+    engine_post(&ev);
 }
@@ -2,8 +2,10 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 #include "usb_dj_host.h"
+#include "led_meter.h"
 
 /**
  * Mapping Engine - maps DJ console controls to Thetis CAT commands.
@@ -11,7 +13,8 @@
  * Features:
  *   - Auto-generated database of ~300+ Thetis commands (from CATCommands.cs)
  *   - MIDI-learn mode: select command, move control, mapping created
- *   - Mappings saved to SPIFFS as JSON
+ *   - Mappings saved to NVS as JSON, with the LED meter definitions
+ *   - Controls keyed by dense ID internally; JSON keeps control names
  *   - Download/upload for backup
  */
 
@@ -68,13 +71,20 @@ const thetis_cmd_t *cmd_db_find(uint16_t id);
 /** Get human-readable category name. */
 const char *cmd_category_name(cmd_category_t cat);
 
+/**
+ * Prebuilt GET /api/commands body: the whole database as gzipped JSON,
+ * generated with s_cmd_db[] and stored in flash. *etag is a quoted
+ * content hash of the JSON.
+ */
+const uint8_t *cmd_db_catalog_gz(size_t *len, const char **etag);
+
 // ---------------------------------------------------------------------------
 // Mapping entries
 // ---------------------------------------------------------------------------
 
 /** A single control-to-command mapping. */
 typedef struct {
-    char     control_name[24];  // DJ control: "Jog_A", "Play_A", etc.
+    uint8_t  control_id;        // DJ control ID (dj_control_name(): "Jog_A", "Play_A", ...)
     uint16_t command_id;        // Thetis command ID from database
     int32_t  param;             // Step size (Hz for VFO), or 0 for default
 } mapping_entry_t;
@@ -85,35 +95,82 @@ typedef struct {
 // Public API
 // ---------------------------------------------------------------------------
 
-/** Initialize: load mappings from SPIFFS, fall back to defaults. */
+/**
+ * Initialize: load defaults plus user mappings from NVS, then start the
+ * engine task. The task owns all mapping, VFO, filter, toggle and learn
+ * state; every function below posts an event to it instead of touching
+ * that state from the caller's task.
+ */
 esp_err_t mapping_engine_init(void);
 
-/** DJ control change callback - dispatches CAT command per mapping. */
+/**
+ * DJ control change callback - queues the change for the engine task,
+ * which dispatches the CAT command per mapping. A dial or encoder change
+ * is merged into the event already queued for that control, if any, and
+ * returns at once. Otherwise, if the event queue is full, the caller waits
+ * up to 10 ms for room before the change is dropped (counted in the stats).
+ */
 void mapping_engine_on_control(
-    const char *name,
+    uint8_t control_id,
     dj_control_type_t control_type,
-    uint8_t control_index,
     uint8_t old_value,
     uint8_t new_value);
 
-/** Get the current mapping table (read-only). */
-const mapping_entry_t *mapping_engine_get_table(int *count);
+/*
+ * The table calls below (get_table, set, remove, save, reset_defaults,
+ * flush, get/set_meters) wait for the engine task to run them. Do not call them from the
+ * learn or CAT callbacks, which run on that task.
+ */
+
+/**
+ * Copy the current mapping table into out (up to max entries).
+ * Returns the total number of mappings; out may be NULL to just count.
+ */
+int mapping_engine_get_table(mapping_entry_t *out, int max);
 
-/** Set a mapping entry by control name. Overwrites if exists, appends if new. */
+/** Set a mapping entry by control ID. Overwrites if exists, appends if new. */
 esp_err_t mapping_engine_set(const mapping_entry_t *entry);
 
-/** Remove a mapping by control name. */
-esp_err_t mapping_engine_remove(const char *control_name);
+/** Remove a mapping by control ID. */
+esp_err_t mapping_engine_remove(uint8_t control_id);
 
-/** Save current mappings to SPIFFS. */
+/** Save current mappings to NVS. */
 esp_err_t mapping_engine_save(void);
 
-/** Load mappings from SPIFFS. Returns ESP_ERR_NOT_FOUND if no file. */
-esp_err_t mapping_engine_load(void);
-
-/** Reset to default mappings and save. */
+/** Reset to default mappings (not saved). */
 void mapping_engine_reset_defaults(void);
 
+/** Wait until every event posted before this call has been handled. */
+void mapping_engine_flush(void);
+
+/**
+ * LED meters (led_meter.h): copy up to max definitions into out, return
+ * how many there are (out may be NULL to just count).
+ */
+int mapping_engine_get_meters(led_meter_def_t *out, int max);
+
+/**
+ * Replace the LED meter definitions (count 0 removes them) and route their
+ * CAT replies. Saved by mapping_engine_save(), reset by reset_defaults.
+ */
+esp_err_t mapping_engine_set_meters(const led_meter_def_t *defs, int count);
+
+/**
+ * Engine event queue counters. Latency is from post (USB / CAT / HTTP
+ * task) to the engine task picking the event up.
+ */
+typedef struct {
+    uint32_t depth;           // Events waiting now
+    uint32_t high_water;      // Max depth seen by the task
+    uint32_t handled;         // Events handled
+    uint32_t dropped;         // Events refused (queue still full after ENGINE_POST_WAIT_MS)
+    uint32_t coalesced;       // Dial / encoder changes merged into a queued event
+    uint32_t latency_avg_us;  // Mean queue latency since boot
+    uint32_t latency_max_us;  // Worst queue latency since boot
+} mapping_queue_stats_t;
+
+void mapping_engine_get_queue_stats(mapping_queue_stats_t *stats);
+
 // ---------------------------------------------------------------------------
 // MIDI Learn mode
 // ---------------------------------------------------------------------------
@@ -132,7 +189,7 @@ void mapping_engine_cancel_learn(void);
  * Set via mapping_engine_set_learn_callback().
  */
 typedef void (*mapping_learn_callback_t)(
-    const char *control_name,
+    uint8_t control_id,
     uint16_t command_id,
     const char *command_name);
 
@@ -143,7 +200,7 @@ void mapping_engine_set_learn_callback(mapping_learn_callback_t cb);
  * Set via mapping_engine_set_cat_callback().
  */
 typedef void (*mapping_cat_callback_t)(
-    const char *control_name,
+    uint8_t control_id,
     const char *command_name,
     cmd_exec_type_t exec_type,
     const char *cat_string);
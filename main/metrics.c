@@ -0,0 +1,55 @@
+#include "metrics.h"
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+
+// One cache-line-aligned row per core, so the cores never write the same line
+typedef struct {
+    atomic_uint v[METRIC_COUNT];
+} __attribute__((aligned(32))) metric_row_t;
+
+static metric_row_t s_rows[portNUM_PROCESSORS];
+
+static const metric_info_t s_info[METRIC_COUNT] = {
+    [METRIC_USB_PACKETS]         = { "usb_packets_total",         NULL, "Bulk IN state packets received" },
+    [METRIC_USB_SHORT_TRANSFERS] = { "usb_short_transfers_total", NULL, "Bulk IN transfers shorter than a state packet" },
+    [METRIC_USB_IN_ERRORS]       = { "usb_in_errors_total",       NULL, "Bulk IN transfers that failed" },
+    [METRIC_CONTROL_BUTTON]      = { "control_events_total",      "type=\"button\"",  "Decoded control changes" },
+    [METRIC_CONTROL_DIAL]        = { "control_events_total",      "type=\"dial\"",    "Decoded control changes" },
+    [METRIC_CONTROL_ENCODER]     = { "control_events_total",      "type=\"encoder\"", "Decoded control changes" },
+    [METRIC_CAT_CMDS_SENT]       = { "cat_commands_sent_total",   NULL, "CAT commands written to Thetis" },
+    [METRIC_CAT_BYTES_SENT]      = { "cat_bytes_sent_total",      NULL, "CAT bytes written to Thetis" },
+    [METRIC_CAT_RESPONSES]       = { "cat_responses_total",       NULL, "CAT messages received from Thetis" },
+    [METRIC_CAT_BYTES_RECEIVED]  = { "cat_bytes_received_total",  NULL, "CAT bytes received from Thetis" },
+    [METRIC_CAT_ERROR_RESPONSES] = { "cat_error_responses_total", NULL, "CAT error replies (?;)" },
+    [METRIC_CAT_RECONNECTS]      = { "cat_reconnects_total",      NULL, "CAT connections made after the first" },
+    [METRIC_WS_FRAMES_SENT]      = { "ws_frames_sent_total",      NULL, "WebSocket frames queued to clients" },
+    [METRIC_WS_FRAMES_DROPPED]   = { "ws_frames_dropped_total",   NULL, "WebSocket frames that could not be sent" },
+    [METRIC_WS_INLINE_STRINGS]   = { "ws_inline_strings_total",   NULL, "Binary WebSocket records sent with inline strings (string table full)" },
+    [METRIC_LED_REQUESTS]        = { "led_requests_total",        NULL, "LED state changes requested (before coalescing)" },
+    [METRIC_LED_OUT_TRANSFERS]   = { "led_out_transfers_total",   NULL, "LED bulk OUT transfers submitted" },
+    [METRIC_LED_OUT_TIMEOUTS]    = { "led_out_timeouts_total",    NULL, "LED bulk OUT transfers that timed out waiting" },
+    [METRIC_NVS_WRITES]          = { "nvs_writes_total",          NULL, "NVS writes committed" },
+};
+
+void metrics_add(metric_t m, uint32_t n)
+{
+    // A task may migrate between reading the core ID and the add; the
+    // add is atomic, so at worst it lands in the other core's row
+    atomic_fetch_add_explicit(&s_rows[xPortGetCoreID()].v[m], n, memory_order_relaxed);
+}
+
+uint32_t metrics_get(metric_t m)
+{
+    uint32_t sum = 0;
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        sum += atomic_load_explicit(&s_rows[c].v[m], memory_order_relaxed);
+    }
+    return sum;
+}
+
+const metric_info_t *metrics_info(metric_t m)
+{
+    return &s_info[m];
+}
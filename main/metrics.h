@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Pipeline counters for /api/metrics.
+ *
+ * Each counter has one slot per CPU core; metrics_inc() adds to the
+ * calling core's slot with a relaxed atomic, so the hot path never takes a
+ * lock or bounces a cache line to the other core. Readers sum the slots.
+ * All counters only ever increase (Prometheus "counter" type).
+ */
+
+typedef enum {
+    // USB bulk IN (bulk_in_cb)
+    METRIC_USB_PACKETS = 0,
+    METRIC_USB_SHORT_TRANSFERS,
+    METRIC_USB_IN_ERRORS,
+    // Decoded control changes, by type
+    METRIC_CONTROL_BUTTON,
+    METRIC_CONTROL_DIAL,
+    METRIC_CONTROL_ENCODER,
+    // CAT client
+    METRIC_CAT_CMDS_SENT,
+    METRIC_CAT_BYTES_SENT,
+    METRIC_CAT_RESPONSES,
+    METRIC_CAT_BYTES_RECEIVED,
+    METRIC_CAT_ERROR_RESPONSES,     // "?;" and other error replies
+    METRIC_CAT_RECONNECTS,          // Successful connects after the first
+    // WebSocket (all clients; per-client counts live in http_server)
+    METRIC_WS_FRAMES_SENT,
+    METRIC_WS_FRAMES_DROPPED,
+    METRIC_WS_INLINE_STRINGS,       // Binary records sent with inline strings (table full)
+    // LED bulk OUT
+    METRIC_LED_REQUESTS,            // State changes asked of dj_led (before coalescing)
+    METRIC_LED_OUT_TRANSFERS,
+    METRIC_LED_OUT_TIMEOUTS,
+    // Config store
+    METRIC_NVS_WRITES,
+    METRIC_COUNT,
+} metric_t;
+
+typedef struct {
+    const char *name;       // Prometheus name, without the "djconsole_" prefix
+    const char *labels;     // e.g. "type=\"button\"", or NULL
+    const char *help;
+} metric_info_t;
+
+/** Add n to a counter. Lock-free, callable from any task. */
+void metrics_add(metric_t m, uint32_t n);
+
+static inline void metrics_inc(metric_t m)
+{
+    metrics_add(m, 1);
+}
+
+/** Current value (sum over cores). */
+uint32_t metrics_get(metric_t m);
+
+/** Name, labels and help text of a counter. */
+const metric_info_t *metrics_info(metric_t m);
@@ -28,9 +28,8 @@ int usb_debug_get_level(void)
 }
 
 void usb_debug_control_cb(
-    const char *name,
+    uint8_t control_id,
     dj_control_type_t control_type,
-    uint8_t control_index,
     uint8_t old_value,
     uint8_t new_value)
 {
@@ -48,7 +47,7 @@ void usb_debug_control_cb(
 
     // Level 1+: Log control name and value
     ESP_LOGI(TAG, "[%s] %-20s idx=%2d  %3d -> %3d  (0x%02X -> 0x%02X)",
-             type_str, name, control_index, old_value, new_value, old_value, new_value);
+             type_str, dj_control_name(control_id), control_id, old_value, new_value, old_value, new_value);
 
     // Level 2+: Show which raw bytes changed
     if (s_debug_level >= 2 && s_have_prev) {
@@ -69,16 +68,6 @@ void usb_debug_dump_state(void)
         return;
     }
 
-    char hex_line[DJ_STATE_SIZE * 3 + 1];
-    char ascii_line[DJ_STATE_SIZE + 1];
-    int pos = 0;
-
-    for (int i = 0; i < DJ_STATE_SIZE; i++) {
-        pos += snprintf(hex_line + pos, sizeof(hex_line) - pos, "%02X ", state[i]);
-        ascii_line[i] = (state[i] >= 0x20 && state[i] <= 0x7E) ? state[i] : '.';
-    }
-    ascii_line[DJ_STATE_SIZE] = '\0';
-
     ESP_LOGI(TAG, "=== State Dump (%lu updates, %lu changes) ===",
              (unsigned long)s_update_count, (unsigned long)s_change_count);
 
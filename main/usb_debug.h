@@ -28,9 +28,8 @@ int  usb_debug_get_level(void);
  * Logs control changes according to the current debug level.
  */
 void usb_debug_control_cb(
-    const char *name,
+    uint8_t control_id,
     dj_control_type_t control_type,
-    uint8_t control_index,
     uint8_t old_value,
     uint8_t new_value);
 
@@ -1,100 +1,19 @@
 #include "usb_dj_host.h"
 #include "status_led.h"
+#include "latency.h"
+#include "metrics.h"
 
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "usb/usb_host.h"
 #include "usb/usb_types_ch9.h"
 
 static const char *TAG = "usb_dj";
 
-// ---------------------------------------------------------------------------
-// Control mapping table (ported from sample.ino)
-// ---------------------------------------------------------------------------
-
-typedef struct {
-    const char *name;
-    uint8_t byte_offset;
-    uint8_t byte_mask;
-    dj_control_type_t control_type;
-} control_mapping_t;
-
-static const control_mapping_t s_mappings[] = {
-    // Buttons (type 0) - Deck A
-    { "PitchReset_A",    4, 0x80, DJ_CTRL_BUTTON },
-    { "PitchBendMinus_A",0, 0x02, DJ_CTRL_BUTTON },
-    { "PitchBendPlus_A", 0, 0x04, DJ_CTRL_BUTTON },
-    { "Sync_A",          4, 0x20, DJ_CTRL_BUTTON },
-    { "Shift_A",         0, 0x01, DJ_CTRL_BUTTON },
-    { "Shifted_A",       3, 0x10, DJ_CTRL_BUTTON },
-    { "N1_A",            4, 0x40, DJ_CTRL_BUTTON },
-    { "N2_A",            0, 0x10, DJ_CTRL_BUTTON },
-    { "N3_A",            0, 0x20, DJ_CTRL_BUTTON },
-    { "N4_A",            0, 0x40, DJ_CTRL_BUTTON },
-    { "N5_A",            5, 0x01, DJ_CTRL_BUTTON },
-    { "N6_A",            5, 0x02, DJ_CTRL_BUTTON },
-    { "N7_A",            5, 0x04, DJ_CTRL_BUTTON },
-    { "N8_A",            5, 0x08, DJ_CTRL_BUTTON },
-    { "RWD_A",           0, 0x08, DJ_CTRL_BUTTON },
-    { "FWD_A",           0, 0x80, DJ_CTRL_BUTTON },
-    { "CUE_A",           1, 0x02, DJ_CTRL_BUTTON },
-    { "Play_A",          1, 0x04, DJ_CTRL_BUTTON },
-    { "Listen_A",        1, 0x01, DJ_CTRL_BUTTON },
-    { "Load_A",          1, 0x08, DJ_CTRL_BUTTON },
-
-    // Buttons - Deck B
-    { "PitchReset_B",    4, 0x02, DJ_CTRL_BUTTON },
-    { "PitchBendMinus_B",3, 0x02, DJ_CTRL_BUTTON },
-    { "PitchBendPlus_B", 3, 0x04, DJ_CTRL_BUTTON },
-    { "Sync_B",          4, 0x08, DJ_CTRL_BUTTON },
-    { "Shift_B",         3, 0x01, DJ_CTRL_BUTTON },
-    { "Shifted_B",       3, 0x20, DJ_CTRL_BUTTON },
-    { "N1_B",            4, 0x04, DJ_CTRL_BUTTON },
-    { "N2_B",            2, 0x10, DJ_CTRL_BUTTON },
-    { "N3_B",            2, 0x20, DJ_CTRL_BUTTON },
-    { "N4_B",            2, 0x40, DJ_CTRL_BUTTON },
-    { "N5_B",            5, 0x10, DJ_CTRL_BUTTON },
-    { "N6_B",            5, 0x20, DJ_CTRL_BUTTON },
-    { "N7_B",            5, 0x40, DJ_CTRL_BUTTON },
-    { "N8_B",            5, 0x80, DJ_CTRL_BUTTON },
-    { "RWD_B",           3, 0x08, DJ_CTRL_BUTTON },
-    { "FWD_B",           2, 0x80, DJ_CTRL_BUTTON },
-    { "CUE_B",           2, 0x02, DJ_CTRL_BUTTON },
-    { "Play_B",          2, 0x04, DJ_CTRL_BUTTON },
-    { "Listen_B",        2, 0x01, DJ_CTRL_BUTTON },
-    { "Load_B",          2, 0x08, DJ_CTRL_BUTTON },
-
-    // Global buttons
-    { "Vinyl",           4, 0x10, DJ_CTRL_BUTTON },
-    { "Magic",           4, 0x01, DJ_CTRL_BUTTON },
-    { "Up",              1, 0x10, DJ_CTRL_BUTTON },
-    { "Down",            1, 0x80, DJ_CTRL_BUTTON },
-    { "Folders",         1, 0x20, DJ_CTRL_BUTTON },
-    { "Files",           1, 0x40, DJ_CTRL_BUTTON },
-
-    // Dials and sliders (type 1), range 0x00-0xFF
-    { "Treble_A",        7,  0xFF, DJ_CTRL_DIAL },
-    { "Medium_A",        8,  0xFF, DJ_CTRL_DIAL },
-    { "Bass_A",          9,  0xFF, DJ_CTRL_DIAL },
-    { "Vol_A",           6,  0xFF, DJ_CTRL_DIAL },
-    { "Treble_B",        12, 0xFF, DJ_CTRL_DIAL },
-    { "Medium_B",        13, 0xFF, DJ_CTRL_DIAL },
-    { "Bass_B",          14, 0xFF, DJ_CTRL_DIAL },
-    { "Vol_B",           11, 0xFF, DJ_CTRL_DIAL },
-    { "XFader",          10, 0xFF, DJ_CTRL_DIAL },
-
-    // Jog wheels / rotary encoders (type 2), 0x00-0xFF with wrap-around
-    { "Jog_A",           15, 0xFF, DJ_CTRL_ENCODER },
-    { "Pitch_A",         17, 0xFF, DJ_CTRL_ENCODER },
-    { "Jog_B",           16, 0xFF, DJ_CTRL_ENCODER },
-    { "Pitch_B",         18, 0xFF, DJ_CTRL_ENCODER },
-};
-
-#define NUM_MAPPINGS (sizeof(s_mappings) / sizeof(s_mappings[0]))
-
 // ---------------------------------------------------------------------------
 // USB init sequence (ported from sample.ino send_init_sequence)
 // ---------------------------------------------------------------------------
@@ -144,6 +63,14 @@ static uint16_t s_bulk_out_mps = 0;
 static usb_transfer_t *s_bulk_out_xfer = NULL;
 static SemaphoreHandle_t s_out_mutex = NULL;
 static SemaphoreHandle_t s_out_done = NULL;  // signaled when OUT transfer completes
+static usb_transfer_status_t s_out_status;   // of the last completed OUT transfer
+static int s_out_actual;
+
+// Several MIDI messages per OUT transfer. Unknown until the first packed
+// transfer of a connection completes; a device that rejects it gets one
+// message per transfer until it is reconnected.
+typedef enum { OUT_PACK_UNKNOWN, OUT_PACK_OK, OUT_PACK_SINGLE } out_pack_t;
+static out_pack_t s_out_pack = OUT_PACK_UNKNOWN;
 
 static usb_host_client_handle_t s_client_hdl = NULL;
 static usb_device_handle_t s_dev_hdl = NULL;
@@ -153,42 +80,9 @@ static SemaphoreHandle_t s_ctrl_sem = NULL;
 static TaskHandle_t s_setup_task_hdl = NULL;
 static uint8_t s_pending_dev_addr = 0;
 
-static uint8_t s_current_state[DJ_STATE_SIZE];
-static uint8_t s_old_state[DJ_STATE_SIZE];
 static bool s_device_connected = false;
-static dj_control_callback_t s_callback = NULL;
 static dj_raw_state_callback_t s_raw_callback = NULL;
 
-// ---------------------------------------------------------------------------
-// State diffing (ported from sample.ino on_state_update)
-// ---------------------------------------------------------------------------
-
-static void process_state_update(void)
-{
-    for (int i = 0; i < NUM_MAPPINGS; i++) {
-        const control_mapping_t *m = &s_mappings[i];
-
-        uint8_t old_val = s_old_state[m->byte_offset] & m->byte_mask;
-        uint8_t new_val = s_current_state[m->byte_offset] & m->byte_mask;
-
-        // Buttons: normalize to 0/1
-        if (m->control_type == DJ_CTRL_BUTTON) {
-            old_val = old_val > 0 ? 1 : 0;
-            new_val = new_val > 0 ? 1 : 0;
-        }
-
-        if (new_val != old_val) {
-            ESP_LOGD(TAG, "Control: %s %d -> %d", m->name, old_val, new_val);
-
-            if (s_callback) {
-                s_callback(m->name, m->control_type, i, old_val, new_val);
-            }
-        }
-    }
-
-    memcpy(s_old_state, s_current_state, DJ_STATE_SIZE);
-}
-
 // ---------------------------------------------------------------------------
 // USB transfer callbacks
 // ---------------------------------------------------------------------------
@@ -214,12 +108,14 @@ static void bulk_in_cb(usb_transfer_t *transfer)
                      transfer->bEndpointAddress);
         }
         if (transfer->actual_num_bytes >= DJ_STATE_SIZE) {
+            metrics_inc(METRIC_USB_PACKETS);
             if (s_raw_callback) {
                 s_raw_callback(transfer->data_buffer, transfer->actual_num_bytes);
             }
-            memcpy(s_current_state, transfer->data_buffer, DJ_STATE_SIZE);
-            process_state_update();
+            latency_mark_usb_rx(esp_timer_get_time());
+            dj_state_process(transfer->data_buffer);
         } else if (transfer->actual_num_bytes > 0) {
+            metrics_inc(METRIC_USB_SHORT_TRANSFERS);
             ESP_LOGW(TAG, "Short transfer: %d bytes (need %d)",
                      transfer->actual_num_bytes, DJ_STATE_SIZE);
         }
@@ -228,6 +124,7 @@ static void bulk_in_cb(usb_transfer_t *transfer)
     } else if (transfer->status == USB_TRANSFER_STATUS_CANCELED) {
         ESP_LOGW(TAG, "IN transfer cancelled (device disconnected?)");
     } else {
+        metrics_inc(METRIC_USB_IN_ERRORS);
         ESP_LOGE(TAG, "IN transfer error, status=%d, EP=0x%02X",
                  transfer->status, transfer->bEndpointAddress);
         // Try to re-submit after a short delay
@@ -241,6 +138,8 @@ static void bulk_out_cb(usb_transfer_t *transfer)
     if (transfer->status != USB_TRANSFER_STATUS_COMPLETED) {
         ESP_LOGE(TAG, "OUT transfer failed, status=%d", transfer->status);
     }
+    s_out_status = transfer->status;
+    s_out_actual = transfer->actual_num_bytes;
     xSemaphoreGive(s_out_done);
 }
 
@@ -520,8 +419,7 @@ static void setup_device(uint8_t dev_addr)
     }
 
     // Clear state buffers
-    memset(s_current_state, 0, DJ_STATE_SIZE);
-    memset(s_old_state, 0, DJ_STATE_SIZE);
+    dj_state_reset();
 
     // Start bulk IN polling
     err = start_bulk_polling();
@@ -536,22 +434,10 @@ static void setup_device(uint8_t dev_addr)
         return;
     }
 
+    s_out_pack = OUT_PACK_UNKNOWN;
     s_device_connected = true;
-    ESP_LOGI(TAG, "DJ Console ready! (%d controls mapped)", NUM_MAPPINGS);
-
-    // Reset LED controller and turn all LEDs off
-    if (s_bulk_out_ep && s_bulk_out_xfer) {
-        ESP_LOGI(TAG, "Resetting LED controller via EP 0x%02X", s_bulk_out_ep);
-        const uint8_t reset_cmd[] = {0xB0, 0x7F, 0x7F};
-        usb_dj_host_send(reset_cmd, sizeof(reset_cmd));
-        vTaskDelay(pdMS_TO_TICKS(50));
-        // Sweep all notes off
-        for (uint8_t note = 0; note <= 46; note++) {
-            const uint8_t off_cmd[] = {0x90, note, 0x00};
-            usb_dj_host_send(off_cmd, sizeof(off_cmd));
-        }
-        ESP_LOGI(TAG, "LED controller reset complete");
-    }
+    ESP_LOGI(TAG, "DJ Console ready! (%d controls mapped)", dj_state_control_count());
+    // The LED task (dj_led.c) sees the connect and resets the LED controller
 }
 
 static void teardown_device(void)
@@ -655,7 +541,7 @@ static void usb_client_task(void *arg)
 
 esp_err_t usb_dj_host_init(dj_control_callback_t callback)
 {
-    s_callback = callback;
+    dj_state_set_callback(callback);
     s_ctrl_sem = xSemaphoreCreateBinary();
 
     // Install USB Host Library
@@ -698,7 +584,7 @@ esp_err_t usb_dj_host_init(dj_control_callback_t callback)
     xTaskCreatePinnedToCore(usb_client_task, "usb_client", 4096, NULL, 2, NULL, 0);
     xTaskCreatePinnedToCore(device_setup_task, "dj_setup", 4096, NULL, 2, &s_setup_task_hdl, 0);
 
-    ESP_LOGI(TAG, "USB DJ host initialized (%d controls in mapping table)", NUM_MAPPINGS);
+    ESP_LOGI(TAG, "USB DJ host initialized (%d controls in mapping table)", dj_state_control_count());
     return ESP_OK;
 }
 
@@ -709,7 +595,7 @@ bool usb_dj_host_is_connected(void)
 
 const uint8_t *usb_dj_host_get_state(void)
 {
-    return s_device_connected ? s_current_state : NULL;
+    return s_device_connected ? dj_state_get() : NULL;
 }
 
 void usb_dj_host_set_raw_callback(dj_raw_state_callback_t cb)
@@ -717,7 +603,9 @@ void usb_dj_host_set_raw_callback(dj_raw_state_callback_t cb)
     s_raw_callback = cb;
 }
 
-esp_err_t usb_dj_host_send(const uint8_t *data, size_t len)
+// One OUT transfer. With wait, also wait for it to complete and return
+// ESP_FAIL unless the device took every byte.
+static esp_err_t out_submit(const uint8_t *data, size_t len, bool wait)
 {
     if (!s_device_connected || !s_bulk_out_xfer || !s_bulk_out_ep) {
         return ESP_ERR_INVALID_STATE;
@@ -728,12 +616,14 @@ esp_err_t usb_dj_host_send(const uint8_t *data, size_t len)
 
     // Serialize access: only one caller at a time
     if (xSemaphoreTake(s_out_mutex, pdMS_TO_TICKS(200)) != pdTRUE) {
+        metrics_inc(METRIC_LED_OUT_TIMEOUTS);
         return ESP_ERR_TIMEOUT;
     }
 
     // Wait for any previous transfer to finish
     if (xSemaphoreTake(s_out_done, pdMS_TO_TICKS(200)) != pdTRUE) {
         xSemaphoreGive(s_out_mutex);
+        metrics_inc(METRIC_LED_OUT_TIMEOUTS);
         return ESP_ERR_TIMEOUT;
     }
 
@@ -748,8 +638,62 @@ esp_err_t usb_dj_host_send(const uint8_t *data, size_t len)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Bulk OUT submit failed: %s", esp_err_to_name(err));
         xSemaphoreGive(s_out_done);  // release so next call doesn't deadlock
+    } else {
+        metrics_inc(METRIC_LED_OUT_TRANSFERS);
+        if (wait) {
+            if (xSemaphoreTake(s_out_done, pdMS_TO_TICKS(200)) != pdTRUE) {
+                metrics_inc(METRIC_LED_OUT_TIMEOUTS);
+                err = ESP_ERR_TIMEOUT;
+            } else {
+                if (s_out_status != USB_TRANSFER_STATUS_COMPLETED || s_out_actual != (int)len) {
+                    if (s_out_status == USB_TRANSFER_STATUS_STALL) {
+                        usb_host_endpoint_clear(s_dev_hdl, s_bulk_out_ep);
+                    }
+                    err = ESP_FAIL;
+                }
+                xSemaphoreGive(s_out_done);
+            }
+        }
     }
 
     xSemaphoreGive(s_out_mutex);
     return err;
 }
+
+esp_err_t usb_dj_host_send(const uint8_t *data, size_t len)
+{
+    return out_submit(data, len, false);
+}
+
+esp_err_t usb_dj_host_send_msgs(const uint8_t *msgs, size_t count)
+{
+    if (!s_device_connected || !s_bulk_out_ep) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t mps = s_bulk_out_mps < EP_MPS_DEFAULT ? s_bulk_out_mps : EP_MPS_DEFAULT;
+    size_t per = mps / 3;
+
+    size_t i = 0;
+    while (i < count) {
+        if (s_out_pack == OUT_PACK_SINGLE || per < 2) per = 1;
+        size_t n = count - i < per ? count - i : per;
+        bool probe = n > 1 && s_out_pack == OUT_PACK_UNKNOWN;
+
+        // Every transfer is waited for: ESP_OK must mean the device took it
+        esp_err_t err = out_submit(msgs + 3 * i, 3 * n, true);
+        if (probe) {
+            if (err == ESP_OK) {
+                s_out_pack = OUT_PACK_OK;
+                ESP_LOGI(TAG, "Packed LED transfers: %u messages each", (unsigned)per);
+            } else if (err == ESP_FAIL || err == ESP_ERR_INVALID_SIZE ||
+                       err == ESP_ERR_NOT_SUPPORTED) {
+                s_out_pack = OUT_PACK_SINGLE;
+                ESP_LOGW(TAG, "Device rejected a packed LED transfer, sending one message at a time");
+                continue;   // Same messages again, one by one
+            }
+        }
+        if (err != ESP_OK) return err;
+        i += n;
+    }
+    return ESP_OK;
+}
@@ -3,37 +3,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "dj_state.h"
 
 #define HERCULES_VID    0x06F8
 #define HERCULES_PID    0xB105
 
-#define DJ_STATE_SIZE   38
-
-/**
- * Control types matching the original Teensy driver.
- */
-typedef enum {
-    DJ_CTRL_BUTTON = 0,   // On/off, bitmask yields 0 or 1
-    DJ_CTRL_DIAL   = 1,   // Continuous 0x00-0xFF (sliders, knobs)
-    DJ_CTRL_ENCODER = 2,  // Rotary encoder 0x00-0xFF with wrap-around (jog wheels)
-} dj_control_type_t;
-
-/**
- * Callback fired when a DJ console control changes state.
- *
- * @param name          Control name (e.g., "Play_A", "Jog_A", "Vol_A")
- * @param control_type  Button, dial, or encoder
- * @param control_index Index in the mappings table (0-based)
- * @param old_value     Previous value
- * @param new_value     New value
- */
-typedef void (*dj_control_callback_t)(
-    const char *name,
-    dj_control_type_t control_type,
-    uint8_t control_index,
-    uint8_t old_value,
-    uint8_t new_value);
-
 /**
  * Initialize the USB host stack and start scanning for the Hercules DJ Console.
  * Spawns two FreeRTOS tasks: usb_lib_task and usb_client_task.
@@ -77,3 +51,20 @@ void usb_dj_host_set_raw_callback(dj_raw_state_callback_t cb);
  * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not connected
  */
 esp_err_t usb_dj_host_send(const uint8_t *data, size_t len);
+
+/**
+ * Send count 3-byte MIDI messages (msgs holds 3 * count bytes), packing as
+ * many as fit in the OUT endpoint's max packet size into each transfer.
+ * The first packed transfer after a connect is checked; if the device
+ * rejects it, this and every later call fall back to one message per
+ * transfer until the next connect.
+ *
+ * Waits for each transfer to complete (status COMPLETED, every byte taken)
+ * before submitting the next, so ESP_OK means the device took every
+ * message. Blocks for the whole batch: call from a task that may wait.
+ *
+ * @return ESP_OK, ESP_FAIL if a transfer failed on the bus, or the error
+ *         of the transfer that could not be submitted (later messages are
+ *         not sent)
+ */
+esp_err_t usb_dj_host_send_msgs(const uint8_t *msgs, size_t count);
@@ -0,0 +1,277 @@
+#include "usb_trace.h"
+#include "usb_dj_host.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+
+static const char *TAG = "usb_trace";
+
+#define TRACE_PARTITION_LABEL "trace"
+#define TRACE_QUEUE_DEPTH     64     // ~0.5 s of packets, covers a sector erase
+#define TRACE_FLUSH_TIMEOUT_MS 2000
+
+static const esp_partition_t *s_part = NULL;
+static QueueHandle_t s_queue = NULL;
+static SemaphoreHandle_t s_lock = NULL;    // Guards the writer state below
+
+// Queued packet, tagged with the session it was recorded in so records
+// still queued from a previous session are not written into the next one
+typedef struct {
+    uint32_t           session;
+    usb_trace_record_t rec;
+} trace_item_t;
+
+static volatile bool s_recording = false;
+static volatile bool s_writing = false;
+static volatile bool s_replaying = false;
+static int64_t  s_start_us = 0;
+static uint32_t s_count = 0;
+static uint32_t s_dropped = 0;
+static volatile uint32_t s_session = 0;
+
+static size_t s_write_off = 0;      // Next record offset in the partition
+static size_t s_erased_end = 0;     // Partition is erased up to here
+static bool   s_size_known = false;
+
+// ---------------------------------------------------------------------------
+// Flash writer
+// ---------------------------------------------------------------------------
+
+// Make sure [s_write_off, s_write_off + len) is erased, and the record slot
+// after it too where the partition has one: that slot is the end marker, so
+// the image in flash is complete after every write. Caller holds s_lock.
+static esp_err_t ensure_erased(size_t len)
+{
+    size_t end = s_write_off + len + sizeof(usb_trace_record_t);
+    if (end > s_part->size) end = s_part->size;
+    while (end > s_erased_end) {
+        esp_err_t err = esp_partition_erase_range(s_part, s_erased_end, s_part->erase_size);
+        if (err != ESP_OK) return err;
+        s_erased_end += s_part->erase_size;
+    }
+    return ESP_OK;
+}
+
+static void trace_writer_task(void *arg)
+{
+    trace_item_t item;
+    while (1) {
+        if (xQueueReceive(s_queue, &item, portMAX_DELAY) != pdTRUE) continue;
+
+        s_writing = true;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (item.session != s_session) {
+            // Queued before the recording it belonged to was stopped
+        } else if (s_write_off + sizeof(item.rec) > s_part->size) {
+            // Not a ring: keep the start of the session and stop
+            ESP_LOGW(TAG, "Trace partition full after %lu packets, stopping",
+                     (unsigned long)s_count);
+            s_recording = false;
+            xQueueReset(s_queue);
+        } else if (ensure_erased(sizeof(item.rec)) == ESP_OK &&
+                   esp_partition_write(s_part, s_write_off, &item.rec, sizeof(item.rec)) == ESP_OK) {
+            s_write_off += sizeof(item.rec);
+            s_count++;
+        } else {
+            s_dropped++;
+        }
+        xSemaphoreGive(s_lock);
+        s_writing = false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Recorder API
+// ---------------------------------------------------------------------------
+
+esp_err_t usb_trace_init(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                      TRACE_PARTITION_LABEL);
+    if (!s_part) {
+        ESP_LOGW(TAG, "No '%s' partition, trace recording disabled", TRACE_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s_queue = xQueueCreate(TRACE_QUEUE_DEPTH, sizeof(trace_item_t));
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_queue || !s_lock) {
+        s_part = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(trace_writer_task, "usb_trace", 3072, NULL, 2, NULL, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Trace partition: %lu KB (%lu packets max)",
+             (unsigned long)(s_part->size / 1024),
+             (unsigned long)((s_part->size - sizeof(usb_trace_header_t)) / sizeof(usb_trace_record_t)));
+    return ESP_OK;
+}
+
+esp_err_t usb_trace_start(void)
+{
+    if (!s_part) return ESP_ERR_NOT_FOUND;
+    if (s_recording || s_replaying) return ESP_ERR_INVALID_STATE;
+
+    // Waits out a write in progress; packets still queued from the last
+    // session carry its number and are skipped
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_session++;
+    xQueueReset(s_queue);
+    s_write_off = 0;
+    s_erased_end = 0;
+    esp_err_t err = ensure_erased(sizeof(usb_trace_header_t));
+
+    usb_trace_header_t hdr = {
+        .version = USB_TRACE_VERSION,
+        .record_size = sizeof(usb_trace_record_t),
+    };
+    memcpy(hdr.magic, USB_TRACE_MAGIC, 4);
+    if (err == ESP_OK) err = esp_partition_write(s_part, 0, &hdr, sizeof(hdr));
+    s_size_known = true;    // The old image is gone either way
+    if (err == ESP_OK) {
+        s_write_off = sizeof(hdr);
+        s_count = 0;
+        s_dropped = 0;
+        s_start_us = esp_timer_get_time();
+        s_recording = true;
+    }
+    xSemaphoreGive(s_lock);
+    if (err != ESP_OK) return err;
+
+    ESP_LOGI(TAG, "Recording started");
+    return ESP_OK;
+}
+
+void usb_trace_stop(void)
+{
+    if (!s_part || !s_recording) return;
+    s_recording = false;
+
+    // Let the writer drain what is already queued. The slot after the last
+    // record is always erased, so the image is complete whenever it stops.
+    int waited = 0;
+    while ((uxQueueMessagesWaiting(s_queue) > 0 || s_writing) &&
+           waited < TRACE_FLUSH_TIMEOUT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        waited += 10;
+    }
+    if (waited >= TRACE_FLUSH_TIMEOUT_MS) {
+        ESP_LOGW(TAG, "Writer still busy after %d ms", TRACE_FLUSH_TIMEOUT_MS);
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    ESP_LOGI(TAG, "Recording stopped: %lu packets (%lu dropped), %u bytes",
+             (unsigned long)s_count, (unsigned long)s_dropped, (unsigned)s_write_off);
+    xSemaphoreGive(s_lock);
+}
+
+bool usb_trace_is_recording(void)
+{
+    return s_recording;
+}
+
+bool usb_trace_is_replaying(void)
+{
+    return s_replaying;
+}
+
+void usb_trace_record(const uint8_t *raw_data, int length)
+{
+    if (!s_recording || length < DJ_STATE_SIZE) return;
+
+    trace_item_t item;
+    item.session = s_session;
+    item.rec.t_us = (uint32_t)(esp_timer_get_time() - s_start_us);
+    memcpy(item.rec.data, raw_data, DJ_STATE_SIZE);
+    if (xQueueSend(s_queue, &item, 0) != pdTRUE) {
+        s_dropped++;
+    }
+}
+
+uint32_t usb_trace_get_count(void)
+{
+    return s_count;
+}
+
+uint32_t usb_trace_get_dropped(void)
+{
+    return s_dropped;
+}
+
+size_t usb_trace_get_size(void)
+{
+    if (!s_part) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (!s_size_known) {
+        // After a reboot: scan the image in flash for the end marker
+        const void *map = NULL;
+        esp_partition_mmap_handle_t handle;
+        if (esp_partition_mmap(s_part, 0, s_part->size, ESP_PARTITION_MMAP_DATA, &map, &handle) == ESP_OK) {
+            int count = usb_trace_count_records(map, s_part->size);
+            esp_partition_munmap(handle);
+            s_write_off = (count < 0) ? 0
+                : sizeof(usb_trace_header_t) + (size_t)count * sizeof(usb_trace_record_t);
+            s_size_known = true;
+        }
+    }
+    size_t size = s_write_off;
+    xSemaphoreGive(s_lock);
+    return size;
+}
+
+esp_err_t usb_trace_read(size_t offset, void *buf, size_t len)
+{
+    if (!s_part) return ESP_ERR_NOT_FOUND;
+    return esp_partition_read(s_part, offset, buf, len);
+}
+
+// ---------------------------------------------------------------------------
+// On-device replay
+// ---------------------------------------------------------------------------
+
+static void trace_replay_task(void *arg)
+{
+    int speed = (int)(intptr_t)arg;
+    size_t size = usb_trace_get_size();
+
+    const void *map = NULL;
+    esp_partition_mmap_handle_t handle;
+    if (size > 0 &&
+        esp_partition_mmap(s_part, 0, size, ESP_PARTITION_MMAP_DATA, &map, &handle) == ESP_OK) {
+        usb_trace_replay_stats_t stats;
+        if (usb_trace_replay(map, size, speed, NULL, NULL, &stats) == ESP_OK) {
+            ESP_LOGI(TAG, "Replayed %lu packets (%lu ms of trace) in %lld ms",
+                     (unsigned long)stats.packets, (unsigned long)(stats.trace_us / 1000),
+                     stats.elapsed_us / 1000);
+        }
+        esp_partition_munmap(handle);
+    } else {
+        ESP_LOGW(TAG, "No trace to replay");
+    }
+
+    s_replaying = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t usb_trace_replay_start(int speed)
+{
+    if (!s_part) return ESP_ERR_NOT_FOUND;
+    if (s_recording || s_replaying || usb_dj_host_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    s_replaying = true;
+    if (xTaskCreatePinnedToCore(trace_replay_task, "trace_replay", 4096,
+                                (void *)(intptr_t)speed, 2, NULL, 0) != pdPASS) {
+        s_replaying = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "dj_state.h"
+
+/**
+ * USB packet trace: recorder and replay.
+ *
+ * The recorder captures every bulk IN packet (via the raw state callback)
+ * with a microsecond timestamp into the "trace" flash partition. It is a
+ * linear recorder, not a ring: when the partition is full it stops and
+ * keeps the start of the session, which is what a replay needs. The trace
+ * can be downloaded over HTTP and replayed through dj_state_process() on
+ * the device or in the host build, at real time, N times faster, or as
+ * fast as possible.
+ *
+ * Trace image layout (little-endian):
+ *   usb_trace_header_t
+ *   usb_trace_record_t[]   until end of image or a record with
+ *                          t_us == USB_TRACE_END (erased flash)
+ */
+
+#define USB_TRACE_MAGIC     "DJTR"
+#define USB_TRACE_VERSION   1
+#define USB_TRACE_END       0xFFFFFFFFu
+
+typedef struct __attribute__((packed)) {
+    char     magic[4];          // "DJTR"
+    uint16_t version;           // USB_TRACE_VERSION
+    uint16_t record_size;       // sizeof(usb_trace_record_t)
+} usb_trace_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;              // Microseconds since recording started
+    uint8_t  data[DJ_STATE_SIZE];
+} usb_trace_record_t;
+
+// ---------------------------------------------------------------------------
+// Recorder (device only)
+// ---------------------------------------------------------------------------
+
+/** Find the trace partition and start the flash writer task. */
+esp_err_t usb_trace_init(void);
+
+/**
+ * Erase the start of the partition and begin recording. Recording stops
+ * by itself when the partition is full.
+ */
+esp_err_t usb_trace_start(void);
+
+/** Stop recording and flush buffered records to flash. */
+void usb_trace_stop(void);
+
+bool usb_trace_is_recording(void);
+bool usb_trace_is_replaying(void);
+
+/**
+ * Raw state callback: queue one packet for recording (no-op when stopped).
+ * Chain from the usb_dj_host_set_raw_callback() handler.
+ */
+void usb_trace_record(const uint8_t *raw_data, int length);
+
+/** Packets recorded and dropped (writer fell behind) since start. */
+uint32_t usb_trace_get_count(void);
+uint32_t usb_trace_get_dropped(void);
+
+/** Size in bytes of the trace image currently in flash (0 if none). */
+size_t usb_trace_get_size(void);
+
+/** Read part of the trace image (for download). */
+esp_err_t usb_trace_read(size_t offset, void *buf, size_t len);
+
+/**
+ * Replay the trace stored in flash from a background task.
+ * Refused while the console is connected (both would feed dj_state).
+ */
+esp_err_t usb_trace_replay_start(int speed);
+
+// ---------------------------------------------------------------------------
+// Replay (portable: device and host build)
+// ---------------------------------------------------------------------------
+
+/** Replay speed: 0 = as fast as possible, 1 = real time, N = N times faster. */
+#define USB_TRACE_SPEED_MAX 0
+
+/**
+ * Optional hook called before each packet is fed, with the record's trace
+ * timestamp. The host build uses it to drive a virtual clock.
+ */
+typedef void (*usb_trace_packet_hook_t)(uint32_t t_us, const uint8_t *data, void *ctx);
+
+typedef struct {
+    uint32_t packets;           // Records fed to dj_state_process()
+    uint32_t trace_us;          // Timestamp of the last record
+    int64_t  elapsed_us;        // Wall time spent replaying
+} usb_trace_replay_stats_t;
+
+/**
+ * Validate a trace image and return its record count, or -1 if the header
+ * is invalid.
+ */
+int usb_trace_count_records(const uint8_t *image, size_t len);
+
+/**
+ * Feed every record of a trace image through dj_state_process(), paced
+ * by the record timestamps divided by speed. Blocks until done.
+ */
+esp_err_t usb_trace_replay(const uint8_t *image, size_t len, int speed,
+                           usb_trace_packet_hook_t hook, void *ctx,
+                           usb_trace_replay_stats_t *stats);
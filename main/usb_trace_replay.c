@@ -0,0 +1,83 @@
+#include "usb_trace.h"
+#include "latency.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "trace_replay";
+
+// At max speed, yield this often so the idle task (and its watchdog) runs
+#define MAX_SPEED_YIELD_EVERY 512
+
+int usb_trace_count_records(const uint8_t *image, size_t len)
+{
+    usb_trace_header_t hdr;
+    if (!image || len < sizeof(hdr)) return -1;
+    memcpy(&hdr, image, sizeof(hdr));
+    if (memcmp(hdr.magic, USB_TRACE_MAGIC, 4) != 0 ||
+        hdr.version != USB_TRACE_VERSION ||
+        hdr.record_size != sizeof(usb_trace_record_t)) {
+        return -1;
+    }
+
+    size_t max = (len - sizeof(hdr)) / sizeof(usb_trace_record_t);
+    const uint8_t *p = image + sizeof(hdr);
+    int count = 0;
+    for (size_t i = 0; i < max; i++, p += sizeof(usb_trace_record_t)) {
+        uint32_t t_us;
+        memcpy(&t_us, p, sizeof(t_us));
+        if (t_us == USB_TRACE_END) break;
+        count++;
+    }
+    return count;
+}
+
+esp_err_t usb_trace_replay(const uint8_t *image, size_t len, int speed,
+                           usb_trace_packet_hook_t hook, void *ctx,
+                           usb_trace_replay_stats_t *stats)
+{
+    int count = usb_trace_count_records(image, len);
+    if (count < 0) {
+        ESP_LOGE(TAG, "Not a trace image (bad header)");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (speed < 0) speed = USB_TRACE_SPEED_MAX;
+
+    ESP_LOGI(TAG, "Replaying %d packets at %s%d", count,
+             speed == USB_TRACE_SPEED_MAX ? "max speed " : "x", speed);
+
+    const uint8_t *p = image + sizeof(usb_trace_header_t);
+    int64_t start_us = esp_timer_get_time();
+    usb_trace_record_t rec = {0};
+
+    for (int i = 0; i < count; i++, p += sizeof(rec)) {
+        memcpy(&rec, p, sizeof(rec));
+
+        if (speed != USB_TRACE_SPEED_MAX) {
+            int64_t wait_us = start_us + rec.t_us / speed - esp_timer_get_time();
+            if (wait_us >= 1000) {
+                vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+            }
+        }
+#ifdef ESP_PLATFORM
+        else if ((i % MAX_SPEED_YIELD_EVERY) == MAX_SPEED_YIELD_EVERY - 1) {
+            vTaskDelay(1);
+        }
+#endif
+
+        if (hook) hook(rec.t_us, rec.data, ctx);
+        latency_mark_usb_rx(esp_timer_get_time());
+        dj_state_process(rec.data);
+    }
+
+    if (stats) {
+        stats->packets = (uint32_t)count;
+        stats->trace_us = rec.t_us;
+        stats->elapsed_us = esp_timer_get_time() - start_us;
+    }
+    ESP_LOGI(TAG, "Replay done: %d packets", count);
+    return ESP_OK;
+}
@@ -0,0 +1,281 @@
+#include "ws_proto.h"
+#include "dj_state.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// ---------------------------------------------------------------------------
+// String interning
+// ---------------------------------------------------------------------------
+
+#define INTERN_MAX      255     // Ids fit in one byte
+#define INTERN_STR_MAX  48      // Longer strings are truncated
+#define INTERN_POOL     4096
+#define HASH_SLOTS      512     // Open addressing, value = id + 1
+
+// Append-only: the encoder task writes an entry, then publishes it by
+// bumping s_count (release); ws_proto_hello() may read from another task.
+static char       s_pool[INTERN_POOL];
+static uint16_t   s_pool_len = 0;
+static uint16_t   s_off[INTERN_MAX];
+static uint8_t    s_len[INTERN_MAX];
+static atomic_int s_count = 0;
+static uint8_t    s_hash[HASH_SLOTS];   // Encoder task only
+
+static uint32_t str_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Id of str[0..len), interning it if needed (*is_new set). -1 if full.
+static int intern(const char *str, size_t len, bool *is_new)
+{
+    if (len > INTERN_STR_MAX) len = INTERN_STR_MAX;
+    *is_new = false;
+
+    int count = atomic_load_explicit(&s_count, memory_order_relaxed);
+    uint32_t slot = str_hash(str, len) & (HASH_SLOTS - 1);
+    while (s_hash[slot]) {
+        int id = s_hash[slot] - 1;
+        if (s_len[id] == len && memcmp(s_pool + s_off[id], str, len) == 0) return id;
+        slot = (slot + 1) & (HASH_SLOTS - 1);
+    }
+
+    if (count >= INTERN_MAX || s_pool_len + len > INTERN_POOL) return -1;
+    memcpy(s_pool + s_pool_len, str, len);
+    s_off[count] = s_pool_len;
+    s_len[count] = (uint8_t)len;
+    s_pool_len += len;
+    s_hash[slot] = (uint8_t)(count + 1);
+    atomic_store_explicit(&s_count, count + 1, memory_order_release);
+    *is_new = true;
+    return count;
+}
+
+static int put_def(uint8_t *buf, int id)
+{
+    buf[0] = WS_REC_DEF;
+    buf[1] = (uint8_t)id;
+    buf[2] = s_len[id];
+    memcpy(buf + 3, s_pool + s_off[id], s_len[id]);
+    return 3 + s_len[id];
+}
+
+// Intern a string for an event; a new string's DEF is written at buf + *pos
+static int intern_def(uint8_t *buf, int *pos, const char *str, size_t len)
+{
+    bool is_new;
+    int id = intern(str, len, &is_new);
+    if (id >= 0 && is_new) *pos += put_def(buf + *pos, id);
+    return id;
+}
+
+void ws_proto_init(void)
+{
+    if (atomic_load(&s_count) > 0) return;
+    for (int i = 0; i < DJ_CONTROL_COUNT; i++) {
+        bool is_new;
+        const char *name = dj_control_name(i);
+        intern(name, strlen(name), &is_new);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// JSON
+// ---------------------------------------------------------------------------
+
+const char *ws_proto_exec_name(cmd_exec_type_t t)
+{
+    switch (t) {
+    case CMD_CAT_BUTTON: return "BTN";
+    case CMD_CAT_TOGGLE: return "TOG";
+    case CMD_CAT_SET:    return "SET";
+    case CMD_CAT_FREQ:   return "FRQ";
+    case CMD_CAT_WHEEL:        return "WHL";
+    case CMD_CAT_FILTER_WIDTH: return "FLW";
+    default:                   return "?";
+    }
+}
+
+int ws_proto_json(char *buf, size_t size, const ws_event_t *ev)
+{
+    switch (ev->kind) {
+    case WS_EV_CONTROL:
+        if (ev->merged > 1) {
+            return snprintf(buf, size,
+                "{\"type\":\"control\",\"name\":\"%s\",\"id\":%d,\"ctrl\":%d,\"old\":%d,\"new\":%d,\"n\":%d}",
+                dj_control_name(ev->control_id), ev->control_id, ev->control_type,
+                ev->old_value, ev->new_value, ev->merged);
+        }
+        return snprintf(buf, size,
+            "{\"type\":\"control\",\"name\":\"%s\",\"id\":%d,\"ctrl\":%d,\"old\":%d,\"new\":%d}",
+            dj_control_name(ev->control_id), ev->control_id, ev->control_type,
+            ev->old_value, ev->new_value);
+    case WS_EV_CAT:
+        return snprintf(buf, size,
+            "{\"type\":\"cat\",\"control\":\"%s\",\"cmd\":\"%s\",\"exec\":\"%s\",\"cat\":\"%s\"}",
+            dj_control_name(ev->control_id), ev->command_name ? ev->command_name : "",
+            ws_proto_exec_name(ev->exec_type), ev->text);
+    case WS_EV_CAT_RX:
+        return snprintf(buf, size,
+            "{\"type\":\"cat_rx\",\"cmd\":\"%s\",\"value\":\"%s\"}",
+            ev->cmd, ev->text);
+    case WS_EV_RAW: {
+        int len = snprintf(buf, size, "{\"type\":\"raw\",\"t\":%lu,\"hex\":\"",
+                           (unsigned long)ev->t_ms);
+        static const char hex[] = "0123456789abcdef";
+        for (int i = 0; i < ev->raw_len && len + 2 < (int)size; i++) {
+            buf[len++] = hex[ev->raw[i] >> 4];
+            buf[len++] = hex[ev->raw[i] & 0x0f];
+        }
+        return len + snprintf(buf + len, len < (int)size ? size - len : 0, "\"}");
+    }
+    default:
+        return 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Binary
+// ---------------------------------------------------------------------------
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Value bytes after a prefix, up to the terminating ';'
+static int put_value(uint8_t *p, const char *value)
+{
+    int len = 0;
+    while (value[len] && value[len] != ';' && len < (int)sizeof(((ws_event_t *)0)->text)) {
+        p[1 + len] = (uint8_t)value[len];
+        len++;
+    }
+    p[0] = (uint8_t)len;
+    return 1 + len;
+}
+
+// Length-prefixed string, at most max bytes
+static int put_str(uint8_t *p, const char *str, size_t len, size_t max)
+{
+    if (len > max) len = max;
+    p[0] = (uint8_t)len;
+    memcpy(p + 1, str, len);
+    return 1 + (int)len;
+}
+
+int ws_proto_binary(uint8_t *buf, size_t size, const ws_event_t *ev)
+{
+    if (size < WS_PROTO_BIN_MAX) return 0;
+    int pos = 0;
+
+    switch (ev->kind) {
+    case WS_EV_CONTROL:
+        buf[0] = WS_REC_CONTROL;
+        buf[1] = ev->control_id;
+        buf[2] = ev->control_type;
+        buf[3] = ev->old_value;
+        buf[4] = ev->new_value;
+        buf[5] = ev->merged > 255 ? 255 : (uint8_t)ev->merged;
+        put_u32(buf + 6, ev->t_ms);
+        return 10;
+
+    case WS_EV_CAT: {
+        const char *name = ev->command_name ? ev->command_name : "";
+        // ZZ extended commands have a 4-char prefix, Kenwood ones 2
+        size_t plen = (ev->text[0] == 'Z' && ev->text[1] == 'Z') ? 4 : 2;
+        plen = strnlen(ev->text, plen);
+        int name_id = intern_def(buf, &pos, name, strlen(name));
+        int prefix_id = intern_def(buf, &pos, ev->text, plen);
+        uint8_t *r = buf + pos;
+        if (name_id < 0 || prefix_id < 0) {
+            // Table full: strings inline (DEFs already written stay valid)
+            metrics_inc(METRIC_WS_INLINE_STRINGS);
+            r[0] = WS_REC_CAT_TX_STR;
+            r[1] = ev->control_id;
+            r[2] = ev->exec_type;
+            put_u32(r + 3, ev->t_ms);
+            int n = 7 + put_str(r + 7, name, strlen(name), INTERN_STR_MAX);
+            return pos + n + put_value(r + n, ev->text);
+        }
+        r[0] = WS_REC_CAT_TX;
+        r[1] = ev->control_id;
+        r[2] = ev->exec_type;
+        r[3] = (uint8_t)name_id;
+        r[4] = (uint8_t)prefix_id;
+        put_u32(r + 5, ev->t_ms);
+        return pos + 9 + put_value(r + 9, ev->text + plen);
+    }
+
+    case WS_EV_CAT_RX: {
+        int prefix_id = intern_def(buf, &pos, ev->cmd, strlen(ev->cmd));
+        uint8_t *r = buf + pos;
+        if (prefix_id < 0) {
+            metrics_inc(METRIC_WS_INLINE_STRINGS);
+            r[0] = WS_REC_CAT_RX_STR;
+            put_u32(r + 1, ev->t_ms);
+            int n = 5 + put_str(r + 5, ev->cmd, strlen(ev->cmd), sizeof(ev->cmd));
+            return pos + n + put_value(r + n, ev->text);
+        }
+        r[0] = WS_REC_CAT_RX;
+        r[1] = (uint8_t)prefix_id;
+        put_u32(r + 2, ev->t_ms);
+        return pos + 6 + put_value(r + 6, ev->text);
+    }
+
+    case WS_EV_RAW: {
+        int len = ev->raw_len > WS_PROTO_BIN_MAX - 6 ? WS_PROTO_BIN_MAX - 6 : ev->raw_len;
+        buf[0] = WS_REC_RAW;
+        put_u32(buf + 1, ev->t_ms);
+        buf[5] = (uint8_t)len;
+        memcpy(buf + 6, ev->raw, len);
+        return 6 + len;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+int ws_proto_defs(uint8_t *buf, size_t size, const ws_event_t *ev)
+{
+    if (size < WS_PROTO_BIN_MAX) return 0;
+    int pos = 0;
+    if (ev->kind == WS_EV_CAT) {
+        const char *name = ev->command_name ? ev->command_name : "";
+        size_t plen = (ev->text[0] == 'Z' && ev->text[1] == 'Z') ? 4 : 2;
+        intern_def(buf, &pos, name, strlen(name));
+        intern_def(buf, &pos, ev->text, strnlen(ev->text, plen));
+    } else if (ev->kind == WS_EV_CAT_RX) {
+        intern_def(buf, &pos, ev->cmd, strlen(ev->cmd));
+    }
+    return pos;
+}
+
+int ws_proto_hello(uint8_t *buf, size_t size, int *next)
+{
+    int pos = 0;
+    if (*next == 0) {
+        buf[pos++] = WS_REC_HELLO;
+        buf[pos++] = WS_PROTO_VERSION;
+        *next = 1;
+    }
+    int count = atomic_load_explicit(&s_count, memory_order_acquire);
+    while (*next - 1 < count && pos + 3 + INTERN_STR_MAX <= (int)size) {
+        pos += put_def(buf + pos, *next - 1);
+        (*next)++;
+    }
+    return pos;
+}
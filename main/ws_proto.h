@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "mapping_engine.h"
+
+/**
+ * WebSocket live telemetry encodings: JSON text (default, readable) and a
+ * compact binary format for clients that connect to /ws?bin=1.
+ *
+ * Binary frames are a sequence of little-endian records, each starting
+ * with a kind byte:
+ *
+ *   HELLO    00 ver                                          (2 bytes)
+ *   DEF      10 id len str[len]                              (3 + len)
+ *   CONTROL  01 ctrl type old new n t_ms:u32                 (10 bytes)
+ *   CAT_TX   02 ctrl exec name_id prefix_id t_ms:u32 len value[len]
+ *   CAT_RX   03 prefix_id t_ms:u32 len value[len]
+ *   RAW      04 t_ms:u32 len data[len]                       (USB state packet)
+ *   CAT_TX_STR  05 ctrl exec t_ms:u32 nlen name[nlen] len cat[len]
+ *   CAT_RX_STR  06 t_ms:u32 plen prefix[plen] len value[len]
+ *
+ * Strings (control names, command names, CAT prefixes) are interned: a
+ * DEF record binds an id to a string, and later records refer to the id.
+ * Control names are interned first, so a control's string id is its
+ * control id. A new string's DEF goes out in the same frame just before
+ * its first use; a client that connects later gets all DEFs in its hello
+ * frames. CAT values are the command minus its prefix and the ';'.
+ *
+ * The table holds 255 strings / 4 KB. Once it is full, CAT events whose
+ * strings are not in it go out as the _STR records, which carry the
+ * strings inline (cat is the whole command minus the ';'), and are counted
+ * in METRIC_WS_INLINE_STRINGS.
+ */
+
+#define WS_PROTO_VERSION 1
+
+typedef enum {
+    WS_REC_HELLO   = 0x00,
+    WS_REC_CONTROL = 0x01,
+    WS_REC_CAT_TX  = 0x02,
+    WS_REC_CAT_RX  = 0x03,
+    WS_REC_RAW     = 0x04,
+    WS_REC_CAT_TX_STR = 0x05,
+    WS_REC_CAT_RX_STR = 0x06,
+    WS_REC_DEF     = 0x10,
+} ws_record_kind_t;
+
+typedef enum {
+    WS_EV_CONTROL = 0,
+    WS_EV_CAT,          // Command sent for a mapped control
+    WS_EV_CAT_RX,       // Reply from Thetis
+    WS_EV_RAW,          // Raw USB state packet
+} ws_event_kind_t;
+
+/** One live event, as collected by the WS batcher. */
+typedef struct {
+    uint8_t     kind;           // ws_event_kind_t
+    uint8_t     control_id;
+    uint8_t     control_type;
+    uint8_t     exec_type;      // cmd_exec_type_t
+    uint8_t     old_value;
+    uint8_t     new_value;
+    uint16_t    merged;         // Control changes folded into this entry
+    uint32_t    t_ms;           // Time since boot
+    const char *command_name;   // WS_EV_CAT: static command DB string
+    char        cmd[8];         // WS_EV_CAT_RX: reply prefix
+    char        text[24];       // WS_EV_CAT: CAT string, WS_EV_CAT_RX: value
+    const uint8_t *raw;         // WS_EV_RAW: packet bytes (owned by the caller)
+    uint8_t     raw_len;
+} ws_event_t;
+
+/** Worst-case binary bytes for one event including its DEF records. */
+#define WS_PROTO_BIN_MAX 200
+
+/** Intern the control names. Call once before encoding. */
+void ws_proto_init(void);
+
+/**
+ * Format one event as a JSON object. Returns the length (snprintf
+ * semantics: >= size means truncated).
+ */
+int ws_proto_json(char *buf, size_t size, const ws_event_t *ev);
+
+/**
+ * Append one event as binary records. size must be at least
+ * WS_PROTO_BIN_MAX. Returns bytes written. Call from one task only.
+ */
+int ws_proto_binary(uint8_t *buf, size_t size, const ws_event_t *ev);
+
+/**
+ * Intern the strings of one event and write DEF records for the new ones
+ * only. Lets a caller that encodes one batch several ways (per-client
+ * filters) send every DEF to every client. Same size rule and task rule
+ * as ws_proto_binary(); returns bytes written.
+ */
+int ws_proto_defs(uint8_t *buf, size_t size, const ws_event_t *ev);
+
+/**
+ * Hello frame content for a new binary client: HELLO, then DEF records
+ * for every interned string. Call repeatedly with the same *next (start
+ * at 0) until it returns 0, sending each chunk as one frame. Safe to call
+ * from another task than ws_proto_binary().
+ */
+int ws_proto_hello(uint8_t *buf, size_t size, int *next);
+
+/** Exec type tag used in JSON ("BTN", "FRQ", ...). */
+const char *ws_proto_exec_name(cmd_exec_type_t t);
@@ -0,0 +1,81 @@
+#include "www_bundle.h"
+
+#include <string.h>
+
+// A NUL-terminated string at off, entirely inside the image
+static bool string_ok(const www_bundle_t *b, uint32_t off)
+{
+    return off < b->size && memchr(b->base + off, '\0', b->size - off) != NULL;
+}
+
+static const char *entry_path(const www_bundle_t *b, const www_bundle_entry_t *e)
+{
+    return (const char *)(b->base + e->path_off);
+}
+
+esp_err_t www_bundle_open(www_bundle_t *bundle, const void *base, size_t size)
+{
+    const www_bundle_header_t *h = base;
+    memset(bundle, 0, sizeof(*bundle));
+    if (size < sizeof(*h) || h->magic != WWW_BUNDLE_MAGIC) return ESP_ERR_NOT_FOUND;
+    if (h->version != WWW_BUNDLE_VERSION) return ESP_ERR_INVALID_VERSION;
+    if (h->image_size > size ||
+        sizeof(*h) + (size_t)h->count * sizeof(www_bundle_entry_t) > h->image_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    bundle->base = base;
+    bundle->size = h->image_size;
+    bundle->entries = (const www_bundle_entry_t *)(bundle->base + sizeof(*h));
+    bundle->count = h->count;
+
+    for (int i = 0; i < bundle->count; i++) {
+        const www_bundle_entry_t *e = &bundle->entries[i];
+        bool ok = string_ok(bundle, e->path_off) && string_ok(bundle, e->mime_off) &&
+                  string_ok(bundle, e->etag_off) &&
+                  strlen(entry_path(bundle, e)) == e->path_len &&
+                  e->body_off <= bundle->size && e->body_len <= bundle->size - e->body_off &&
+                  e->plain_off <= bundle->size && e->plain_len <= bundle->size - e->plain_off;
+        if (ok && i > 0) {
+            ok = strcmp(entry_path(bundle, e - 1), entry_path(bundle, e)) < 0;
+        }
+        if (!ok) {
+            memset(bundle, 0, sizeof(*bundle));
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    return ESP_OK;
+}
+
+void www_bundle_get(const www_bundle_t *bundle, int i, www_asset_t *out)
+{
+    const www_bundle_entry_t *e = &bundle->entries[i];
+    out->path = entry_path(bundle, e);
+    out->mime = (const char *)(bundle->base + e->mime_off);
+    out->etag = (const char *)(bundle->base + e->etag_off);
+    out->body = bundle->base + e->body_off;
+    out->len = e->body_len;
+    out->gzip = (e->flags & WWW_FLAG_GZIP) != 0;
+    out->plain = bundle->base + e->plain_off;
+    out->plain_len = e->plain_len;
+}
+
+bool www_bundle_find(const www_bundle_t *bundle, const char *path, size_t len, www_asset_t *out)
+{
+    int lo = 0, hi = bundle->count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const www_bundle_entry_t *e = &bundle->entries[mid];
+        // Compare path[0..len) with the NUL-terminated entry path
+        size_t n = len < e->path_len ? len : e->path_len;
+        int cmp = memcmp(path, entry_path(bundle, e), n);
+        if (cmp == 0) cmp = (len > e->path_len) - (len < e->path_len);
+        if (cmp == 0) {
+            www_bundle_get(bundle, mid, out);
+            return true;
+        }
+        if (cmp < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Read-only web asset bundle, built from build/www by scripts/pack_www.py
+ * and flashed to the "www" partition. The firmware memory-maps the
+ * partition and serves bodies straight from flash; the same reader runs on
+ * the host (host/tools/www_bundle_tool.c).
+ *
+ * Layout (little-endian, offsets from the start of the image):
+ *
+ *   header   magic "DJWB" version:u16 count:u16 image_size:u32 reserved:u32
+ *   entries  count x { path_off mime_off etag_off body_off body_len
+ *                      plain_off plain_len:u32 path_len flags:u16 },
+ *            sorted by path (strcmp)
+ *   strings  NUL-terminated paths ("/index.html"), MIME types, quoted ETags
+ *   bodies   file contents, gzipped when flags has WWW_FLAG_GZIP; a gzipped
+ *            file also has its plain copy at plain_off, otherwise plain_off
+ *            is body_off
+ *
+ * The ETag is a hash of the uncompressed file, so it only changes when the
+ * file does.
+ */
+
+#define WWW_BUNDLE_MAGIC    0x42574a44u     // "DJWB"
+#define WWW_BUNDLE_VERSION  2
+
+#define WWW_FLAG_GZIP       0x0001
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t image_size;
+    uint32_t reserved;
+} www_bundle_header_t;
+
+typedef struct {
+    uint32_t path_off;
+    uint32_t mime_off;
+    uint32_t etag_off;
+    uint32_t body_off;
+    uint32_t body_len;
+    uint32_t plain_off;
+    uint32_t plain_len;
+    uint16_t path_len;
+    uint16_t flags;
+} www_bundle_entry_t;
+
+/** A validated image; points into the caller's (mapped) memory. */
+typedef struct {
+    const uint8_t            *base;
+    size_t                    size;
+    const www_bundle_entry_t *entries;
+    int                       count;
+} www_bundle_t;
+
+/** One file, ready to send. All pointers are into the image. */
+typedef struct {
+    const char    *path;
+    const char    *mime;
+    const char    *etag;
+    const uint8_t *body;
+    uint32_t       len;
+    bool           gzip;
+    const uint8_t *plain;   // Uncompressed file (== body when !gzip)
+    uint32_t       plain_len;
+} www_asset_t;
+
+/**
+ * Check an image (header, sorted index, every offset in bounds, strings
+ * terminated) and fill *bundle. size is the bytes available at base; the
+ * image may be shorter. ESP_ERR_NOT_FOUND if there is no bundle (erased
+ * flash), ESP_ERR_INVALID_VERSION or ESP_ERR_INVALID_SIZE if it is damaged.
+ */
+esp_err_t www_bundle_open(www_bundle_t *bundle, const void *base, size_t size);
+
+/** Binary search for path[0..len), e.g. "/assets/index.js". */
+bool www_bundle_find(const www_bundle_t *bundle, const char *path, size_t len, www_asset_t *out);
+
+/** The i-th asset in path order, for listing. */
+void www_bundle_get(const www_bundle_t *bundle, int i, www_asset_t *out);
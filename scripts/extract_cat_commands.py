@@ -17,11 +17,14 @@ Usage:
     python3 scripts/extract_cat_commands.py reference/CATCommands.cs --diff
     python3 scripts/extract_cat_commands.py reference/CATCommands.cs --generate-c -o main/cmd_db_generated.inc
     python3 scripts/extract_cat_commands.py reference/CATCommands.cs --generate-c --overrides reference/cmd_overrides.json -o main/cmd_db_generated.inc
+    python3 scripts/extract_cat_commands.py reference/CATCommands.cs --generate-c --overrides reference/cmd_overrides.json -o main/cmd_db_generated.inc --catalog main/cmd_catalog_generated.inc
 """
 
 import re
 import sys
+import gzip
 import json
+import hashlib
 import argparse
 from pathlib import Path
 
@@ -233,6 +236,25 @@ CATEGORY_BASES = {
     'CAT_MISC':      1100,
 }
 
+# UI names, as s_category_names[] in mapping_engine.c
+CATEGORY_NAMES = {
+    'CAT_VFO':       'VFO',
+    'CAT_BAND':      'Band',
+    'CAT_MODE':      'Mode',
+    'CAT_TX':        'TX',
+    'CAT_AUDIO':     'Audio',
+    'CAT_FILTER':    'Filter',
+    'CAT_NR_NB':     'NR/NB',
+    'CAT_AGC':       'AGC',
+    'CAT_SPLIT_RIT': 'Split/RIT/XIT',
+    'CAT_CW':        'CW',
+    'CAT_MISC':      'Misc',
+}
+
+# cmd_exec_type_t in mapping_engine.h, in enum order
+EXEC_TYPES = ['CMD_CAT_BUTTON', 'CMD_CAT_TOGGLE', 'CMD_CAT_SET', 'CMD_CAT_FREQ',
+              'CMD_CAT_WHEEL', 'CMD_CAT_FILTER_WIDTH']
+
 # Keywords in description/properties -> category
 CATEGORY_KEYWORDS = [
     # Order matters: more specific patterns first
@@ -306,8 +328,8 @@ def load_overrides(path: Path) -> list[dict]:
     return [e for e in entries if 'cmd' in e]
 
 
-def generate_c(commands: list[dict], overrides_path: Path | None = None) -> str:
-    """Generate C source for s_cmd_db[] array."""
+def build_db(commands: list[dict], overrides_path: Path | None = None) -> list[dict]:
+    """Merge auto-detected commands with overrides, assign IDs, sort for s_cmd_db[]."""
     overrides = load_overrides(overrides_path) if overrides_path else []
 
     # Build override lookup: cmd -> override entry
@@ -432,11 +454,27 @@ def generate_c(commands: list[dict], overrides_path: Path | None = None) -> str:
         entry['id'] = id_counters[cat]
         id_counters[cat] += 1
 
+    # IDs are the stable key for stored mappings: refuse to generate a DB
+    # where two commands share one
+    seen_ids = {}
+    duplicates = []
+    for entry in db_entries:
+        prev = seen_ids.setdefault(entry['id'], entry)
+        if prev is not entry:
+            duplicates.append(f"  id {entry['id']}: {prev['cat_cmd']} \"{prev['name']}\" "
+                              f"and {entry['cat_cmd']} \"{entry['name']}\"")
+    if duplicates:
+        print('Error: duplicate command IDs:\n' + '\n'.join(duplicates), file=sys.stderr)
+        sys.exit(1)
+
     # Sort by category order then ID
     cat_order = list(CATEGORY_BASES.keys())
     db_entries.sort(key=lambda e: (cat_order.index(e['category']), e['id']))
+    return db_entries
 
-    # Generate C code
+
+def generate_c(db_entries: list[dict]) -> str:
+    """Generate C source for s_cmd_db[] array."""
     lines = []
     lines.append('// Auto-generated from reference/CATCommands.cs — DO NOT EDIT')
     lines.append('// Run: python3 scripts/extract_cat_commands.py reference/CATCommands.cs --generate-c -o main/cmd_db_generated.inc')
@@ -479,10 +517,84 @@ def generate_c(commands: list[dict], overrides_path: Path | None = None) -> str:
 
     lines.append('};')
     lines.append('')
+    lines.extend(generate_id_index(db_entries))
 
     return '\n'.join(lines)
 
 
+def generate_id_index(db_entries: list[dict]) -> list[str]:
+    """Generate s_cmd_index[]: dense id -> s_cmd_db index table for O(1) lookup."""
+    id_min = min(e['id'] for e in db_entries)
+    id_max = max(e['id'] for e in db_entries)
+    if id_max > 0xFFFF or len(db_entries) >= 0xFFFF:
+        print(f'Error: command IDs must fit in uint16_t (max id {id_max})', file=sys.stderr)
+        sys.exit(1)
+
+    index = [None] * (id_max - id_min + 1)
+    for i, entry in enumerate(db_entries):
+        index[entry['id'] - id_min] = i
+
+    lines = []
+    lines.append('// Command ID -> s_cmd_db index, 0xFFFF (CMD_INDEX_NONE) = unused ID')
+    lines.append(f'#define CMD_ID_MIN     {id_min}')
+    lines.append(f'#define CMD_ID_MAX     {id_max}')
+    lines.append('#define CMD_INDEX_NONE 0xFFFF')
+    lines.append('')
+    lines.append('static const uint16_t s_cmd_index[CMD_ID_MAX - CMD_ID_MIN + 1] = {')
+    per_row = 16
+    for row in range(0, len(index), per_row):
+        chunk = index[row:row + per_row]
+        vals = ', '.join('0xFFFF' if v is None else f'{v:6d}' for v in chunk)
+        lines.append(f'    /* {id_min + row:4d} */ {vals},')
+    lines.append('};')
+    lines.append('')
+    return lines
+
+
+def generate_catalog(db_entries: list[dict]) -> str:
+    """Generate the prebuilt GET /api/commands body: gzipped JSON as a C array.
+
+    Same objects, in the same order, as the firmware would build from
+    s_cmd_db[]. The ETag is a hash of the JSON, so it changes only when the
+    catalog does.
+    """
+    cat_order = list(CATEGORY_BASES.keys())
+    items = []
+    for entry in db_entries:
+        item = {
+            'id': entry['id'],
+            'name': entry['name'],
+            'cat': cat_order.index(entry['category']),
+            'cat_name': CATEGORY_NAMES[entry['category']],
+            'exec': EXEC_TYPES.index(entry['exec_type']),
+        }
+        if entry.get('description'):
+            item['desc'] = entry['description']
+        items.append(item)
+
+    body = json.dumps(items, separators=(',', ':'), ensure_ascii=False).encode('utf-8')
+    gz = gzip.compress(body, compresslevel=9, mtime=0)   # mtime=0: reproducible
+    etag = hashlib.sha256(body).hexdigest()[:16]
+
+    lines = []
+    lines.append('// Auto-generated from reference/CATCommands.cs — DO NOT EDIT')
+    lines.append('// Run: python3 scripts/extract_cat_commands.py reference/CATCommands.cs --generate-c '
+                 '-o main/cmd_db_generated.inc --catalog main/cmd_catalog_generated.inc')
+    lines.append(f'// GET /api/commands body: {len(items)} commands, '
+                 f'{len(body)} bytes JSON, {len(gz)} bytes gzip')
+    lines.append('')
+    lines.append(f'#define CMD_CATALOG_ETAG     "\\"{etag}\\""')
+    lines.append(f'#define CMD_CATALOG_JSON_LEN {len(body)}')
+    lines.append('')
+    lines.append(f'static const uint8_t s_cmd_catalog_gz[{len(gz)}] = {{')
+    per_row = 16
+    for row in range(0, len(gz), per_row):
+        lines.append('    ' + ', '.join(f'0x{b:02x}' for b in gz[row:row + per_row]) + ',')
+    lines.append('};')
+    lines.append('')
+    return '\n'.join(lines)
+
+
 # ===================================================================
 # Original output formatters
 # ===================================================================
@@ -566,6 +678,8 @@ def main():
     parser.add_argument('--generate-c', action='store_true',
                         help='Generate C source for s_cmd_db[] array')
     parser.add_argument('--overrides', help='Path to cmd_overrides.json for hand-tuned entries')
+    parser.add_argument('--catalog', help='With --generate-c: also write the gzipped '
+                        '/api/commands catalog to this file')
     parser.add_argument('--output', '-o', help='Write to file instead of stdout')
     args = parser.parse_args()
 
@@ -583,12 +697,17 @@ def main():
     # Generate C mode
     if args.generate_c:
         overrides_path = Path(args.overrides) if args.overrides else None
-        output = generate_c(commands, overrides_path)
+        db_entries = build_db(commands, overrides_path)
+        output = generate_c(db_entries)
+
+        if args.catalog:
+            Path(args.catalog).write_text(generate_catalog(db_entries))
+            print(f'Generated {args.catalog}')
 
         if args.output:
             Path(args.output).write_text(output)
-            # Count entries in generated output
-            count = output.count('{ ')
+            # Count entries in generated output (s_cmd_db rows only)
+            count = sum(1 for l in output.splitlines() if l.startswith('    { '))
             print(f'Generated {args.output} ({count} commands)')
         else:
             print(output)
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+Pack the frontend build into a read-only asset bundle for the "www" partition.
+
+Every file under the input directory (except *.gz copies) becomes one entry
+with its MIME type, an ETag (hash of the file) and a body that is gzipped
+when that makes it smaller. A gzipped entry also keeps the plain file, for
+clients that do not accept gzip. Entries are sorted by path so the firmware can
+binary-search them in memory-mapped flash. Format: main/www_bundle.h.
+
+Usage:
+    python3 scripts/pack_www.py build/www -o build/www.bin
+    python3 scripts/pack_www.py build/www -o build/www.bin --max-size 0x100000
+"""
+
+import sys
+import gzip
+import struct
+import hashlib
+import argparse
+from pathlib import Path
+
+MAGIC = 0x42574a44      # "DJWB"
+VERSION = 2
+FLAG_GZIP = 0x0001
+
+HEADER = struct.Struct('<IHHII')
+ENTRY = struct.Struct('<IIIIIIIHH')
+
+# Same table the firmware used when serving from SPIFFS
+MIME_TYPES = {
+    '.html':  'text/html',
+    '.js':    'application/javascript',
+    '.css':   'text/css',
+    '.json':  'application/json',
+    '.png':   'image/png',
+    '.svg':   'image/svg+xml',
+    '.ico':   'image/x-icon',
+    '.woff':  'font/woff',
+    '.woff2': 'font/woff2',
+}
+
+# Already compressed: gzip would only cost CPU on the browser
+NO_GZIP = {'.png', '.woff', '.woff2'}
+
+
+def collect(root: Path) -> list[dict]:
+    files = []
+    for path in sorted(root.rglob('*')):
+        if not path.is_file() or path.suffix == '.gz':
+            continue
+        data = path.read_bytes()
+        body, flags = data, 0
+        if path.suffix not in NO_GZIP:
+            gz = gzip.compress(data, compresslevel=9, mtime=0)   # mtime=0: reproducible
+            if len(gz) < len(data):
+                body, flags = gz, FLAG_GZIP
+        files.append({
+            'path': '/' + path.relative_to(root).as_posix(),
+            'mime': MIME_TYPES.get(path.suffix, 'application/octet-stream'),
+            'etag': '"' + hashlib.sha256(data).hexdigest()[:16] + '"',
+            'body': body,
+            'plain': data,
+            'size': len(data),
+            'flags': flags,
+        })
+    # Byte order, as strcmp() sees it
+    files.sort(key=lambda f: f['path'].encode())
+    return files
+
+
+def pack(files: list[dict]) -> bytes:
+    strings = bytearray()
+    string_offs = {}
+    base = HEADER.size + ENTRY.size * len(files)
+
+    def add_string(s: str) -> int:
+        if s not in string_offs:
+            string_offs[s] = base + len(strings)
+            strings.extend(s.encode() + b'\0')
+        return string_offs[s]
+
+    for f in files:
+        f['path_off'] = add_string(f['path'])
+        f['mime_off'] = add_string(f['mime'])
+        f['etag_off'] = add_string(f['etag'])
+
+    bodies = bytearray()
+    body_base = base + len(strings)
+    def add_body(data: bytes) -> int:
+        bodies.extend(b'\0' * (-(body_base + len(bodies)) % 4))   # 4-byte aligned bodies
+        off = body_base + len(bodies)
+        bodies.extend(data)
+        return off
+
+    for f in files:
+        f['body_off'] = add_body(f['body'])
+        # Not gzipped: the body is the plain file
+        f['plain_off'] = add_body(f['plain']) if f['flags'] & FLAG_GZIP else f['body_off']
+
+    image_size = body_base + len(bodies)
+    out = bytearray(HEADER.pack(MAGIC, VERSION, len(files), image_size, 0))
+    for f in files:
+        out += ENTRY.pack(f['path_off'], f['mime_off'], f['etag_off'], f['body_off'],
+                          len(f['body']), f['plain_off'], len(f['plain']),
+                          len(f['path'].encode()), f['flags'])
+    out += strings + bodies
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack build/www into a www partition image')
+    parser.add_argument('input', help='Frontend build directory (build/www)')
+    parser.add_argument('--output', '-o', required=True, help='Image file to write')
+    parser.add_argument('--max-size', type=lambda v: int(v, 0),
+                        help='Partition size; fail if the image does not fit')
+    args = parser.parse_args()
+
+    root = Path(args.input)
+    if not root.is_dir():
+        print(f'Error: {root} not found', file=sys.stderr)
+        sys.exit(1)
+
+    files = collect(root)
+    if not any(f['path'] == '/index.html' for f in files):
+        print(f'Error: no index.html in {root}', file=sys.stderr)
+        sys.exit(1)
+
+    image = pack(files)
+    if args.max_size is not None and len(image) > args.max_size:
+        print(f'Error: image is {len(image)} bytes, partition holds {args.max_size}',
+              file=sys.stderr)
+        sys.exit(1)
+    Path(args.output).write_bytes(image)
+
+    raw = sum(f['size'] for f in files)
+    print(f'Packed {len(files)} files into {args.output}: {len(image)} bytes '
+          f'({raw} bytes uncompressed)')
+    for f in files:
+        tag = 'gz' if f['flags'] & FLAG_GZIP else '  '
+        print(f'  {tag} {len(f["body"]):8d} {f["size"]:8d}  {f["path"]}')
+
+
+if __name__ == '__main__':
+    main()